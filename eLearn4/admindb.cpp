@@ -1,12 +1,20 @@
 #include "admindb.h"
 #include "ui_admindb.h"
+#include "changefeed.h"
 #include "globals.h"
+#include "repository.h"
+#include "storageservice.h"
 
 #include <QBrush>
 #include <QColor>
 #include <QHeaderView>
+#include <QProgressDialog>
 #include <QTableWidgetItem>
 #include <QDebug>
+#include <QSet>
+#include <algorithm>
+#include <functional>
+#include <memory>
 
 // Visible columns
 static const int COL_NUMBER  = 0;
@@ -98,7 +106,8 @@ adminDb::adminDb(QWidget *parent) :
     // ========== TABLE FORMATTING ==========
     ui->tableWidget->setAlternatingRowColors(true);
     ui->tableWidget->setSelectionBehavior(QAbstractItemView::SelectRows);
-    ui->tableWidget->setSelectionMode(QAbstractItemView::SingleSelection);
+    // Ctrl/Shift-click picks several rows for one Delete
+    ui->tableWidget->setSelectionMode(QAbstractItemView::ExtendedSelection);
     ui->tableWidget->verticalHeader()->setDefaultSectionSize(30);
     ui->tableWidget->verticalHeader()->setVisible(false);
 
@@ -151,6 +160,30 @@ adminDb::adminDb(QWidget *parent) :
     // Prevent user editing directly
     ui->tableWidget->setEditTriggers(QAbstractItemView::NoEditTriggers);
 
+    // Rows are appended as the roster streams in
+    connect(&m_roster, &QFutureWatcher<Student>::resultsReadyAt, this, [this](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+            appendStudentRows(m_roster.resultAt(i));
+    });
+    connect(&m_roster, &QFutureWatcher<Student>::finished, this, [this]() {
+        delete m_progress;
+        if (m_staleRoster) {
+            m_staleRoster = false;
+            loadXmlAndPopulateTable();
+        }
+    });
+
+    connect(&StorageService::instance(), &StorageService::rosterFailed, this, [this](const QString &error) {
+        QMessageBox::warning(this, "XML Error", "Some students could not be read.\n" + error);
+    });
+
+    // Students changed elsewhere are redrawn in place
+    ChangeFeed &feed = ChangeFeed::instance();
+    connect(&feed, &ChangeFeed::studentsChanged, this, &adminDb::updateStudents);
+    connect(&feed, &ChangeFeed::studentsRemoved, this, &adminDb::removeStudents);
+    connect(&feed, &ChangeFeed::rosterReset, this, &adminDb::loadXmlAndPopulateTable);
+    connect(&feed, &ChangeFeed::catalogChanged, this, &adminDb::loadXmlAndPopulateTable);
+
     // Populate table
     loadXmlAndPopulateTable();
 }
@@ -171,6 +204,20 @@ int adminDb::rowForWidget(QWidget *w) const
     return idx.isValid() ? idx.row() : -1;
 }
 
+// Rows a button in `row` acts on: the whole selection when the row is part
+// of it, otherwise just that row
+QList<int> adminDb::rowsForAction(int row) const
+{
+    QList<int> rows;
+    const QModelIndexList selected = ui->tableWidget->selectionModel()->selectedRows();
+    for (const QModelIndex &idx : selected)
+        rows.append(idx.row());
+    if (!rows.contains(row))
+        return { row };
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
 // Helper to create a styled button and attach generic clicked handlers
 QPushButton* adminDb::makeButton(const QString &text, const QString &stylePropName)
 {
@@ -181,224 +228,255 @@ QPushButton* adminDb::makeButton(const QString &text, const QString &stylePropNa
     return btn;
 }
 
-QString adminDb::getCourseName(XMLDocument &doc, const QString &courseId)
+QString adminDb::getCourseName(const QString &courseId)
 {
     if (courseId.isEmpty()) return QString();
 
-    XMLElement *courses = doc.FirstChildElement("ELearningPlatform");
-    if (!courses) return courseId;
-    courses = courses->FirstChildElement("Courses");
-    if (!courses) return courseId;
-
-    for (XMLElement *c = courses->FirstChildElement("Course"); c; c = c->NextSiblingElement("Course"))
-    {
-        const char *aid = c->Attribute("id");
-        if (!aid) continue;
-        if (courseId == aid)
-        {
-            XMLElement *nameEl = c->FirstChildElement("Name");
-            if (nameEl && nameEl->GetText()) return QString(nameEl->GetText());
-        }
-    }
-    return courseId;
+    QString name = m_catalog.courseName(courseId);
+    return name.isEmpty() ? courseId : name;
 }
 
-QString adminDb::getTestType(XMLDocument &doc, const QString &courseId, const QString &testId)
+QString adminDb::getTestType(const QString &courseId, const QString &testId)
 {
     if (courseId.isEmpty() || testId.isEmpty()) return testId;
 
-    XMLElement *courses = doc.FirstChildElement("ELearningPlatform");
-    if (!courses) return testId;
-    courses = courses->FirstChildElement("Courses");
-    if (!courses) return testId;
-
-    for (XMLElement *c = courses->FirstChildElement("Course"); c; c = c->NextSiblingElement("Course"))
-    {
-        const char *cid = c->Attribute("id");
-        if (!cid) continue;
-        if (courseId == cid)
-        {
-            XMLElement *tests = c->FirstChildElement("Tests");
-            if (!tests) break;
-            for (XMLElement *t = tests->FirstChildElement("Test"); t; t = t->NextSiblingElement("Test"))
-            {
-                const char *tid = t->Attribute("id");
-                if (!tid) continue;
-                if (testId == tid)
-                {
-                    const char *type = t->Attribute("type");
-                    if (type) return QString(type);
-                }
-            }
-        }
-    }
-    return testId;
+    QString type = m_catalog.testType(courseId, testId);
+    return type.isEmpty() ? testId : type;
 }
 
 void adminDb::loadXmlAndPopulateTable()
 {
-    QString xmlFile = g_xmlPath + "users.xml";
-    XMLDocument doc;
-
-    if (doc.LoadFile(xmlFile.toUtf8().constData()) != XML_SUCCESS) {
+    Repository &repo = Repository::instance();
+    if (!repo.isLoaded()) {
         QMessageBox::critical(this, "XML Error", "Unable to load users.xml");
         return;
     }
 
-    XMLElement *root = doc.FirstChildElement("ELearningPlatform");
-    if (!root) {
-        QMessageBox::critical(this, "XML Error", "Invalid users.xml: missing ELearningPlatform root");
+    // The roster streams in from the I/O thread (which first catches up
+    // with other instances) and rows are added as students arrive. A
+    // reload supersedes a read still running.
+    m_roster.cancel();
+    ui->tableWidget->setRowCount(0);
+    m_studentsShown = 0;
+
+    // Rows resolve names in a copy of the catalog. It is read by the job
+    // ahead of the roster's, so it is in place before the first rows.
+    StorageService::instance().catalog().then(this, [this](const CourseCatalog &catalog) {
+        m_catalog = catalog;
+    });
+
+    delete m_progress;
+    m_progress = new QProgressDialog("Loading students...", QString(), 0, 0, this);
+    m_progress->setWindowModality(Qt::WindowModal);
+    m_progress->setMinimumDuration(500);
+    QProgressDialog *progress = m_progress;
+    connect(&StorageService::instance(), &StorageService::loadProgress,
+            progress, [progress](int done, int total) {
+        progress->setRange(0, total);
+        progress->setValue(done);
+    });
+
+    m_roster.setFuture(StorageService::instance().roster());
+}
+
+void adminDb::appendStudentRows(const Student &s)
+{
+    insertStudentRows(ui->tableWidget->rowCount(), s, ++m_studentsShown);
+}
+
+// -----------------------------------------------------
+//  TARGETED UPDATES (ChangeFeed)
+// -----------------------------------------------------
+// Student id -> its header row
+QHash<QString, int> adminDb::headerRows() const
+{
+    QHash<QString, int> rows;
+    for (int r = 0; r < ui->tableWidget->rowCount(); ++r) {
+        QTableWidgetItem *hdr = ui->tableWidget->item(r, H_ISHEADER);
+        QTableWidgetItem *id = ui->tableWidget->item(r, H_STUDENTID);
+        if (hdr && id && hdr->text() == "1")
+            rows.insert(id->text(), r);
+    }
+    return rows;
+}
+
+// Remove the header row at `row` and the test rows under it
+void adminDb::removeStudentRows(int row)
+{
+    ui->tableWidget->removeRow(row);
+    while (row < ui->tableWidget->rowCount()) {
+        QTableWidgetItem *hdr = ui->tableWidget->item(row, H_ISHEADER);
+        if (hdr && hdr->text() == "1")
+            break;
+        ui->tableWidget->removeRow(row);
+    }
+}
+
+// Known students are redrawn where they are, bottom-up so the rows still
+// to do keep their place; new ones go to the end. Changes that arrive
+// while the roster is still streaming in wait for a reload instead.
+void adminDb::updateStudents(const QVector<Student> &students)
+{
+    if (!m_roster.isFinished()) {
+        m_staleRoster = true;
         return;
     }
-    XMLElement *students = root->FirstChildElement("Students");
-    if (!students) {
-        // no students => clear table
-        ui->tableWidget->setRowCount(0);
+
+    const QHash<QString, int> rows = headerRows();
+    QVector<QPair<int, int>> shown;     // (header row, index in students)
+    for (int i = 0; i < students.size(); ++i) {
+        auto it = rows.constFind(students[i].id);
+        if (it != rows.constEnd())
+            shown.append(qMakePair(it.value(), i));
+        else
+            appendStudentRows(students[i]);
+    }
+    std::sort(shown.begin(), shown.end(), [](const QPair<int, int> &a, const QPair<int, int> &b) {
+        return a.first > b.first;
+    });
+    for (const QPair<int, int> &p : shown) {
+        const int number = ui->tableWidget->item(p.first, COL_NUMBER)->text().mid(1).toInt();
+        removeStudentRows(p.first);
+        insertStudentRows(p.first, students[p.second], number);
+    }
+}
+
+void adminDb::removeStudents(const QStringList &studentIds)
+{
+    if (!m_roster.isFinished()) {
+        m_staleRoster = true;
         return;
     }
 
-    // Clear any existing rows and delete cell widgets to avoid leaks
-    ui->tableWidget->setRowCount(0);
+    const QHash<QString, int> rows = headerRows();
+    QVector<int> doomed;
+    for (const QString &id : studentIds)
+        if (rows.contains(id))
+            doomed.append(rows.value(id));
+    std::sort(doomed.begin(), doomed.end(), std::greater<int>());
+    for (int row : doomed)
+        removeStudentRows(row);
+
+    // renumber what is left
+    m_studentsShown = 0;
+    for (int r = 0; r < ui->tableWidget->rowCount(); ++r) {
+        QTableWidgetItem *hdr = ui->tableWidget->item(r, H_ISHEADER);
+        if (hdr && hdr->text() == "1")
+            ui->tableWidget->item(r, COL_NUMBER)->setText("#" + QString::number(++m_studentsShown));
+    }
+}
 
-    int row = 0;
-    int displayIndex = 1;
+// One header row for the student at `row`, then a row per test attempt;
+// `displayIndex` is the "#n" it is listed as
+void adminDb::insertStudentRows(int row, const Student &s, int displayIndex)
+{
 
-    // iterate students
-    for (XMLElement *s = students->FirstChildElement("Student"); s; s = s->NextSiblingElement("Student"))
-    {
-        const char* sid = s->Attribute("id");
-        QString studentId = sid ? QString(sid) : "";
-
-        // read attributes robustly
-        auto textOrEmpty = [&](XMLElement *el)->QString{
-            if (!el) return QString();
-            const char* t = el->GetText();
-            return t ? QString(t) : QString();
-        };
-
-        QString username = textOrEmpty(s->FirstChildElement("Username"));
-        QString password = textOrEmpty(s->FirstChildElement("Password"));
-        QString email = textOrEmpty(s->FirstChildElement("Email"));
-        QString phone = textOrEmpty(s->FirstChildElement("Phone"));
-        QString address = textOrEmpty(s->FirstChildElement("Address"));
-
-        // Insert header row for student
-        ui->tableWidget->insertRow(row);
-        ui->tableWidget->setItem(row, COL_NUMBER, new QTableWidgetItem("#" + QString::number(displayIndex)));
-        ui->tableWidget->setItem(row, COL_USER, new QTableWidgetItem(username));
-        ui->tableWidget->setItem(row, COL_PWD, new QTableWidgetItem(password));
-        ui->tableWidget->setItem(row, COL_EMAIL, new QTableWidgetItem(email));
-        ui->tableWidget->setItem(row, COL_PHONE, new QTableWidgetItem(phone));
-        ui->tableWidget->setItem(row, COL_ADDR, new QTableWidgetItem(address));
-
-        // Hidden metadata
-        ui->tableWidget->setItem(row, H_ISHEADER, new QTableWidgetItem("1"));
-        ui->tableWidget->setItem(row, H_STUDENTID, new QTableWidgetItem(studentId));
-        ui->tableWidget->setItem(row, H_COURSEID, new QTableWidgetItem(""));
-        ui->tableWidget->setItem(row, H_TESTID, new QTableWidgetItem(""));
-        ui->tableWidget->setItem(row, H_ATTEMPT_H, new QTableWidgetItem(""));
-        ui->tableWidget->setItem(row, H_GRADE_H, new QTableWidgetItem(""));
-
-        // Mark header row visually
-        QBrush headerBrush(QColor(240, 240, 240));
-        for (int c = 0; c <= COL_DELETE; ++c) {
-            if (ui->tableWidget->item(row, c))
-                ui->tableWidget->item(row, c)->setBackground(headerBrush);
-        }
+    QString studentId = s.id;
+
+    // Insert header row for student
+    ui->tableWidget->insertRow(row);
+    ui->tableWidget->setItem(row, COL_NUMBER, new QTableWidgetItem("#" + QString::number(displayIndex)));
+    ui->tableWidget->setItem(row, COL_USER, new QTableWidgetItem(s.username));
+    ui->tableWidget->setItem(row, COL_PWD, new QTableWidgetItem(s.password));
+    ui->tableWidget->setItem(row, COL_EMAIL, new QTableWidgetItem(s.email));
+    ui->tableWidget->setItem(row, COL_PHONE, new QTableWidgetItem(s.phone));
+    ui->tableWidget->setItem(row, COL_ADDR, new QTableWidgetItem(s.address));
+
+    // Hidden metadata
+    ui->tableWidget->setItem(row, H_ISHEADER, new QTableWidgetItem("1"));
+    ui->tableWidget->setItem(row, H_STUDENTID, new QTableWidgetItem(studentId));
+    ui->tableWidget->setItem(row, H_COURSEID, new QTableWidgetItem(""));
+    ui->tableWidget->setItem(row, H_TESTID, new QTableWidgetItem(""));
+    ui->tableWidget->setItem(row, H_ATTEMPT_H, new QTableWidgetItem(""));
+    ui->tableWidget->setItem(row, H_GRADE_H, new QTableWidgetItem(""));
+
+    // Mark header row visually
+    QBrush headerBrush(QColor(240, 240, 240));
+    for (int c = 0; c <= COL_DELETE; ++c) {
+        if (ui->tableWidget->item(row, c))
+            ui->tableWidget->item(row, c)->setBackground(headerBrush);
+    }
 
-        // Student-level Edit button
-        QPushButton *editStudentBtn = makeButton("Edit", "editBtnStyle");
-        // connect generic clicked -> find row at runtime
-        connect(editStudentBtn, &QPushButton::clicked, this, &adminDb::onEditButtonClicked);
-        ui->tableWidget->setCellWidget(row, COL_EDIT, editStudentBtn);
+    // Student-level Edit button
+    QPushButton *editStudentBtn = makeButton("Edit", "editBtnStyle");
+    // connect generic clicked -> find row at runtime
+    connect(editStudentBtn, &QPushButton::clicked, this, &adminDb::onEditButtonClicked);
+    ui->tableWidget->setCellWidget(row, COL_EDIT, editStudentBtn);
 
-        // Student-level Delete button
-        QPushButton *delStudentBtn = makeButton("Delete", "deleteBtnStyle");
-        connect(delStudentBtn, &QPushButton::clicked, this, &adminDb::onDeleteButtonClicked);
-        ui->tableWidget->setCellWidget(row, COL_DELETE, delStudentBtn);
+    // Student-level Delete button
+    QPushButton *delStudentBtn = makeButton("Delete", "deleteBtnStyle");
+    connect(delStudentBtn, &QPushButton::clicked, this, &adminDb::onDeleteButtonClicked);
+    ui->tableWidget->setCellWidget(row, COL_DELETE, delStudentBtn);
 
-        ui->tableWidget->setRowHeight(row, 30);
-        row++;
-        displayIndex++;
+    ui->tableWidget->setRowHeight(row, 30);
+    row++;
 
-        // Now add test rows for this student
-        XMLElement *regCourses = s->FirstChildElement("RegisteredCourses");
-        if (!regCourses) continue;
+    // Now add test rows for this student
+    for (const CourseRegistration &c : s.courses)
+    {
+        QString courseId = c.courseId;
+        QString courseName = getCourseName(courseId);
 
-        for (XMLElement *c = regCourses->FirstChildElement("CourseRegistration"); c; c = c->NextSiblingElement("CourseRegistration"))
+        for (const TestRegistration &t : c.tests)
         {
-            const char *cid = c->Attribute("courseId");
-            QString courseId = cid ? QString(cid) : "";
-            QString courseName = getCourseName(doc, courseId);
-
-            XMLElement *tests = c->FirstChildElement("TestRegistrations");
-            if (!tests) continue;
-
-            for (XMLElement *t = tests->FirstChildElement("TestRegistration"); t; t = t->NextSiblingElement("TestRegistration"))
-            {
-                const char *tid = t->Attribute("testId");
-                const char *att = t->Attribute("attempt");
-                QString tid_q = tid ? QString(tid) : "";
-                QString attempt = att ? QString(att) : "";
-
-                QString score = textOrEmpty(t->FirstChildElement("Score"));
-                // Grade might be missing; use Grade tag if available
-                QString grade = textOrEmpty(t->FirstChildElement("Grade"));
-                // Result tag might be used elsewhere, ignore for now
-
-                QString testType = getTestType(doc, courseId, tid_q);
-
-                ui->tableWidget->insertRow(row);
-
-                // For test rows, leave username/password/email/phone/address blank to show they're under the header
-                ui->tableWidget->setItem(row, COL_NUMBER, new QTableWidgetItem(""));
-                ui->tableWidget->setItem(row, COL_USER, new QTableWidgetItem(""));
-                ui->tableWidget->setItem(row, COL_PWD, new QTableWidgetItem(""));
-
-                ui->tableWidget->setItem(row, COL_COURSE, new QTableWidgetItem(courseName + " (" + courseId + ")"));
-                ui->tableWidget->setItem(row, COL_TEST, new QTableWidgetItem(testType + " (" + tid_q + ")"));
-                ui->tableWidget->setItem(row, COL_SCORE, new QTableWidgetItem(score));
-                ui->tableWidget->setItem(row, COL_GRADE, new QTableWidgetItem(grade));
-                ui->tableWidget->setItem(row, COL_ATTEMPT, new QTableWidgetItem(attempt));
-
-                // Hidden metadata for test row
-                ui->tableWidget->setItem(row, H_ISHEADER, new QTableWidgetItem("0"));
-                ui->tableWidget->setItem(row, H_STUDENTID, new QTableWidgetItem(studentId));
-                ui->tableWidget->setItem(row, H_COURSEID, new QTableWidgetItem(courseId));
-                ui->tableWidget->setItem(row, H_TESTID, new QTableWidgetItem(tid_q));
-                ui->tableWidget->setItem(row, H_ATTEMPT_H, new QTableWidgetItem(attempt));
-                ui->tableWidget->setItem(row, H_GRADE_H, new QTableWidgetItem(grade));
-
-                // Color-code grade cell (cosmetic only)
-                if (!grade.isEmpty()) {
-                    QTableWidgetItem *gradeItem = ui->tableWidget->item(row, COL_GRADE);
-                    if (gradeItem) {
-                        QString g = grade.trimmed().toUpper();
-                        if (g == "A" || g == "A+") {
-                            gradeItem->setBackground(QBrush(QColor(220, 255, 220))); // light green
-                        } else if (g == "B") {
-                            gradeItem->setBackground(QBrush(QColor(240, 255, 220))); // pale
-                        } else if (g == "C") {
-                            gradeItem->setBackground(QBrush(QColor(255, 250, 220)));
-                        } else if (g == "F") {
-                            gradeItem->setBackground(QBrush(QColor(255, 220, 220))); // light red
-                        }
+            QString tid_q = t.testId;
+            QString attempt = QString::number(t.attempt);
+
+            QString score = QString::number(t.score);
+            QString grade = t.grade;
+
+            QString testType = getTestType(courseId, tid_q);
+
+            ui->tableWidget->insertRow(row);
+
+            // For test rows, leave username/password/email/phone/address blank to show they're under the header
+            ui->tableWidget->setItem(row, COL_NUMBER, new QTableWidgetItem(""));
+            ui->tableWidget->setItem(row, COL_USER, new QTableWidgetItem(""));
+            ui->tableWidget->setItem(row, COL_PWD, new QTableWidgetItem(""));
+
+            ui->tableWidget->setItem(row, COL_COURSE, new QTableWidgetItem(courseName + " (" + courseId + ")"));
+            ui->tableWidget->setItem(row, COL_TEST, new QTableWidgetItem(testType + " (" + tid_q + ")"));
+            ui->tableWidget->setItem(row, COL_SCORE, new QTableWidgetItem(score));
+            ui->tableWidget->setItem(row, COL_GRADE, new QTableWidgetItem(grade));
+            ui->tableWidget->setItem(row, COL_ATTEMPT, new QTableWidgetItem(attempt));
+
+            // Hidden metadata for test row
+            ui->tableWidget->setItem(row, H_ISHEADER, new QTableWidgetItem("0"));
+            ui->tableWidget->setItem(row, H_STUDENTID, new QTableWidgetItem(studentId));
+            ui->tableWidget->setItem(row, H_COURSEID, new QTableWidgetItem(courseId));
+            ui->tableWidget->setItem(row, H_TESTID, new QTableWidgetItem(tid_q));
+            ui->tableWidget->setItem(row, H_ATTEMPT_H, new QTableWidgetItem(attempt));
+            ui->tableWidget->setItem(row, H_GRADE_H, new QTableWidgetItem(grade));
+
+            // Color-code grade cell (cosmetic only)
+            if (!grade.isEmpty()) {
+                QTableWidgetItem *gradeItem = ui->tableWidget->item(row, COL_GRADE);
+                if (gradeItem) {
+                    QString g = grade.trimmed().toUpper();
+                    if (g == "A" || g == "A+") {
+                        gradeItem->setBackground(QBrush(QColor(220, 255, 220))); // light green
+                    } else if (g == "B") {
+                        gradeItem->setBackground(QBrush(QColor(240, 255, 220))); // pale
+                    } else if (g == "C") {
+                        gradeItem->setBackground(QBrush(QColor(255, 250, 220)));
+                    } else if (g == "F") {
+                        gradeItem->setBackground(QBrush(QColor(255, 220, 220))); // light red
                     }
                 }
+            }
 
-                // Test-level Edit button
-                QPushButton *editTestBtn = makeButton("Edit", "editBtnStyle");
-                connect(editTestBtn, &QPushButton::clicked, this, &adminDb::onEditButtonClicked);
-                ui->tableWidget->setCellWidget(row, COL_EDIT, editTestBtn);
+            // Test-level Edit button
+            QPushButton *editTestBtn = makeButton("Edit", "editBtnStyle");
+            connect(editTestBtn, &QPushButton::clicked, this, &adminDb::onEditButtonClicked);
+            ui->tableWidget->setCellWidget(row, COL_EDIT, editTestBtn);
 
-                // Test-level Delete button
-                QPushButton *delTestBtn = makeButton("Delete", "deleteBtnStyle");
-                connect(delTestBtn, &QPushButton::clicked, this, &adminDb::onDeleteButtonClicked);
-                ui->tableWidget->setCellWidget(row, COL_DELETE, delTestBtn);
+            // Test-level Delete button
+            QPushButton *delTestBtn = makeButton("Delete", "deleteBtnStyle");
+            connect(delTestBtn, &QPushButton::clicked, this, &adminDb::onDeleteButtonClicked);
+            ui->tableWidget->setCellWidget(row, COL_DELETE, delTestBtn);
 
-                ui->tableWidget->setRowHeight(row, 28);
-                row++;
-            }
+            ui->tableWidget->setRowHeight(row, 28);
+            row++;
         }
     }
 }
@@ -425,14 +503,8 @@ void adminDb::onDeleteButtonClicked()
 {
     QWidget *w = qobject_cast<QWidget*>(sender());
     int row = rowForWidget(w);
-    if (row >= 0) {
-        QTableWidgetItem *isHdr = ui->tableWidget->item(row, H_ISHEADER);
-        if (isHdr && isHdr->text() == "1") {
-            onDeleteStudentClicked(row);
-        } else {
-            onDeleteTestClicked(row);
-        }
-    }
+    if (row >= 0)
+        deleteRows(rowsForAction(row));
 }
 
 // ------------------ Student-level edit ------------------
@@ -470,41 +542,11 @@ void adminDb::onEditStudentClicked(int row)
                                                oldAddress, &ok4);
     if (!ok4) return;
 
-    if (updateStudentInXML(studentId, newUser, newEmail, newPhone, newAddress))
-    {
-        loadXmlAndPopulateTable();
-        QMessageBox::information(this, "Updated", "Student updated successfully.");
-    }
-    else
-    {
-        QMessageBox::warning(this, "Failed", "Could not update student in XML.");
-    }
+    commitAndRedraw(studentId, [=](Repository &repo, QString *error) {
+        return repo.updateStudent(studentId, newUser, newEmail, newPhone, newAddress, error);
+    }, "Student updated successfully.", "Could not update student in XML.");
 }
 
-// ------------------ Student-level delete ------------------
-void adminDb::onDeleteStudentClicked(int row)
-{
-    QTableWidgetItem* idItem = ui->tableWidget->item(row, H_STUDENTID);
-    if (!idItem) return;
-    QString studentId = idItem->text();
-    if (studentId.isEmpty()) return;
-
-    QString username = ui->tableWidget->item(row, COL_USER)->text();
-
-    if (QMessageBox::question(this, "Confirm Delete",
-                              "Delete student and all records for: " + username + "?") == QMessageBox::Yes)
-    {
-        if (deleteStudentFromXML(studentId))
-        {
-            loadXmlAndPopulateTable();
-            QMessageBox::information(this, "Deleted", "Student removed.");
-        }
-        else
-        {
-            QMessageBox::warning(this, "Error", "XML delete failed.");
-        }
-    }
-}
 
 // ------------------ Test-level edit ------------------
 void adminDb::onEditTestClicked(int row)
@@ -548,17 +590,10 @@ void adminDb::onEditTestClicked(int row)
         if (btn == QMessageBox::Ok)
         {
             // delete TestRegistration
-            if (deleteTestFromXML(studentId, courseId, testId, attempt))
-            {
-                loadXmlAndPopulateTable();
-                QMessageBox::information(this, "Updated",
-                                         "Previous attempt removed. Student may register again.");
-            }
-            else
-            {
-                QMessageBox::warning(this, "Error",
-                                     "Unable to remove attempt from XML.");
-            }
+            commitAndRedraw(studentId, [=](Repository &repo, QString *error) {
+                return repo.deleteAttempt(studentId, courseId, testId, attempt.toInt(), error);
+            }, "Previous attempt removed. Student may register again.",
+               "Unable to remove attempt from XML.");
         }
 
         return;  // exit always for this condition
@@ -569,228 +604,124 @@ void adminDb::onEditTestClicked(int row)
                              "Editing of this test record is not permitted.");
 }
 
-// ------------------ Test-level delete ------------------
-void adminDb::onDeleteTestClicked(int row)
+// ------------------ Delete (one row or a selection) ------------------
+// Students on header rows go as a whole, test rows lose that attempt unless
+// their student goes too. Everything is one commitAll() on the I/O thread;
+// then only the rows of the students touched are redrawn.
+void adminDb::deleteRows(const QList<int> &rows)
 {
-    QTableWidgetItem* sidItem = ui->tableWidget->item(row, H_STUDENTID);
-    QTableWidgetItem* cidItem = ui->tableWidget->item(row, H_COURSEID);
-    QTableWidgetItem* tidItem = ui->tableWidget->item(row, H_TESTID);
-    QTableWidgetItem* attItem = ui->tableWidget->item(row, H_ATTEMPT_H);
+    QVector<Mutation> changes;
+    QSet<QString> wholeStudents;
+    QString question;
 
-    if (!sidItem || !cidItem || !tidItem || !attItem) return;
-
-    QString studentId = sidItem->text();
-    QString courseId  = cidItem->text();
-    QString testId    = tidItem->text();
-    QString attempt   = attItem->text();
-
-    QString testFull = ui->tableWidget->item(row, COL_TEST) ? ui->tableWidget->item(row, COL_TEST)->text() : QString();
-
-    if (QMessageBox::question(this, "Confirm Delete",
-                              "Delete test record: " + testFull + " ?") == QMessageBox::Yes)
-    {
-        if (deleteTestFromXML(studentId, courseId, testId, attempt))
-        {
-            loadXmlAndPopulateTable();
-            QMessageBox::information(this, "Deleted", "Test record removed.");
-        }
-        else
-        {
-            QMessageBox::warning(this, "Error", "Failed to delete test in XML.");
-        }
+    for (int row : rows) {
+        QTableWidgetItem *isHdr = ui->tableWidget->item(row, H_ISHEADER);
+        QTableWidgetItem *idItem = ui->tableWidget->item(row, H_STUDENTID);
+        if (!isHdr || isHdr->text() != "1" || !idItem || idItem->text().isEmpty())
+            continue;
+        Mutation m;
+        m.type      = Mutation::DeleteStudent;
+        m.studentId = idItem->text();
+        changes.append(m);
+        wholeStudents.insert(m.studentId);
+        question = "Delete student and all records for: " + ui->tableWidget->item(row, COL_USER)->text() + "?";
     }
-}
-
-// ------------------ XML operations ------------------
-
-// Delete student (entire <Student> node)
-bool adminDb::deleteStudentFromXML(const QString &studentId)
-{
-    QString xmlFile = g_xmlPath + "users.xml";
-    XMLDocument doc;
-    if (doc.LoadFile(xmlFile.toUtf8().constData()) != XML_SUCCESS) return false;
-
-    XMLElement* root = doc.FirstChildElement("ELearningPlatform");
-    if (!root) return false;
-
-    XMLElement* students = root->FirstChildElement("Students");
-    if (!students) return false;
-
-    for (XMLElement *s = students->FirstChildElement("Student"); s; s = s->NextSiblingElement("Student"))
-    {
-        const char* aid = s->Attribute("id");
-        if (aid && studentId == QString(aid))
-        {
-            students->DeleteChild(s);
-            doc.SaveFile(xmlFile.toUtf8().constData());
-            return true;
-        }
+    for (int row : rows) {
+        QTableWidgetItem* isHdr = ui->tableWidget->item(row, H_ISHEADER);
+        QTableWidgetItem* sidItem = ui->tableWidget->item(row, H_STUDENTID);
+        QTableWidgetItem* cidItem = ui->tableWidget->item(row, H_COURSEID);
+        QTableWidgetItem* tidItem = ui->tableWidget->item(row, H_TESTID);
+        QTableWidgetItem* attItem = ui->tableWidget->item(row, H_ATTEMPT_H);
+        if (!isHdr || isHdr->text() != "0" || !sidItem || !cidItem || !tidItem || !attItem)
+            continue;
+        if (wholeStudents.contains(sidItem->text()))
+            continue;
+        Mutation m;
+        m.type         = Mutation::DeleteAttempt;
+        m.studentId    = sidItem->text();
+        m.courseId     = cidItem->text();
+        m.test.testId  = tidItem->text();
+        m.test.attempt = attItem->text().toInt();
+        changes.append(m);
+        QString testFull = ui->tableWidget->item(row, COL_TEST) ? ui->tableWidget->item(row, COL_TEST)->text() : QString();
+        question = "Delete test record: " + testFull + " ?";
     }
-    return false;
-}
-
-// Update student details
-bool adminDb::updateStudentInXML(const QString &studentId,
-                                 const QString &newUsername,
-                                 const QString &newEmail,
-                                 const QString &newPhone,
-                                 const QString &newAddress)
-{
-    QString xmlFile = g_xmlPath + "users.xml";
-    XMLDocument doc;
-    if (doc.LoadFile(xmlFile.toUtf8().constData()) != XML_SUCCESS) return false;
-
-    XMLElement* root = doc.FirstChildElement("ELearningPlatform");
-    if (!root) return false;
+    if (changes.isEmpty()) return;
 
-    XMLElement* students = root->FirstChildElement("Students");
-    if (!students) return false;
-
-    for (XMLElement *s = students->FirstChildElement("Student"); s; s = s->NextSiblingElement("Student"))
-    {
-        const char* aid = s->Attribute("id");
-        if (aid && studentId == QString(aid))
-        {
-            XMLElement* uEl = s->FirstChildElement("Username");
-            if (!uEl) {
-                uEl = doc.NewElement("Username");
-                s->InsertFirstChild(uEl);
-            }
-            uEl->SetText(newUsername.toUtf8().constData());
-
-            XMLElement* eEl = s->FirstChildElement("Email");
-            if (!eEl) { eEl = doc.NewElement("Email"); s->InsertAfterChild(uEl, eEl); }
-            eEl->SetText(newEmail.toUtf8().constData());
-
-            XMLElement* pEl = s->FirstChildElement("Phone");
-            if (!pEl) { pEl = doc.NewElement("Phone"); s->InsertAfterChild(eEl, pEl); }
-            pEl->SetText(newPhone.toUtf8().constData());
-
-            XMLElement* aEl = s->FirstChildElement("Address");
-            if (!aEl) { aEl = doc.NewElement("Address"); s->InsertAfterChild(pEl, aEl); }
-            aEl->SetText(newAddress.toUtf8().constData());
-
-            doc.SaveFile(xmlFile.toUtf8().constData());
-            return true;
-        }
+    if (changes.size() > 1) {
+        const int students = wholeStudents.size();
+        question = QString("Delete %1 student(s) and %2 test record(s)?")
+                       .arg(students).arg(changes.size() - students);
     }
-    return false;
-}
-
-// Delete test registration
-bool adminDb::deleteTestFromXML(const QString &studentId, const QString &courseId,
-                                const QString &testId, const QString &attempt)
-{
-    QString xmlFile = g_xmlPath + "users.xml";
-    XMLDocument doc;
-    if (doc.LoadFile(xmlFile.toUtf8().constData()) != XML_SUCCESS) return false;
-
-    XMLElement* root = doc.FirstChildElement("ELearningPlatform");
-    if (!root) return false;
-
-    XMLElement* students = root->FirstChildElement("Students");
-    if (!students) return false;
-
-    for (XMLElement *s = students->FirstChildElement("Student"); s; s = s->NextSiblingElement("Student"))
-    {
-        const char* aid = s->Attribute("id");
-        if (!(aid && studentId == QString(aid))) continue;
+    if (QMessageBox::question(this, "Confirm Delete", question) != QMessageBox::Yes)
+        return;
 
-        XMLElement* regCourses = s->FirstChildElement("RegisteredCourses");
-        if (!regCourses) continue;
+    // students that lost an attempt are read back in the same job, so their
+    // rows can be redrawn without a reload
+    auto results = std::make_shared<QVector<QString>>();
+    auto changed = std::make_shared<QVector<Student>>();
+    StorageService::instance().run([changes, results, changed](Repository &repo, QString *error) mutable {
+        if (!repo.commitAll(&changes, results.get(), error))
+            return false;
+        QSet<QString> touched;
+        for (int i = 0; i < changes.size(); ++i)
+            if ((*results)[i].isEmpty() && changes[i].type == Mutation::DeleteAttempt)
+                touched.insert(changes[i].studentId);
+        for (const QString &id : touched) {
+            Student s;
+            if (repo.findStudent(id, &s))
+                changed->append(s);
+        }
+        return true;
+    }).then(this, [this, changes, results, changed](const StorageResult &r) {
+        if (!r.ok) {
+            QMessageBox::warning(this, "Error", "Delete failed.\n" + r.error);
+            return;
+        }
 
-        for (XMLElement *c = regCourses->FirstChildElement("CourseRegistration"); c; c = c->NextSiblingElement("CourseRegistration"))
-        {
-            const char* cid = c->Attribute("courseId");
-            if (!cid) continue;
-            if (courseId == QString(cid))
-            {
-                XMLElement* tests = c->FirstChildElement("TestRegistrations");
-                if (!tests) continue;
-
-                for (XMLElement *t = tests->FirstChildElement("TestRegistration"); t; t = t->NextSiblingElement("TestRegistration"))
-                {
-                    const char* tid = t->Attribute("testId");
-                    const char* att = t->Attribute("attempt");
-                    if (!tid) continue;
-                    if (testId == QString(tid) && attempt == QString(att))
-                    {
-                        tests->DeleteChild(t);
-                        doc.SaveFile(xmlFile.toUtf8().constData());
-                        return true;
-                    }
-                }
-            }
+        QStringList removed;
+        QStringList failures;
+        for (int i = 0; i < changes.size(); ++i) {
+            if (!(*results)[i].isEmpty())
+                failures << (*results)[i];
+            else if (changes[i].type == Mutation::DeleteStudent)
+                removed << changes[i].studentId;
         }
-    }
-    return false;
+        removeStudents(removed);
+        updateStudents(*changed);
+
+        if (!failures.isEmpty())
+            QMessageBox::warning(this, "Error",
+                                 QString("%1 of %2 could not be deleted: %3")
+                                     .arg(failures.size()).arg(changes.size()).arg(failures.first()));
+        else if (changes.size() > 1)
+            QMessageBox::information(this, "Deleted", QString("%1 records removed.").arg(changes.size()));
+        else if (removed.isEmpty())
+            QMessageBox::information(this, "Deleted", "Test record removed.");
+        else
+            QMessageBox::information(this, "Deleted", "Student removed.");
+    });
 }
 
-// Update test registration (attempt and username sync)
-bool adminDb::updateTestInXML(const QString &studentId, const QString &courseId,
-                              const QString &testId, const QString &oldAttempt,
-                              const QString &newAttempt, const QString &newUsername)
+// ------------------ XML operations ------------------
+// All edits go through the shared Repository, on the I/O thread; the
+// student is read back in the same job so only its rows are redrawn.
+void adminDb::commitAndRedraw(const QString &studentId, const StorageService::Job &change,
+                              const QString &done, const QString &failed)
 {
-    QString xmlFile = g_xmlPath + "users.xml";
-    XMLDocument doc;
-    if (doc.LoadFile(xmlFile.toUtf8().constData()) != XML_SUCCESS) return false;
-
-    XMLElement* root = doc.FirstChildElement("ELearningPlatform");
-    if (!root) return false;
-
-    XMLElement* students = root->FirstChildElement("Students");
-    if (!students) return false;
-
-    // Find the student by id
-    for (XMLElement *s = students->FirstChildElement("Student"); s; s = s->NextSiblingElement("Student"))
-    {
-        const char* aid = s->Attribute("id");
-        if (!(aid && studentId == QString(aid))) continue;
-
-        // Update username at student level (sync)
-        XMLElement* uEl = s->FirstChildElement("Username");
-        if (uEl) uEl->SetText(newUsername.toUtf8().constData());
-
-        XMLElement* regCourses = s->FirstChildElement("RegisteredCourses");
-        if (!regCourses) break;
-
-        // Find the course
-        for (XMLElement *c = regCourses->FirstChildElement("CourseRegistration"); c; c = c->NextSiblingElement("CourseRegistration"))
-        {
-            const char* cid = c->Attribute("courseId");
-            if (!cid) continue;
-            if (courseId != QString(cid))
-                continue;
-
-            XMLElement* tests = c->FirstChildElement("TestRegistrations");
-            if (!tests) break;
-
-            // Find the test registration with matching oldAttempt
-            for (XMLElement *t = tests->FirstChildElement("TestRegistration"); t; t = t->NextSiblingElement("TestRegistration"))
-            {
-                const char* tid = t->Attribute("testId");
-                const char* att = t->Attribute("attempt");
-                if (!tid) continue;
-                if (testId != QString(tid))
-                    continue;
-
-                if (oldAttempt != QString(att))
-                    continue;
-
-                // Only update attempt if allowed: oldAttempt == "2" and Grade == "F"
-                XMLElement* gradeEl = t->FirstChildElement("Grade");
-                QString grade = gradeEl && gradeEl->GetText() ? QString(gradeEl->GetText()).trimmed() : "";
-
-                if (oldAttempt == "2" && grade.toUpper() == "F")
-                {
-                    t->SetAttribute("attempt", newAttempt.toUtf8().constData());
-                }
-                // else: do not change attempt
-
-                doc.SaveFile(xmlFile.toUtf8().constData());
-                return true;
-            }
+    auto student = std::make_shared<Student>();
+    StorageService::instance().run([studentId, change, student](Repository &repo, QString *error) {
+        if (!change(repo, error))
+            return false;
+        repo.findStudent(studentId, student.get());
+        return true;
+    }).then(this, [this, student, done, failed](const StorageResult &r) {
+        if (!r.ok) {
+            QMessageBox::warning(this, "Error", failed + "\n" + r.error);
+            return;
         }
-    }
-    return false;
+        if (!student->id.isEmpty())
+            updateStudents({ *student });
+        QMessageBox::information(this, "Updated", done);
+    });
 }
@@ -2,14 +2,18 @@
 #define ADMINDB_H
 
 #include <QDialog>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QPointer>
+#include <QProgressDialog>
 #include <QTableWidget>
 #include <QPushButton>
 #include <QMessageBox>
 #include <QLineEdit>
 #include <QInputDialog>
-#include "tinyxml2.h"
-
-using namespace tinyxml2;
+#include "coursecatalog.h"
+#include "records.h"
+#include "storageservice.h"
 
 namespace Ui {
 class adminDb;
@@ -25,10 +29,7 @@ public:
 
 private slots:
     void onEditStudentClicked(int row);
-    void onDeleteStudentClicked(int row);
-
     void onEditTestClicked(int row);
-    void onDeleteTestClicked(int row);
 
     // helper slot used by buttons (determines row at click time)
     void onEditButtonClicked();
@@ -37,28 +38,35 @@ private slots:
 private:
     Ui::adminDb *ui;
 
+    QFutureWatcher<Student> m_roster;       // the roster being streamed in
+    bool m_staleRoster = false;             // changed while streaming; reload when done
+    int m_studentsShown = 0;
+    CourseCatalog m_catalog;
+    QPointer<QProgressDialog> m_progress;
+
     void loadXmlAndPopulateTable();
+    void appendStudentRows(const Student &s);
+    void insertStudentRows(int row, const Student &s, int displayIndex);
+
+    // targeted updates from the ChangeFeed
+    QHash<QString, int> headerRows() const;
+    void removeStudentRows(int row);
+    void updateStudents(const QVector<Student> &students);
+    void removeStudents(const QStringList &studentIds);
 
-    QString getCourseName(XMLDocument &doc, const QString &courseId);
-    QString getTestType(XMLDocument &doc, const QString &courseId, const QString &testId);
+    QString getCourseName(const QString &courseId);
+    QString getTestType(const QString &courseId, const QString &testId);
 
-    // student-level
-    bool deleteStudentFromXML(const QString &studentId);
-    bool updateStudentInXML(const QString &studentId,
-                            const QString &newUsername,
-                            const QString &newEmail,
-                            const QString &newPhone,
-                            const QString &newAddress);
+    // Delete the students and test records on these rows in one commit
+    void deleteRows(const QList<int> &rows);
 
-    // test-level
-    bool deleteTestFromXML(const QString &studentId, const QString &courseId,
-                           const QString &testId, const QString &attempt);
-    bool updateTestInXML(const QString &studentId, const QString &courseId,
-                         const QString &testId, const QString &oldAttempt,
-                         const QString &newAttempt, const QString &newUsername);
+    // Run `change` on the I/O thread, then redraw the student's rows
+    void commitAndRedraw(const QString &studentId, const StorageService::Job &change,
+                         const QString &done, const QString &failed);
 
     // Utility helpers
     int rowForWidget(QWidget *w) const;
+    QList<int> rowsForAction(int row) const;
     QPushButton* makeButton(const QString &text, const QString &stylePropName);
 };
 
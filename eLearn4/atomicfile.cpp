@@ -0,0 +1,181 @@
+#include "atomicfile.h"
+#include <QFileInfo>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#endif
+
+static const char kTrailerTag[] = "<!--crc32=";
+
+static bool fail(QString *error, const QString &text)
+{
+    if (error) *error = text;
+    return false;
+}
+
+// -----------------------------------------------------
+//  CHECKSUM
+// -----------------------------------------------------
+quint32 crc32(const char *data, qint64 size, quint32 crc)
+{
+    static quint32 table[256];
+    static const bool ready = [] {
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return true;
+    }();
+    Q_UNUSED(ready);
+
+    crc ^= 0xFFFFFFFFu;
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    for (qint64 i = 0; i < size; ++i)
+        crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+QByteArray checksumTrailer(quint32 crc)
+{
+    return kTrailerTag + QByteArray::number(crc, 16).rightJustified(8, '0') + "-->\n";
+}
+
+QByteArray checksumTrailer(const char *data, qint64 size)
+{
+    return checksumTrailer(crc32(data, size));
+}
+
+Checksum verifyChecksum(const QByteArray &data)
+{
+    qsizetype at = data.lastIndexOf(kTrailerTag);
+    if (at < 0)
+        return Checksum::Missing;       // hand-edited or written before trailers existed
+
+    const QByteArray trailer = data.mid(at).trimmed();
+    if (trailer != checksumTrailer(data.constData(), at).trimmed())
+        return Checksum::Invalid;
+    return Checksum::Valid;
+}
+
+// Bytes are checksummed as they stream past, except for a short tail held
+// back because the trailer may start in it
+Checksum verifyChecksum(QFile &f)
+{
+    static const qsizetype kHold = 64;
+
+    quint32 crc = 0;
+    QByteArray held;
+    QByteArray chunk(1 << 16, Qt::Uninitialized);
+    f.seek(0);
+    for (;;) {
+        const qint64 n = f.read(chunk.data(), chunk.size());
+        if (n <= 0)
+            break;
+        held.append(chunk.constData(), n);
+        if (held.size() > kHold) {
+            const qsizetype done = held.size() - kHold;
+            crc = crc32(held.constData(), done, crc);
+            held.remove(0, done);
+        }
+    }
+    f.seek(0);
+
+    const qsizetype at = held.lastIndexOf(kTrailerTag);
+    if (at < 0)
+        return Checksum::Missing;
+    crc = crc32(held.constData(), at, crc);
+    return held.mid(at).trimmed() == checksumTrailer(crc).trimmed() ? Checksum::Valid
+                                                                    : Checksum::Invalid;
+}
+
+// -----------------------------------------------------
+//  SYNC / RENAME
+// -----------------------------------------------------
+bool syncFile(QFile &f)
+{
+    if (!f.flush())
+        return false;
+#ifdef Q_OS_WIN
+    HANDLE h = reinterpret_cast<HANDLE>(_get_osfhandle(f.handle()));
+    return h != INVALID_HANDLE_VALUE && FlushFileBuffers(h);
+#else
+    return ::fsync(f.handle()) == 0;
+#endif
+}
+
+// Make a rename durable. NTFS journals its metadata and the move below is
+// write-through, so only POSIX needs the directory itself synced.
+static void syncDir(const QString &dir)
+{
+#ifndef Q_OS_WIN
+    int fd = ::open(QFile::encodeName(dir).constData(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#else
+    Q_UNUSED(dir);
+#endif
+}
+
+static bool swapIn(const QString &tmp, const QString &path, bool keepBackup)
+{
+    const QString bak = path + ".bak";
+#ifdef Q_OS_WIN
+    const std::wstring from = QFileInfo(tmp).absoluteFilePath().toStdWString();
+    const std::wstring to   = QFileInfo(path).absoluteFilePath().toStdWString();
+    const std::wstring back = QFileInfo(bak).absoluteFilePath().toStdWString();
+    if (keepBackup && QFile::exists(path))
+        return ReplaceFileW(to.c_str(), from.c_str(), back.c_str(),
+                            REPLACEFILE_IGNORE_MERGE_ERRORS, nullptr, nullptr);
+    return MoveFileExW(from.c_str(), to.c_str(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    if (keepBackup && QFile::exists(path)) {
+        // hard link the current file as .bak so <path> never goes missing
+        ::unlink(QFile::encodeName(bak).constData());
+        ::link(QFile::encodeName(path).constData(), QFile::encodeName(bak).constData());
+    }
+    return ::rename(QFile::encodeName(tmp).constData(), QFile::encodeName(path).constData()) == 0;
+#endif
+}
+
+bool writeSyncedFile(const QString &path, const char *data, qint64 size, QString *error)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return fail(error, "Could not create " + path + ": " + f.errorString());
+
+    if (f.write(data, size) != size || !syncFile(f)) {
+        QString why = f.errorString();
+        f.close();
+        f.remove();
+        return fail(error, "Could not write " + path + ": " + why);
+    }
+    return true;
+}
+
+bool replaceFile(const QString &from, const QString &path, bool keepBackup, QString *error)
+{
+    if (!swapIn(from, path, keepBackup)) {
+        QFile::remove(from);
+        return fail(error, "Could not replace " + path);
+    }
+    syncDir(QFileInfo(path).absolutePath());
+    return true;
+}
+
+bool writeFileAtomic(const QString &path, const char *data, qint64 size,
+                     bool keepBackup, QString *error)
+{
+    const QString tmp = path + ".tmp";
+    return writeSyncedFile(tmp, data, size, error)
+        && replaceFile(tmp, path, keepBackup, error);
+}
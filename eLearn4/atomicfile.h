@@ -0,0 +1,42 @@
+// atomicfile.h
+#ifndef ATOMICFILE_H
+#define ATOMICFILE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+// Crash-safe replacement of a data file. The new contents go to
+// "<path>.tmp", are synced to the device and renamed over <path>, then the
+// directory entry is synced; a crash at any point leaves either the old or
+// the new file, never a truncated one. With keepBackup the replaced file
+// stays behind as "<path>.bak", the last good generation to fall back to.
+bool writeFileAtomic(const QString &path, const char *data, qint64 size,
+                     bool keepBackup, QString *error = nullptr);
+
+// The same in two steps, for writers that do the slow part outside a lock:
+// writeSyncedFile() writes and syncs a side file, replaceFile() swaps it in.
+bool writeSyncedFile(const QString &path, const char *data, qint64 size,
+                     QString *error = nullptr);
+bool replaceFile(const QString &from, const QString &path, bool keepBackup,
+                 QString *error = nullptr);
+
+// Flush an open file's data to the device (fsync / FlushFileBuffers)
+bool syncFile(QFile &f);
+
+// Checksum trailer: a final line "<!--crc32=xxxxxxxx-->" covering every
+// byte before it. It is an XML comment, so the file still parses anywhere.
+enum class Checksum { Valid, Missing, Invalid };
+
+// Pass a previous result as `crc` to continue over the next piece
+quint32 crc32(const char *data, qint64 size, quint32 crc = 0);
+QByteArray checksumTrailer(const char *data, qint64 size);
+// The same from the crc32() of those bytes, for output written in pieces
+QByteArray checksumTrailer(quint32 crc);
+Checksum verifyChecksum(const QByteArray &data);
+
+// The same for an open file, read in pieces (constant memory); leaves the
+// file positioned at the start
+Checksum verifyChecksum(QFile &f);
+
+#endif // ATOMICFILE_H
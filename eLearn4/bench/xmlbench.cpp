@@ -0,0 +1,96 @@
+// Throughput of the vendored tinyxml2 on generated users.xml-shaped data.
+//
+//   xmlbench [megabytes] [scratch file]
+//
+// Prints MB/s, best of several runs: "parse" from memory, "save" the
+// parsed document to the scratch file (xmlbench.tmp by default, removed
+// afterwards). Compare a normal build with one built with
+// TINYXML2_NO_SIMD (the scalar scanners).
+#include <tinyxml2.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace tinyxml2;
+
+static const int kRuns = 5;
+
+// A roster like users.xml: indented elements, attributes, short text and
+// the odd entity, about `bytes` long
+static std::string generate(size_t bytes)
+{
+    std::string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<ELearningPlatform>\n    <Students>\n";
+    for (int i = 0; xml.size() < bytes; ++i) {
+        char student[1024];
+        snprintf(student, sizeof student,
+                 "        <Student id=\"S%06d\">\n"
+                 "            <Username>user%d</Username>\n"
+                 "            <Password>pw-%08x</Password>\n"
+                 "            <Email>user%d@example.com</Email>\n"
+                 "            <Address>%d Long Street &amp; Sons, Some Town</Address>\n"
+                 "            <RegisteredCourses>\n"
+                 "                <CourseRegistration courseId=\"C%03d\">\n"
+                 "                    <RegistrationDate>2024-01-%02d</RegistrationDate>\n"
+                 "                    <TestRegistrations>\n"
+                 "                        <TestRegistration testId=\"T%03d\" attempt=\"1\">\n"
+                 "                            <Score>%d</Score>\n"
+                 "                            <Result>Pass</Result>\n"
+                 "                            <Grade>B</Grade>\n"
+                 "                        </TestRegistration>\n"
+                 "                    </TestRegistrations>\n"
+                 "                    <Certificate><Status>Issued</Status></Certificate>\n"
+                 "                </CourseRegistration>\n"
+                 "            </RegisteredCourses>\n"
+                 "        </Student>\n",
+                 i, i, static_cast<unsigned>(i) * 2654435761u, i, i, i % 40, i % 28 + 1, i % 90, i % 101);
+        xml += student;
+    }
+    return xml + "    </Students>\n</ELearningPlatform>\n";
+}
+
+template <typename Run>
+static double bestSeconds(Run run)
+{
+    double best = 1e30;
+    for (int i = 0; i < kRuns; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        const double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (s < best)
+            best = s;
+    }
+    return best;
+}
+
+static void report(const char *what, size_t bytes, double seconds)
+{
+    printf("%-8s %8.1f MB/s\n", what, bytes / seconds / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    const size_t megabytes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 64;
+    const char *scratch = argc > 2 ? argv[2] : "xmlbench.tmp";
+    const std::string xml = generate(megabytes * 1000 * 1000);
+    printf("%.1f MB of XML\n", xml.size() / 1e6);
+
+    XMLDocument doc;
+    report("parse", xml.size(), bestSeconds([&] {
+        if (doc.Parse(xml.c_str(), xml.size()) != XML_SUCCESS) {
+            fprintf(stderr, "parse failed: %s\n", doc.ErrorStr());
+            exit(1);
+        }
+    }));
+
+    XMLPrinter printed;
+    doc.Print(&printed);
+    report("save", printed.CStrSize() - 1, bestSeconds([&] {
+        if (doc.SaveFile(scratch) != XML_SUCCESS) {
+            fprintf(stderr, "save failed: %s\n", doc.ErrorStr());
+            exit(1);
+        }
+    }));
+    remove(scratch);
+    return 0;
+}
@@ -0,0 +1,12 @@
+# Standalone throughput benchmark for the vendored tinyxml2; not part of
+# the app. Build the "before" side of a comparison with
+#   qmake "DEFINES += TINYXML2_NO_SIMD"
+TEMPLATE = app
+CONFIG  += console c++17 release
+CONFIG  -= qt app_bundle
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    xmlbench.cpp \
+    ../tinyxml2.cpp
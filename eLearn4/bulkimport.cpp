@@ -0,0 +1,558 @@
+#include "bulkimport.h"
+#include <QAtomicInt>
+#include <QDate>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cstring>
+#include "coursecatalog.h"
+#include "idallocator.h"
+#include "mutation.h"
+#include "repository.h"
+#include "usersxml.h"
+
+using namespace tinyxml2;
+
+static const qsizetype kChunkBytes = 1 << 20;  // bytes of batch per parse task
+static const int kReportEvery = 65536;         // records between "check" progress calls
+
+// One record of the batch
+struct ImportRecord
+{
+    enum Kind { NewStudent, Enroll, Attempt, Certificate };    // also the commit order
+
+    Kind    kind = NewStudent;
+    int     line = 0;
+    QString username;
+    QString password;
+    QString email;
+    QString phone;
+    QString address;
+    QString courseId;
+    QString date;
+    TestRegistration test;
+
+    QString studentId;      // resolved just before the commit
+    QString error;          // empty while the record is good
+};
+
+// Byte range of the batch parsed by one task. Ranges are contiguous and
+// end on a line (CSV) or element (XML) boundary.
+struct ImportChunk
+{
+    qsizetype begin = 0;
+    qsizetype end   = 0;
+};
+
+struct ParsedChunk
+{
+    QVector<ImportRecord> records;  // lines counted from the chunk start
+    int lines = 0;                  // line breaks in the chunk
+};
+
+static bool fail(QString *error, const QString &text)
+{
+    if (error) *error = text;
+    return false;
+}
+
+static const char *kindName(ImportRecord::Kind kind)
+{
+    switch (kind) {
+    case ImportRecord::NewStudent:  return "student";
+    case ImportRecord::Enroll:      return "enroll";
+    case ImportRecord::Attempt:     return "attempt";
+    case ImportRecord::Certificate: return "certificate";
+    }
+    return "";
+}
+
+// -----------------------------------------------------
+//  CSV
+// -----------------------------------------------------
+// Cut the batch into ~kChunkBytes pieces that end after a line break
+static QVector<ImportChunk> splitLines(const QByteArray &bytes)
+{
+    QVector<ImportChunk> chunks;
+    for (qsizetype begin = 0; begin < bytes.size();) {
+        qsizetype end = qMin(begin + kChunkBytes, bytes.size());
+        if (end < bytes.size()) {
+            const qsizetype eol = bytes.indexOf('\n', end - 1);
+            end = eol < 0 ? bytes.size() : eol + 1;
+        }
+        chunks.append(ImportChunk{ begin, end });
+        begin = end;
+    }
+    return chunks;
+}
+
+static bool isBlank(const char *p, const char *end)
+{
+    for (; p < end; ++p)
+        if (*p != ' ' && *p != '\t')
+            return false;
+    return true;
+}
+
+// Split one line into fields; false on an unterminated quote
+static bool splitCsv(const char *p, const char *end, QStringList *fields)
+{
+    fields->clear();
+    QByteArray field;
+    bool quoted = false;
+    for (; p < end; ++p) {
+        const char c = *p;
+        if (quoted) {
+            if (c != '"') {
+                field.append(c);
+            } else if (p + 1 < end && p[1] == '"') {
+                field.append('"');
+                ++p;
+            } else {
+                quoted = false;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields->append(QString::fromUtf8(field).trimmed());
+            field.clear();
+        } else {
+            field.append(c);
+        }
+    }
+    fields->append(QString::fromUtf8(field).trimmed());
+    return !quoted;
+}
+
+static void recordFromCsv(const QStringList &f, ImportRecord *r)
+{
+    const QString kind = f.value(0).toLower();
+    r->username = f.value(1);
+
+    if (kind == "student") {
+        r->kind     = ImportRecord::NewStudent;
+        r->password = f.value(2);
+        r->email    = f.value(3);
+        r->phone    = f.value(4);
+        r->address  = f.value(5);
+        if (f.size() < 3 || f.size() > 6)
+            r->error = "Expected student,username,password[,email,phone,address]";
+    } else if (kind == "enroll" || kind == "certificate") {
+        r->kind     = kind == "enroll" ? ImportRecord::Enroll : ImportRecord::Certificate;
+        r->courseId = f.value(2);
+        r->date     = f.value(3);
+        if (f.size() != 4)
+            r->error = "Expected " + kind + ",username,courseId,date";
+    } else if (kind == "attempt") {
+        bool ok = false;
+        r->kind        = ImportRecord::Attempt;
+        r->courseId    = f.value(2);
+        r->test.testId = f.value(3);
+        r->test.score  = f.value(4).toInt(&ok);
+        r->test.grade  = f.value(5).toUpper();
+        if (f.size() != 6)
+            r->error = "Expected attempt,username,courseId,testId,score,grade";
+        else if (!ok)
+            r->error = "Invalid score \"" + f.value(4) + "\"";
+    } else {
+        r->error = "Unknown record type \"" + f.value(0) + "\"";
+    }
+}
+
+static ParsedChunk parseCsv(const QByteArray &bytes, const ImportChunk &chunk)
+{
+    ParsedChunk out;
+    const char *p   = bytes.constData() + chunk.begin;
+    const char *end = bytes.constData() + chunk.end;
+    QStringList fields;
+    while (p < end) {
+        const char *eol  = static_cast<const char *>(memchr(p, '\n', end - p));
+        const char *last = eol ? eol : end;
+        if (last > p && last[-1] == '\r')
+            --last;
+
+        if (!isBlank(p, last) && *p != '#') {
+            ImportRecord r;
+            r.line = out.lines + 1;
+            if (splitCsv(p, last, &fields))
+                recordFromCsv(fields, &r);
+            else
+                r.error = "Unterminated quote";
+            out.records.append(r);
+        }
+        if (!eol)
+            break;
+        out.lines++;
+        p = eol + 1;
+    }
+    return out;
+}
+
+// -----------------------------------------------------
+//  XML
+// -----------------------------------------------------
+// Cut the batch into ~kChunkBytes pieces that end after a </Student>
+static QVector<ImportChunk> splitStudents(const QByteArray &bytes)
+{
+    QVector<ImportChunk> chunks;
+    qsizetype begin = 0, pos = 0, end = 0;
+    for (qsizetype at = findStudentElement(bytes, pos, &end); at >= 0 && end >= 0;
+         at = findStudentElement(bytes, pos, &end)) {
+        pos = end;
+        if (pos - begin >= kChunkBytes) {
+            chunks.append(ImportChunk{ begin, pos });
+            begin = pos;
+        }
+    }
+    // the tail keeps whatever is left, an unclosed element included
+    if (begin < bytes.size())
+        chunks.append(ImportChunk{ begin, bytes.size() });
+    return chunks;
+}
+
+// A <Student> and everything recorded under it, in the order it happened
+static void recordsFromStudent(const Student &s, int line, QVector<ImportRecord> *out)
+{
+    ImportRecord r;
+    r.line     = line;
+    r.kind     = ImportRecord::NewStudent;
+    r.username = s.username;
+    r.password = s.password;
+    r.email    = s.email;
+    r.phone    = s.phone;
+    r.address  = s.address;
+    out->append(r);
+
+    for (const CourseRegistration &reg : s.courses) {
+        ImportRecord e;
+        e.line     = line;
+        e.username = s.username;
+        e.courseId = reg.courseId;
+        e.kind     = ImportRecord::Enroll;
+        e.date     = reg.registrationDate;
+        out->append(e);
+
+        QVector<TestRegistration> tests = reg.tests;
+        std::stable_sort(tests.begin(), tests.end(),
+                         [](const TestRegistration &a, const TestRegistration &b) {
+                             return a.attempt < b.attempt;
+                         });
+        for (const TestRegistration &t : tests) {
+            ImportRecord a = e;
+            a.kind = ImportRecord::Attempt;
+            a.date.clear();
+            a.test = t;
+            out->append(a);
+        }
+
+        if (reg.certificateIssued()) {
+            ImportRecord c = e;
+            c.kind = ImportRecord::Certificate;
+            c.date = reg.certificateIssueDate;
+            out->append(c);
+        }
+    }
+}
+
+static ParsedChunk parseXml(const QByteArray &bytes, const ImportChunk &chunk)
+{
+    ParsedChunk out;
+    const QByteArray slice = QByteArray::fromRawData(bytes.constData() + chunk.begin,
+                                                     chunk.end - chunk.begin);
+    const char *data = slice.constData();
+    XMLDocument doc;            // one per chunk; each parse reuses its node pools
+    qsizetype pos = 0, end = 0, counted = 0;
+    for (qsizetype at = findStudentElement(slice, pos, &end); at >= 0;
+         at = findStudentElement(slice, pos, &end)) {
+        out.lines += std::count(data + counted, data + at, '\n');
+        counted = at;
+
+        if (end < 0 || doc.Parse(data + at, end - at) != XML_SUCCESS) {
+            ImportRecord r;
+            r.line  = out.lines + 1;
+            r.error = end < 0 ? QString("Unclosed <Student>")
+                              : "Malformed <Student>: " + QString::fromUtf8(doc.ErrorStr());
+            out.records.append(r);
+            if (end < 0)
+                break;
+        } else {
+            recordsFromStudent(studentFromXml(doc.RootElement()), out.lines + 1, &out.records);
+        }
+        pos = end;
+    }
+    out.lines += std::count(data + counted, data + slice.size(), '\n');
+    return out;
+}
+
+// -----------------------------------------------------
+//  CHECKS
+// -----------------------------------------------------
+// What can be decided from the record and the catalog alone
+static void check(ImportRecord *r, const CourseCatalog &catalog)
+{
+    if (!r->error.isEmpty())
+        return;
+    if (r->username.isEmpty()) {
+        r->error = "Missing username";
+        return;
+    }
+
+    switch (r->kind) {
+    case ImportRecord::NewStudent:
+        if (r->password.isEmpty())
+            r->error = "Missing password";
+        break;
+
+    case ImportRecord::Enroll:
+    case ImportRecord::Certificate:
+        if (!catalog.course(r->courseId))
+            r->error = "Unknown course \"" + r->courseId + "\"";
+        else if (!QDate::fromString(r->date, "yyyy-MM-dd").isValid())
+            r->error = "Invalid date \"" + r->date + "\" (expected yyyy-MM-dd)";
+        break;
+
+    case ImportRecord::Attempt:
+        if (!catalog.course(r->courseId))
+            r->error = "Unknown course \"" + r->courseId + "\"";
+        else if (!catalog.test(r->courseId, r->test.testId))
+            r->error = "Unknown test \"" + r->test.testId + "\" in " + r->courseId;
+        else if (r->test.score < 0 || r->test.score > 100)
+            r->error = "Score " + QString::number(r->test.score) + " is not within 0-100";
+        else if (r->test.grade != "A" && r->test.grade != "B" && r->test.grade != "C"
+                 && r->test.grade != "F")
+            r->error = "Invalid grade \"" + r->test.grade + "\"";
+        else
+            r->test.result = r->test.grade == "F" ? "Fail" : "Pass";
+        break;
+    }
+}
+
+// Against the roster: new usernames must be free, the rest must name a
+// student. New students get ids from a single reservation.
+static bool resolve(QVector<ImportRecord> *records, Repository &repo, QString *error)
+{
+    QHash<QString, int> fresh;      // username -> its student record
+    QSet<QString> rejected;         // usernames whose student record failed
+    for (int i = 0; i < records->size(); ++i) {
+        ImportRecord &r = (*records)[i];
+        if (r.kind != ImportRecord::NewStudent)
+            continue;
+        if (r.error.isEmpty() && fresh.contains(r.username))
+            r.error = "Username already registered on line "
+                      + QString::number(records->at(fresh.value(r.username)).line);
+        else if (r.error.isEmpty() && repo.usernameExists(r.username))
+            r.error = "Username already exists!";
+        if (r.error.isEmpty())
+            fresh.insert(r.username, i);
+        else
+            rejected.insert(r.username);
+    }
+
+    if (!fresh.isEmpty()) {
+        quint64 next = 0;
+        if (!repo.reserveStudentIds(fresh.size(), &next, error))
+            return false;
+        for (ImportRecord &r : *records)
+            if (r.kind == ImportRecord::NewStudent && r.error.isEmpty())
+                r.studentId = IdAllocator::format(next++);
+    }
+
+    QHash<QString, QString> onFile;     // username -> id, empty when unknown
+    for (ImportRecord &r : *records) {
+        if (r.kind == ImportRecord::NewStudent || !r.error.isEmpty())
+            continue;
+        auto it = fresh.constFind(r.username);
+        if (it != fresh.constEnd()) {
+            r.studentId = records->at(it.value()).studentId;
+            continue;
+        }
+        if (!onFile.contains(r.username)) {
+            Student s;
+            onFile.insert(r.username, repo.findStudentByUsername(r.username, &s) ? s.id : QString());
+        }
+        r.studentId = onFile.value(r.username);
+        if (r.studentId.isEmpty())
+            r.error = rejected.contains(r.username) ? "The student record for " + r.username + " was rejected"
+                                                    : "Unknown student " + r.username;
+    }
+    return true;
+}
+
+// -----------------------------------------------------
+//  COMMIT
+// -----------------------------------------------------
+// The good records as mutations; (*owner)[k] is the record behind change k
+static QVector<Mutation> toMutations(const QVector<ImportRecord> &records, QVector<int> *owner)
+{
+    QVector<Mutation> changes;
+    changes.reserve(records.size());
+    for (int i = 0; i < records.size(); ++i) {
+        const ImportRecord &r = records[i];
+        if (!r.error.isEmpty())
+            continue;
+
+        Mutation m;
+        m.studentId = r.studentId;
+        m.courseId  = r.courseId;
+        m.date      = r.date;
+        switch (r.kind) {
+        case ImportRecord::NewStudent:
+            m.type     = Mutation::RegisterStudent;
+            m.username = r.username;
+            m.password = r.password;
+            break;
+        case ImportRecord::Enroll:
+            m.type = Mutation::Enroll;
+            break;
+        case ImportRecord::Attempt:
+            m.type = Mutation::RecordAttempt;
+            m.test = r.test;
+            break;
+        case ImportRecord::Certificate:
+            m.type = Mutation::IssueCertificate;
+            break;
+        }
+        changes.append(m);
+        owner->append(i);
+
+        // registration only takes the login; the profile follows
+        if (r.kind == ImportRecord::NewStudent
+            && !(r.email.isEmpty() && r.phone.isEmpty() && r.address.isEmpty())) {
+            Mutation u;
+            u.type      = Mutation::UpdateStudent;
+            u.studentId = r.studentId;
+            u.username  = r.username;
+            u.email     = r.email;
+            u.phone     = r.phone;
+            u.address   = r.address;
+            changes.append(u);
+            owner->append(i);
+        }
+    }
+    return changes;
+}
+
+static QByteArray csvField(const QString &text)
+{
+    QByteArray f = text.toUtf8();
+    if (!f.contains(',') && !f.contains('"') && !f.contains('\n'))
+        return f;
+    f.replace("\"", "\"\"");
+    return '"' + f + '"';
+}
+
+static bool writeErrors(const QString &path, const QVector<const ImportRecord *> &rejected,
+                        QString *error)
+{
+    QByteArray out = "line,type,username,error\n";
+    for (const ImportRecord *r : rejected)
+        out += QByteArray::number(r->line) + ',' + kindName(r->kind) + ','
+               + csvField(r->username) + ',' + csvField(r->error) + '\n';
+
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate) || f.write(out) != out.size())
+        return fail(error, "Could not write " + path + ": " + f.errorString());
+    return true;
+}
+
+// -----------------------------------------------------
+//  RUN
+// -----------------------------------------------------
+void BulkImport::progress(const QString &stage, qint64 done, qint64 total)
+{
+    if (!m_progress)
+        return;
+    QMutexLocker locker(&m_progressMutex);
+    m_progress(stage, done, total);
+}
+
+bool BulkImport::run(const QString &path, ImportReport *report, QString *error)
+{
+    *report = ImportReport();
+    Repository &repo = Repository::instance();
+    if (!repo.isLoaded())
+        return fail(error, "Student data is not loaded");
+
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly))
+        return fail(error, "Could not open " + path + ": " + f.errorString());
+    const qint64 size = f.size();
+    uchar *data = size > 0 ? f.map(0, size) : nullptr;
+    const QByteArray bytes = data ? QByteArray::fromRawData(reinterpret_cast<const char *>(data), size)
+                                  : f.readAll();
+
+    // parse: records keep their line numbers, chunk-relative until merged
+    const bool xml = QFileInfo(path).suffix().compare("xml", Qt::CaseInsensitive) == 0;
+    const QVector<ImportChunk> chunks = xml ? splitStudents(bytes) : splitLines(bytes);
+    QAtomicInteger<qint64> parsedBytes = 0;
+    const QVector<ParsedChunk> parsed = QtConcurrent::blockingMapped<QVector<ParsedChunk>>(chunks,
+        [this, &bytes, &parsedBytes, xml](const ImportChunk &c) {
+            ParsedChunk out = xml ? parseXml(bytes, c) : parseCsv(bytes, c);
+            progress("parse", parsedBytes.fetchAndAddOrdered(c.end - c.begin) + (c.end - c.begin),
+                     bytes.size());
+            return out;
+        });
+
+    QVector<ImportRecord> records;
+    int lines = 0;
+    for (const ParsedChunk &c : parsed) {
+        for (ImportRecord r : c.records) {
+            r.line += lines;
+            records.append(r);
+        }
+        lines += c.lines;
+    }
+    if (data)
+        f.unmap(data);
+    f.close();
+
+    // check against the catalog
+    const CourseCatalog catalog = repo.catalog();
+    const int total = records.size();
+    QAtomicInt checked = 0;
+    QtConcurrent::blockingMap(records, [this, &catalog, &checked, total](ImportRecord &r) {
+        check(&r, catalog);
+        const int count = checked.fetchAndAddOrdered(1) + 1;
+        if (count % kReportEvery == 0 || count == total)
+            progress("check", count, total);
+    });
+
+    // students first, then enrollments, attempts and certificates, each in
+    // batch order, so every change finds what it builds on
+    std::stable_sort(records.begin(), records.end(),
+                     [](const ImportRecord &a, const ImportRecord &b) { return a.kind < b.kind; });
+    if (!resolve(&records, repo, error))
+        return false;
+
+    QVector<int> owner;
+    QVector<Mutation> changes = toMutations(records, &owner);
+    progress("commit", 0, changes.size());
+    QVector<QString> results;
+    if (!changes.isEmpty() && !repo.commitAll(&changes, &results, error))
+        return false;
+    for (int k = 0; k < changes.size(); ++k) {
+        ImportRecord &r = records[owner[k]];
+        if (r.error.isEmpty() && !results.value(k).isEmpty())
+            r.error = results.value(k);
+    }
+    progress("commit", changes.size(), changes.size());
+
+    QVector<const ImportRecord *> rejected;
+    for (const ImportRecord &r : records)
+        if (!r.error.isEmpty())
+            rejected.append(&r);
+    std::stable_sort(rejected.begin(), rejected.end(),
+                     [](const ImportRecord *a, const ImportRecord *b) { return a->line < b->line; });
+
+    report->records  = records.size();
+    report->rejected = rejected.size();
+    report->imported = report->records - report->rejected;
+    if (rejected.isEmpty())
+        return true;
+    report->errorFile = m_errorFile.isEmpty() ? path + ".errors.csv" : m_errorFile;
+    return writeErrors(report->errorFile, rejected, error);
+}
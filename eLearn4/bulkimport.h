@@ -0,0 +1,64 @@
+// bulkimport.h
+#ifndef BULKIMPORT_H
+#define BULKIMPORT_H
+
+#include <QMutex>
+#include <QString>
+#include <functional>
+
+// Registers a whole intake in one go: students, enrollments, historical
+// attempts and certificates from a batch file, instead of one registerBtn
+// click (and one commit) per student.
+//
+// CSV batches hold one record per line. Fields are comma-separated and
+// "quoted" when they contain a comma or a quote ("" for a quote); a field
+// cannot span lines. Blank lines and lines starting with # are skipped.
+//
+//   student,<username>,<password>[,<email>,<phone>,<address>]
+//   enroll,<username>,<courseId>,<yyyy-MM-dd>
+//   attempt,<username>,<courseId>,<testId>,<score 0-100>,<grade A|B|C|F>
+//   certificate,<username>,<courseId>,<yyyy-MM-dd>
+//
+// <username> names a student registered by the same batch or one already
+// on file. XML batches (*.xml) hold <Student> elements in the users.xml
+// layout. Each one is registered as a new student, together with its
+// course registrations, attempts and certificates; its id attribute is
+// ignored.
+//
+// Records are parsed and checked against the catalog across threads. New
+// students get their ids from one reservation, and everything goes in as
+// a single commit. A rejected record never stops the others; it is written
+// to the error file with its line number and the reason.
+struct ImportReport
+{
+    int records  = 0;
+    int imported = 0;
+    int rejected = 0;
+    QString errorFile;      // empty when nothing was rejected
+};
+
+class BulkImport
+{
+public:
+    // stage is "parse", "check" or "commit". Called from worker
+    // threads too, but never concurrently.
+    using Progress = std::function<void(const QString &stage, qint64 done, qint64 total)>;
+
+    // Defaults to <batch file>.errors.csv
+    void setErrorFile(const QString &path) { m_errorFile = path; }
+    void setProgress(const Progress &progress) { m_progress = progress; }
+
+    // Needs a loaded Repository. False only when the batch could not be
+    // read or the commit failed as a whole; rejected records are counted in
+    // *report and listed in the error file.
+    bool run(const QString &path, ImportReport *report, QString *error = nullptr);
+
+private:
+    void progress(const QString &stage, qint64 done, qint64 total);
+
+    QString  m_errorFile;
+    Progress m_progress;
+    QMutex   m_progressMutex;
+};
+
+#endif // BULKIMPORT_H
@@ -0,0 +1,249 @@
+#include "changefeed.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <memory>
+#include "repository.h"
+#include "storageservice.h"
+#include "tinyxml2.h"
+
+using namespace tinyxml2;
+
+static const int kSettleMs = 250;
+static const int kMaxListed = 4096;     // changed students listed before it becomes a reset
+
+struct ChangeFeed::Diff
+{
+    QVector<Student> changed;
+    QStringList removed;
+    bool reset   = false;
+    bool catalog = false;
+    QStringList testBank;
+};
+
+static size_t fingerprint(const Student &s)
+{
+    size_t h = qHashMulti(0, s.id, s.username, s.password, s.email, s.phone, s.address);
+    for (const CourseRegistration &r : s.courses) {
+        h = qHashMulti(h, r.courseId, r.registrationDate, r.certificateStatus,
+                       r.certificateIssueDate);
+        for (const TestRegistration &t : r.tests)
+            h = qHashMulti(h, t.testId, t.attempt, t.score, t.result, t.grade);
+    }
+    return h;
+}
+
+static size_t fingerprint(const QVector<Course> &courses)
+{
+    size_t h = 0;
+    for (const Course &c : courses) {
+        h = qHashMulti(h, c.id, c.name, c.description);
+        for (const CourseTest &t : c.tests)
+            h = qHashMulti(h, t.id, t.type, t.totalMarks);
+    }
+    return h;
+}
+
+ChangeFeed &ChangeFeed::instance()
+{
+    static ChangeFeed feed;
+    return feed;
+}
+
+ChangeFeed::ChangeFeed()
+{
+    m_settle.setSingleShot(true);
+    m_settle.setInterval(kSettleMs);
+    connect(&m_settle, &QTimer::timeout, this, &ChangeFeed::scan);
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &ChangeFeed::changed);
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &ChangeFeed::changed);
+}
+
+void ChangeFeed::watch(const QString &dataDir)
+{
+    m_testBankPath = dataDir + "testBank.xml";
+    m_paths = Repository::instance().watchedFiles();
+    m_paths << m_testBankPath << dataDir;
+    rewatch();
+    scan();
+}
+
+void ChangeFeed::changed()
+{
+    m_settle.start();
+}
+
+// Files replaced by a rename drop out of the watcher; add them back
+void ChangeFeed::rewatch()
+{
+    const QStringList watched = m_watcher.files() + m_watcher.directories();
+    for (const QString &path : std::as_const(m_paths))
+        if (!watched.contains(path) && QFileInfo::exists(path))
+            m_watcher.addPath(path);
+}
+
+// -----------------------------------------------------
+//  SCAN
+// -----------------------------------------------------
+// One scan at a time; changes during it queue exactly one more
+void ChangeFeed::scan()
+{
+    if (m_scanning) {
+        m_rescan = true;
+        return;
+    }
+    m_scanning = true;
+
+    const bool baseline = !m_primed;
+    auto diff = std::make_shared<Diff>();
+    StorageService::instance().run([this, diff, baseline](Repository &repo, QString *error) {
+        if (!repo.refresh(error))
+            return false;
+        if (!diffStudents(repo, baseline, diff.get(), error))
+            return false;
+        diffTestBank(baseline, diff.get());
+        return true;
+    }).then(this, [this, diff, baseline](const StorageResult &r) {
+        m_scanning = false;
+        rewatch();
+        if (!r.ok)
+            qWarning() << "change feed:" << r.error;
+        else if (baseline)
+            m_primed = true;
+        else
+            publish(*diff);
+
+        if (m_rescan) {
+            m_rescan = false;
+            scan();
+        }
+    });
+}
+
+void ChangeFeed::publish(const Diff &diff)
+{
+    if (diff.reset) {
+        emit rosterReset();
+    } else {
+        if (!diff.changed.isEmpty())
+            emit studentsChanged(diff.changed);
+        if (!diff.removed.isEmpty())
+            emit studentsRemoved(diff.removed);
+    }
+    if (diff.catalog)
+        emit catalogChanged();
+    if (!diff.testBank.isEmpty())
+        emit testBankChanged(diff.testBank);
+}
+
+// The fingerprints only move on once the whole roster was read, so a read
+// that fails is retried by the next scan
+bool ChangeFeed::diffStudents(Repository &repo, bool baseline, Diff *diff, QString *error)
+{
+    const size_t catalog = fingerprint(repo.catalog().courses());
+    diff->catalog = !baseline && catalog != m_catalog;
+    m_catalog = catalog;
+
+    const quint64 generation = repo.generation();
+    if (!baseline && (generation == m_generation || diffChanges(repo, diff)))
+        return true;
+
+    QHash<QString, size_t> seen;
+    seen.reserve(m_students.size());
+    const bool read = repo.forEachStudent([&](const Student &s) {
+        const size_t print = fingerprint(s);
+        seen.insert(s.id, print);
+        if (baseline || diff->reset)
+            return true;
+        auto it = m_students.constFind(s.id);
+        if (it == m_students.constEnd() || it.value() != print) {
+            diff->changed.append(s);
+            if (diff->changed.size() > kMaxListed) {
+                diff->reset = true;
+                diff->changed.clear();
+            }
+        }
+        return true;
+    }, LoadProgress(), error);
+    if (!read) {
+        diff->changed.clear();
+        diff->reset = false;
+        return false;
+    }
+
+    m_generation = generation;
+    if (!baseline && !diff->reset)
+        for (auto it = m_students.constBegin(); it != m_students.constEnd(); ++it)
+            if (!seen.contains(it.key()))
+                diff->removed.append(it.key());
+    m_students = seen;
+    return true;
+}
+
+// Only the students changed since the last scan, when the store still
+// knows which; false leaves the diff to the full read
+bool ChangeFeed::diffChanges(Repository &repo, Diff *diff)
+{
+    quint64 generation = 0;
+    QVector<Student> changed;
+    QStringList removed;
+    if (!repo.changesSince(m_generation, &generation, &changed, &removed))
+        return false;
+
+    for (const Student &s : std::as_const(changed)) {
+        const size_t print = fingerprint(s);
+        auto it = m_students.find(s.id);
+        if (it != m_students.end() && it.value() == print)
+            continue;
+        m_students.insert(s.id, print);
+        diff->changed.append(s);
+    }
+    for (const QString &id : std::as_const(removed))
+        if (m_students.remove(id))
+            diff->removed.append(id);
+    if (diff->changed.size() > kMaxListed) {
+        diff->reset = true;
+        diff->changed.clear();
+    }
+    m_generation = generation;
+    return true;
+}
+
+// Courses whose questions changed, were added or were dropped
+void ChangeFeed::diffTestBank(bool baseline, Diff *diff)
+{
+    const QFileInfo info(m_testBankPath);
+    const qint64 size = info.exists() ? info.size() : -1;
+    const qint64 modified = info.exists() ? info.lastModified().toMSecsSinceEpoch() : 0;
+    if (size == m_testBankSize && modified == m_testBankModified)
+        return;
+
+    // A copy, not a mapping: the file is being written, and a mapping of a
+    // file truncated under it faults instead of failing the load
+    XMLDocument doc;
+    doc.Reserve(qMax<qint64>(size, 0));
+    if (doc.LoadFile(m_testBankPath.toUtf8().constData()) != XML_SUCCESS)
+        return;                 // mid-write or broken; the next change retries
+    m_testBankSize = size;
+    m_testBankModified = modified;
+
+    QHash<QString, size_t> courses;
+    const XMLElement *root = doc.FirstChildElement("TestBank");
+    for (const XMLElement *c = root ? root->FirstChildElement("Course") : nullptr; c;
+         c = c->NextSiblingElement("Course")) {
+        XMLPrinter printer(nullptr, true);
+        c->Accept(&printer);
+        courses.insert(QString::fromUtf8(c->Attribute("name")),
+                       qHash(QByteArray(printer.CStr(), printer.CStrSize() - 1)));
+    }
+
+    if (!baseline) {
+        for (auto it = courses.constBegin(); it != courses.constEnd(); ++it)
+            if (!m_testBank.contains(it.key()) || m_testBank.value(it.key()) != it.value())
+                diff->testBank.append(it.key());
+        for (auto it = m_testBank.constBegin(); it != m_testBank.constEnd(); ++it)
+            if (!courses.contains(it.key()))
+                diff->testBank.append(it.key());
+    }
+    m_testBank = courses;
+}
@@ -0,0 +1,81 @@
+// changefeed.h
+#ifndef CHANGEFEED_H
+#define CHANGEFEED_H
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+#include "records.h"
+
+class Repository;
+
+// Tells open views which records changed on disk, so they redraw those
+// instead of reloading everything. It watches the store's files
+// (Repository::watchedFiles()), testBank.xml and the data directory. Once
+// a burst of changes settles, it catches the Repository up on the I/O
+// thread and diffs the result against fingerprints from the last scan:
+//
+//   students    a 64-bit hash per student id, over every field
+//   catalog     one hash over <Courses>
+//   test bank   a hash per <Course name=".."> of testBank.xml
+//
+// The student diff does nothing while the store's generation stays put.
+// When it moves, it reads just the students the store says changed
+// (Repository::changesSince()), and the whole roster only when the store
+// cannot tell, e.g. after users.xml was edited or replaced. Commits made
+// by this instance show up too; views that already show them just redraw
+// the same rows. Signals arrive on the GUI thread.
+class ChangeFeed : public QObject
+{
+    Q_OBJECT
+
+public:
+    static ChangeFeed &instance();
+
+    // Start watching once the Repository is loaded; takes the baseline.
+    // Call it on the GUI thread.
+    void watch(const QString &dataDir);
+
+signals:
+    void studentsChanged(const QVector<Student> &students);   // added or modified
+    void studentsRemoved(const QStringList &studentIds);
+    void rosterReset();             // too many changes to list; reload it all
+    void catalogChanged();
+    void testBankChanged(const QStringList &courseNames);
+
+private:
+    struct Diff;
+
+    ChangeFeed();
+
+    void changed();
+    void rewatch();
+    void scan();
+    void publish(const Diff &diff);
+
+    // Run by scan jobs on the I/O thread
+    bool diffStudents(Repository &repo, bool baseline, Diff *diff, QString *error);
+    bool diffChanges(Repository &repo, Diff *diff);
+    void diffTestBank(bool baseline, Diff *diff);
+
+    QFileSystemWatcher m_watcher;
+    QTimer  m_settle;           // a commit touches several files; wait for the last
+    QStringList m_paths;        // fixed once the Repository is open
+    QString m_testBankPath;
+    bool    m_primed   = false; // the baseline is in
+    bool    m_scanning = false;
+    bool    m_rescan   = false; // changes arrived during a scan
+
+    // Fingerprints of the last scan, only used by scan jobs
+    QHash<QString, size_t> m_students;
+    quint64 m_generation = 0;
+    size_t  m_catalog = 0;
+    QHash<QString, size_t> m_testBank;
+    qint64  m_testBankSize = -1;
+    qint64  m_testBankModified = 0;
+};
+
+#endif // CHANGEFEED_H
@@ -0,0 +1,43 @@
+#include "coursecatalog.h"
+
+void CourseCatalog::rebuild(const QVector<Course> &courses)
+{
+    m_courses = courses;
+    m_courseIndex.clear();
+    m_testIndex.clear();
+    m_courseIndex.reserve(courses.size());
+
+    for (int c = 0; c < m_courses.size(); ++c) {
+        const Course &course = m_courses[c];
+        m_courseIndex.insert(course.id, c);
+        for (int t = 0; t < course.tests.size(); ++t)
+            m_testIndex.insert(qMakePair(course.id, course.tests[t].id), qMakePair(c, t));
+    }
+    m_generation++;
+}
+
+const Course *CourseCatalog::course(const QString &courseId) const
+{
+    auto it = m_courseIndex.constFind(courseId);
+    return it == m_courseIndex.constEnd() ? nullptr : &m_courses[it.value()];
+}
+
+const CourseTest *CourseCatalog::test(const QString &courseId, const QString &testId) const
+{
+    auto it = m_testIndex.constFind(qMakePair(courseId, testId));
+    if (it == m_testIndex.constEnd())
+        return nullptr;
+    return &m_courses[it.value().first].tests[it.value().second];
+}
+
+QString CourseCatalog::courseName(const QString &courseId) const
+{
+    const Course *c = course(courseId);
+    return c ? c->name : QString();
+}
+
+QString CourseCatalog::testType(const QString &courseId, const QString &testId) const
+{
+    const CourseTest *t = test(courseId, testId);
+    return t ? t->type : QString();
+}
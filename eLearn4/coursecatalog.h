@@ -0,0 +1,37 @@
+// coursecatalog.h
+#ifndef COURSECATALOG_H
+#define COURSECATALOG_H
+
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include "records.h"
+
+// Compiled view of <Courses>: courseId -> course and (courseId, testId) ->
+// test, built once by rebuild(). The dashboard, the test picker and every
+// admin grid row resolve names and test types here instead of walking the
+// catalog. Rebuild only when the catalog itself changes; generation() lets
+// holders of derived data notice that it did.
+class CourseCatalog
+{
+public:
+    void rebuild(const QVector<Course> &courses);
+    quint64 generation() const { return m_generation; }
+
+    const QVector<Course> &courses() const { return m_courses; }
+    const Course *course(const QString &courseId) const;
+    const CourseTest *test(const QString &courseId, const QString &testId) const;
+
+    // Convenience lookups; empty string when unknown
+    QString courseName(const QString &courseId) const;
+    QString testType(const QString &courseId, const QString &testId) const;
+
+private:
+    QVector<Course> m_courses;
+    QHash<QString, int> m_courseIndex;                          // courseId -> m_courses index
+    QHash<QPair<QString, QString>, QPair<int, int>> m_testIndex; // (courseId, testId) -> (course, test)
+    quint64 m_generation = 0;
+};
+
+#endif // COURSECATALOG_H
@@ -1,14 +1,14 @@
 #include "dashboard.h"
 #include "ui_dashboard.h"
+#include "changefeed.h"
 #include "globals.h"
-#include "tinyxml2.h"
+#include "repository.h"
+#include "storageservice.h"
 #include "QMessageBox"
 #include "QInputDialog"
 #include "testpaper.h"
 #include <QDate>
-
-using namespace tinyxml2;
-QString fullPath = g_xmlPath + "users.xml";
+#include <memory>
 
 Dashboard::Dashboard(QWidget *parent)
     : QDialog(parent)
@@ -22,39 +22,48 @@ Dashboard::Dashboard(QWidget *parent)
             this, SLOT(enrollCourseBtn()));
     connect(ui->pushButton_3, SIGNAL(clicked()),
             this, SLOT(takeTestBtn()));
+
+    // Redraw when this student's record or the catalog changes elsewhere
+    ChangeFeed &feed = ChangeFeed::instance();
+    connect(&feed, &ChangeFeed::studentsChanged, this, [this](const QVector<Student> &students) {
+        for (const Student &s : students)
+            if (s.id == m_studentId)
+                showStudent(s);
+    });
+    connect(&feed, &ChangeFeed::catalogChanged, this, [this]() {
+        populateDashboard(g_user);
+    });
 }
 
-void Dashboard::populateDashboard(const QString& username)
+void Dashboard::withStudent(const QString &username, const std::function<void(const Student &)> &use)
 {
-    XMLDocument doc;
-    if (doc.LoadFile(fullPath.toUtf8().constData()) != XML_SUCCESS)
-        return;
-
-    XMLElement* root = doc.FirstChildElement("ELearningPlatform");
-    if (!root) return;
-
-    XMLElement* students = root->FirstChildElement("Students");
-    XMLElement* allCourses = root->FirstChildElement("Courses");
-
-    // -----------------------------------------------------
-    //  FIND LOGGED-IN STUDENT
-    // -----------------------------------------------------
-    XMLElement* student = students->FirstChildElement("Student");
-    XMLElement* matched = nullptr;
+    auto student = std::make_shared<Student>();
+    auto catalog = std::make_shared<CourseCatalog>();
+    StorageService::instance().run([username, student, catalog](Repository &repo, QString *) {
+        repo.refresh();     // other instances may have written since
+        repo.findStudentByUsername(username, student.get());
+        *catalog = repo.catalog();
+        return true;
+    }).then(this, [this, student, catalog, use](const StorageResult &) {
+        m_catalog = *catalog;
+        use(*student);
+    });
+}
 
-    while (student)
-    {
-        XMLElement* u = student->FirstChildElement("Username");
-        if (u && u->GetText() &&
-            QString(u->GetText()) == username)
-        {
-            matched = student;
-            break;
-        }
-        student = student->NextSiblingElement("Student");
-    }
+// The record is read on the I/O thread; the labels fill in when it arrives
+void Dashboard::populateDashboard(const QString& username)
+{
+    withStudent(username, [this](const Student &student) {
+        showStudent(student);
+    });
+}
 
-    if (!matched) return;
+void Dashboard::showStudent(const Student &student)
+{
+    if (student.id.isEmpty())
+        return;
+    m_studentId = student.id;
+    const CourseCatalog &catalog = m_catalog;
 
     // -----------------------------------------------------
     //  ACCUMULATE DASHBOARD DATA
@@ -66,132 +75,52 @@ void Dashboard::populateDashboard(const QString& username)
     QVector<QString> certCourseList;
     QVector<QString> certDateList;
 
-    XMLElement* regCourses = matched->FirstChildElement("RegisteredCourses");
-    XMLElement* reg = regCourses ?
-                          regCourses->FirstChildElement("CourseRegistration")
-                                 : nullptr;
-
-    while (reg)
+    for (const CourseRegistration &reg : student.courses)
     {
-        QString cid = reg->Attribute("courseId");
-
         // -------------------------------
         //  COURSE NAME
         // -------------------------------
-        QString courseName = "Unknown";
-        XMLElement* cr = allCourses->FirstChildElement("Course");
-        while (cr)
-        {
-            if (QString(cr->Attribute("id")) == cid)
-            {
-                courseName = cr->FirstChildElement("Name")->GetText();
-                break;
-            }
-            cr = cr->NextSiblingElement("Course");
-        }
+        QString courseName = catalog.courseName(reg.courseId);
+        if (courseName.isEmpty()) courseName = "Unknown";
         courseNames.append(courseName);
 
-        // -------------------------------
-        //  BUILD testId → type MAP
-        // -------------------------------
-        QMap<QString, QString> testTypeMap;
-
-        XMLElement* cr2 = allCourses->FirstChildElement("Course");
-        while (cr2)
-        {
-            if (QString(cr2->Attribute("id")) == cid)
-            {
-                XMLElement* tests = cr2->FirstChildElement("Tests");
-                XMLElement* t = tests->FirstChildElement("Test");
-
-                while (t)
-                {
-                    testTypeMap[t->Attribute("id")] =
-                        t->Attribute("type");
-                    t = t->NextSiblingElement("Test");
-                }
-                break;
-            }
-            cr2 = cr2->NextSiblingElement("Course");
-        }
-
         // -------------------------------
         //  COUNT ATTEMPTS + GET LATEST
         // -------------------------------
         QMap<QString, int> attemptsCount;
         QMap<QString, QString> latestGrade;
-        QMap<QString, QString> latestScore;
 
-        XMLElement* testRegs = reg->FirstChildElement("TestRegistrations");
-        if (testRegs)
+        for (const TestRegistration &t : reg.tests)
         {
-            XMLElement* t = testRegs->FirstChildElement("TestRegistration");
-
-            while (t)
-            {
-                QString tid = t->Attribute("testId");
-
-                attemptsCount[tid] = attemptsCount.value(tid, 0) + 1;
-
-                XMLElement* gEl = t->FirstChildElement("Grade");
-                XMLElement* sEl = t->FirstChildElement("Score");
-
-                if (gEl && gEl->GetText())
-                    latestGrade[tid] = gEl->GetText();
-
-                if (sEl && sEl->GetText())
-                    latestScore[tid] = sEl->GetText();
-
-                t = t->NextSiblingElement("TestRegistration");
-            }
+            attemptsCount[t.testId] = attemptsCount.value(t.testId, 0) + 1;
+            if (!t.grade.isEmpty())
+                latestGrade[t.testId] = t.grade;
+        }
 
-            // Build dashboard labels
-            QMapIterator<QString, int> it(attemptsCount);
-            while (it.hasNext())
-            {
-                it.next();
-                QString tid = it.key();
-                int attempts = it.value();
+        // Build dashboard labels
+        QMapIterator<QString, int> it(attemptsCount);
+        while (it.hasNext())
+        {
+            it.next();
+            QString tid = it.key();
+            int attempts = it.value();
 
-                QString ttype = testTypeMap.value(tid);
-                QString labelFull =
-                    ttype + " (" + courseName + ") (" +
-                    QString::number(attempts) + ")";
+            QString ttype = catalog.testType(reg.courseId, tid);
+            QString labelFull =
+                ttype + " (" + courseName + ") (" +
+                QString::number(attempts) + ")";
 
-                testsCompleted.append(labelFull);
+            testsCompleted.append(labelFull);
 
-                scoreTests.append(ttype + " (" + courseName + ")");
-                scoreGrades.append(latestGrade.value(tid, ""));
-            }
+            scoreTests.append(ttype + " (" + courseName + ")");
+            scoreGrades.append(latestGrade.value(tid, ""));
         }
 
         // -------------------------------
         //  CERTIFICATES
         // -------------------------------
         certCourseList.append(courseName);
-
-        XMLElement* cert = reg->FirstChildElement("Certificate");
-        if (!cert)
-        {
-            certDateList.append("Pending");
-        }
-        else
-        {
-            QString status = cert->FirstChildElement("Status")->GetText();
-
-            if (status == "Issued")
-            {
-                certDateList.append(
-                    cert->FirstChildElement("IssueDate")->GetText()
-                    );
-            }
-            else
-            {
-                certDateList.append("Pending");
-            }
-        }
-
-        reg = reg->NextSiblingElement("CourseRegistration");
+        certDateList.append(reg.certificateIssued() ? reg.certificateIssueDate : "Pending");
     }
 
     // -----------------------------------------------------
@@ -247,63 +176,35 @@ void Dashboard::on_pushButton_clicked()
         parentWidget()->show();
 }
 
+// The student is read first, on the I/O thread; the course picker opens
+// when it arrives
 void Dashboard::enrollCourseBtn()
 {
-    //QString filePath = "C:/My_Projects/Qt_eLrn_Adv/eLearn4/users.xml";
-
-    XMLDocument doc;
-    if (doc.LoadFile(fullPath.toUtf8().constData()) != XML_SUCCESS) {
-        QMessageBox::critical(this, "Error", "Cannot open XML file");
-        return;
-    }
-
-    XMLElement* root = doc.FirstChildElement("ELearningPlatform");
-    XMLElement* adminCourses = root->FirstChildElement("Courses");
-    XMLElement* students = root->FirstChildElement("Students");
-
-    // FIND STUDENT
-    XMLElement* student = students->FirstChildElement("Student");
-    XMLElement* st = nullptr;
-
-    while (student) {
-        if (QString(student->FirstChildElement("Username")->GetText()) == g_user) {
-            st = student;
-            break;
-        }
-        student = student->NextSiblingElement("Student");
-    }
-    if (!st) return;
+    ui->pushButton_2->setEnabled(false);
+    withStudent(g_user, [this](const Student &st) {
+        ui->pushButton_2->setEnabled(true);
+        pickCourse(st);
+    });
+}
 
-    // Ensure <RegisteredCourses>
-    XMLElement* regCourses = st->FirstChildElement("RegisteredCourses");
-    if (!regCourses) {
-        regCourses = doc.NewElement("RegisteredCourses");
-        st->InsertEndChild(regCourses);
-    }
+void Dashboard::pickCourse(const Student &st)
+{
+    if (st.id.isEmpty()) return;
 
     // Already-enrolled courses
     QSet<QString> enrolled;
-    XMLElement* rc = regCourses->FirstChildElement("CourseRegistration");
-
-    while (rc) {
-        enrolled.insert(QString(rc->Attribute("courseId")));
-        rc = rc->NextSiblingElement("CourseRegistration");
-    }
+    for (const CourseRegistration &rc : st.courses)
+        enrolled.insert(rc.courseId);
 
     // Prepare available courses
     QStringList options;
     QMap<QString, QString> nameToId;
 
-    XMLElement* c = adminCourses->FirstChildElement("Course");
-    while (c) {
-        QString id = c->Attribute("id");
-        QString nm = c->FirstChildElement("Name")->GetText();
-
-        if (!enrolled.contains(id)) {
-            options.append(nm);
-            nameToId[nm] = id;
+    for (const Course &c : m_catalog.courses()) {
+        if (!enrolled.contains(c.id)) {
+            options.append(c.name);
+            nameToId[c.name] = c.id;
         }
-        c = c->NextSiblingElement("Course");
     }
 
     if (options.isEmpty()) {
@@ -319,121 +220,110 @@ void Dashboard::enrollCourseBtn()
 
     QString pickedId = nameToId[picked];
 
-    // Create new <CourseRegistration>
-    XMLElement* newReg = doc.NewElement("CourseRegistration");
-    newReg->SetAttribute("courseId", pickedId.toUtf8().constData());
-
-    XMLElement* regDate = doc.NewElement("RegistrationDate");
-    regDate->SetText(QDate::currentDate().toString("yyyy-MM-dd").toUtf8().constData());
-    newReg->InsertEndChild(regDate);
+    // New <CourseRegistration> with a pending certificate, saved on the
+    // I/O thread
+    const QString studentId = st.id;
+    const QString date = QDate::currentDate().toString("yyyy-MM-dd");
+    ui->pushButton_2->setEnabled(false);
+    StorageService::instance().run([studentId, pickedId, date](Repository &repo, QString *error) {
+        return repo.enroll(studentId, pickedId, date, error);
+    }).then(this, [this, picked](const StorageResult &r) {
+        ui->pushButton_2->setEnabled(true);
+        if (!r.ok) {
+            QMessageBox::critical(this, "Error", "Could not save enrollment\n" + r.error);
+            return;
+        }
+        QMessageBox::information(this, "Success", "Enrolled in: " + picked);
+        populateDashboard(g_user);
+    });
+}
 
-    XMLElement* tests = doc.NewElement("TestRegistrations");
-    newReg->InsertEndChild(tests);
+// ==========================================================
+//  AUTO-CERTIFICATE: ANY PASSING ATTEMPT RULE
+//  Runs on the I/O thread right after the attempt is saved
+// ==========================================================
+static void issueCertificateIfEarned(Repository &repo, const QString &studentId,
+                                     const QString &cid)
+{
+    Student st;
+    if (!repo.findStudent(studentId, &st)) return;
+    const CourseRegistration *cr = st.registration(cid);
+    if (!cr) return;
 
-    XMLElement* cert = doc.NewElement("Certificate");
-    XMLElement* s = doc.NewElement("Status");
-    s->SetText("Pending");
-    cert->InsertEndChild(s);
-    newReg->InsertEndChild(cert);
+    bool allPassed = true;
+    const CourseCatalog catalog = repo.catalog();
+    if (const Course *course = catalog.course(cid))
+    {
+        for (const CourseTest &t : course->tests)
+        {
+            bool passFound = false;
+            for (const TestRegistration &at : cr->tests)
+            {
+                if (at.testId == t.id &&
+                    (at.grade == "A" || at.grade == "B" || at.grade == "C"))
+                {
+                    passFound = true;
+                    break;
+                }
+            }
 
-    regCourses->InsertEndChild(newReg);
-    doc.SaveFile((g_xmlPath + "users.xml").toUtf8().constData());
+            if (!passFound)
+            {
+                allPassed = false;
+                break;
+            }
+        }
+    }
 
-    QMessageBox::information(this, "Success", "Enrolled in: " + picked);
-    populateDashboard(g_user);
+    if (allPassed && !cr->certificateIssued())
+    {
+        repo.issueCertificate(studentId, cid,
+                              QDate::currentDate().toString("yyyy-MM-dd"));
+    }
 }
 
+// Like enrolling: the student is read on the I/O thread before the picker
 void Dashboard::takeTestBtn()
 {
-   // QString filePath = "C:/My_Projects/Qt_eLrn_Adv/eLearn4/users.xml";
-
-    XMLDocument doc;
-    if (doc.LoadFile(fullPath.toUtf8().constData()) != XML_SUCCESS) {
-        QMessageBox::critical(this, "Error", "Cannot open XML file");
-        return;
-    }
-
-    XMLElement* root = doc.FirstChildElement("ELearningPlatform");
-    XMLElement* adminCourses = root->FirstChildElement("Courses");
-    XMLElement* students = root->FirstChildElement("Students");
-
-    // FIND STUDENT
-    XMLElement* st = students->FirstChildElement("Student");
-    while (st) {
-        XMLElement* u = st->FirstChildElement("Username");
-        if (u && u->GetText() && QString(u->GetText()) == g_user)
-            break;
-        st = st->NextSiblingElement("Student");
-    }
-    if (!st) return;
+    ui->pushButton_3->setEnabled(false);
+    withStudent(g_user, [this](const Student &st) {
+        ui->pushButton_3->setEnabled(true);
+        pickTest(st);
+    });
+}
 
-    XMLElement* regCourses = st->FirstChildElement("RegisteredCourses");
-    if (!regCourses) return;
+void Dashboard::pickTest(const Student &st)
+{
+    if (st.id.isEmpty()) return;
 
     // Build list of pending tests
     QStringList listTests;
     struct Info { QString cid, tid, label, cname; };
     QVector<Info> testsVector;
 
-    XMLElement* rc = regCourses->FirstChildElement("CourseRegistration");
-    while (rc)
+    for (const CourseRegistration &rc : st.courses)
     {
-        QString cid = rc->Attribute("courseId");
+        const Course *ac = m_catalog.course(rc.courseId);
+        if (!ac) continue;
 
-        XMLElement* ac = adminCourses->FirstChildElement("Course");
-        while (ac)
+        for (const CourseTest &t : ac->tests)
         {
-            if (QString(ac->Attribute("id")) == cid)
-            {
-                QString cname = ac->FirstChildElement("Name")->GetText();
-                XMLElement* testsNode = ac->FirstChildElement("Tests");
-                XMLElement* t = testsNode->FirstChildElement("Test");
+            int attempts = rc.attemptCount(t.id);
+            QString latestGrade = rc.latestGrade(t.id);
 
-                while (t)
-                {
-                    QString tid = t->Attribute("id");
-                    QString ttype = t->Attribute("type");
-
-                    int attempts = 0;
-                    QString latestGrade = "";
-
-                    XMLElement* trNode = rc->FirstChildElement("TestRegistrations");
-                    XMLElement* trCheck = trNode ?
-                                              trNode->FirstChildElement("TestRegistration") : nullptr;
-
-                    while (trCheck)
-                    {
-                        if (QString(trCheck->Attribute("testId")) == tid)
-                        {
-                            attempts++;
-                            XMLElement* gEl = trCheck->FirstChildElement("Grade");
-                            if (gEl && gEl->GetText())
-                                latestGrade = gEl->GetText();
-                        }
-                        trCheck = trCheck->NextSiblingElement("TestRegistration");
-                    }
-
-                    if (attempts == 0)
-                    {
-                        QString lbl = ttype + " (" + cname + ")";
-                        listTests.append(lbl);
-                        testsVector.append({cid, tid, lbl, cname});
-                    }
-                    else if (attempts == 1 && latestGrade == "F")
-                    {
-                        QString lbl = ttype + " (" + cname + ") - Second Attempt";
-                        listTests.append(lbl);
-                        testsVector.append({cid, tid, lbl, cname});
-                    }
-
-                    t = t->NextSiblingElement("Test");
-                }
-                break;
+            if (attempts == 0)
+            {
+                QString lbl = t.type + " (" + ac->name + ")";
+                listTests.append(lbl);
+                testsVector.append({rc.courseId, t.id, lbl, ac->name});
+            }
+            else if (attempts == 1 && latestGrade == "F")
+            {
+                QString lbl = t.type + " (" + ac->name + ") - Second Attempt";
+                listTests.append(lbl);
+                testsVector.append({rc.courseId, t.id, lbl, ac->name});
             }
-
-            ac = ac->NextSiblingElement("Course");
         }
-        rc = rc->NextSiblingElement("CourseRegistration");
     }
 
     if (listTests.isEmpty()) {
@@ -466,170 +356,30 @@ void Dashboard::takeTestBtn()
     if (paper.exec() != QDialog::Accepted)
         return;
 
-    // Save test attempt
-    XMLElement* st2 = students->FirstChildElement("Student");
-    while (st2)
-    {
-        XMLElement* u = st2->FirstChildElement("Username");
-        if (u && u->GetText() && QString(u->GetText()) == g_user)
-            break;
-        st2 = st2->NextSiblingElement("Student");
-    }
-    if (!st2) return;
-
-    XMLElement* rc2 = st2->FirstChildElement("RegisteredCourses");
-    XMLElement* cr = rc2->FirstChildElement("CourseRegistration");
-    while (cr) {
-        if (QString(cr->Attribute("courseId")) == cid)
-            break;
-        cr = cr->NextSiblingElement("CourseRegistration");
-    }
-    if (!cr) return;
-
-    XMLElement* tr = cr->FirstChildElement("TestRegistrations");
-    if (!tr)
-    {
-        tr = doc.NewElement("TestRegistrations");
-        cr->InsertEndChild(tr);
-    }
-
-    // Count attempts
-    int attempts = 0;
-    XMLElement* scan = tr->FirstChildElement("TestRegistration");
-    while (scan)
-    {
-        if (QString(scan->Attribute("testId")) == tid)
-            attempts++;
-        scan = scan->NextSiblingElement("TestRegistration");
-    }
-
-    if (attempts >= 2)
-    {
-        QMessageBox::warning(this, "Blocked", "Maximum 2 attempts allowed.");
-        return;
-    }
-
-    if (attempts == 1)
-    {
-        // check first attempt's grade for F
-        XMLElement* last = tr->FirstChildElement("TestRegistration");
-        QString gradeFirst = "";
-
-        while (last)
-        {
-            if (QString(last->Attribute("testId")) == tid)
-            {
-                XMLElement* gg = last->FirstChildElement("Grade");
-                if (gg) gradeFirst = gg->GetText();
-            }
-            last = last->NextSiblingElement("TestRegistration");
-        }
-
-        if (gradeFirst != "F")
-        {
-            QMessageBox::information(
-                this,
-                "Not allowed",
-                "Second attempt allowed only when first attempt is F.");
+    // Insert new attempt. The record may have changed while the test was
+    // open: recordAttempt() checks the attempt rules (at most two, the
+    // second only after an F) against it as it is then, on the I/O thread.
+    TestRegistration newT;
+    newT.testId = tid;
+    newT.score  = g_score;
+    newT.result = (g_grade == "F" ? "Fail" : "Pass");
+    newT.grade  = g_grade;
+
+    // Save on the I/O thread; the dialog stays live until it is written
+    const QString studentId = st.id;
+    ui->pushButton_3->setEnabled(false);
+    StorageService::instance().run([studentId, cid, newT](Repository &repo, QString *error) {
+        if (!repo.recordAttempt(studentId, cid, newT, error))
+            return false;
+        issueCertificateIfEarned(repo, studentId, cid);
+        return true;
+    }).then(this, [this](const StorageResult &r) {
+        ui->pushButton_3->setEnabled(true);
+        if (!r.ok) {
+            QMessageBox::critical(this, "Error", "Could not save test attempt\n" + r.error);
             return;
         }
-    }
-
-    // Insert new attempt
-    XMLElement* newT = doc.NewElement("TestRegistration");
-    newT->SetAttribute("testId", tid.toUtf8().constData());
-    newT->SetAttribute("attempt", QString::number(attempts + 1).toUtf8().constData());
-
-    XMLElement* scEl = doc.NewElement("Score");
-    scEl->SetText(QString::number(g_score).toUtf8().constData());
-
-    XMLElement* resEl = doc.NewElement("Result");
-    resEl->SetText((g_grade == "F" ? "Fail" : "Pass"));
-
-    XMLElement* grEl = doc.NewElement("Grade");
-    grEl->SetText(g_grade.toUtf8().constData());
-
-    newT->InsertEndChild(scEl);
-    newT->InsertEndChild(resEl);
-    newT->InsertEndChild(grEl);
-
-    tr->InsertEndChild(newT);
-
-    // ==========================================================
-    //  AUTO-CERTIFICATE: ANY PASSING ATTEMPT RULE
-    // ==========================================================
-    bool allPassed = true;
-
-    XMLElement* courseNode = adminCourses->FirstChildElement("Course");
-    while (courseNode)
-    {
-        if (QString(courseNode->Attribute("id")) == cid)
-        {
-            XMLElement* tset = courseNode->FirstChildElement("Tests");
-            XMLElement* t = tset->FirstChildElement("Test");
-
-            while (t)
-            {
-                QString tidIter = t->Attribute("id");
-                bool passFound = false;
-
-                XMLElement* at = tr->FirstChildElement("TestRegistration");
-                while (at)
-                {
-                    if (QString(at->Attribute("testId")) == tidIter)
-                    {
-                        QString g = at->FirstChildElement("Grade")->GetText();
-                        if (g == "A" || g == "B" || g == "C")
-                        {
-                            passFound = true;
-                            break;
-                        }
-                    }
-                    at = at->NextSiblingElement("TestRegistration");
-                }
-
-                if (!passFound)
-                {
-                    allPassed = false;
-                    break;
-                }
-
-                t = t->NextSiblingElement("Test");
-            }
-
-            break;
-        }
-
-        courseNode = courseNode->NextSiblingElement("Course");
-    }
-
-    XMLElement* cert = cr->FirstChildElement("Certificate");
-    if (!cert)
-    {
-        cert = doc.NewElement("Certificate");
-        XMLElement* sEl = doc.NewElement("Status");
-        sEl->SetText("Pending");
-        cert->InsertEndChild(sEl);
-        cr->InsertEndChild(cert);
-    }
-
-    XMLElement* stat = cert->FirstChildElement("Status");
-    if (allPassed && QString(stat->GetText()) != "Issued")
-    {
-        stat->SetText("Issued");
-
-        XMLElement* idEl = cert->FirstChildElement("IssueDate");
-        if (!idEl)
-        {
-            idEl = doc.NewElement("IssueDate");
-            cert->InsertEndChild(idEl);
-        }
-
-        idEl->SetText(QDate::currentDate().toString("yyyy-MM-dd").toUtf8().constData());
-    }
-
-    doc.SaveFile((g_xmlPath + "users.xml").toUtf8().constData());
-
-    QMessageBox::information(this, "Saved", "Test attempt saved.");
-    populateDashboard(g_user);
+        QMessageBox::information(this, "Saved", "Test attempt saved.");
+        populateDashboard(g_user);
+    });
 }
@@ -2,6 +2,9 @@
 #define DASHBOARD_H
 
 #include <QDialog>
+#include <functional>
+#include "coursecatalog.h"
+#include "records.h"
 
 namespace Ui {
 class Dashboard;
@@ -25,7 +28,17 @@ private slots:
     void takeTestBtn();
 
 private:
+    // Read the student and the catalog on the I/O thread, then hand the
+    // student (an empty id when there is none) to `use` on this thread
+    void withStudent(const QString &username, const std::function<void(const Student &)> &use);
+
+    void showStudent(const Student &student);
+    void pickCourse(const Student &st);
+    void pickTest(const Student &st);
+
     Ui::Dashboard *ui;
+    QString m_studentId;        // of the record on show
+    CourseCatalog m_catalog;    // as of the last withStudent()
 };
 
 #endif // DASHBOARD_H
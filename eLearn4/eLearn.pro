@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui concurrent sql
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -10,19 +10,60 @@ CONFIG += c++17
 
 SOURCES += \
     admindb.cpp \
+    atomicfile.cpp \
+    bulkimport.cpp \
+    changefeed.cpp \
+    coursecatalog.cpp \
     dashboard.cpp \
+    idallocator.cpp \
+    journal.cpp \
     main.cpp \
     mainwindow.cpp \
+    mutation.cpp \
+    reportexport.cpp \
+    repository.cpp \
+    shardedstore.cpp \
+    snapshot.cpp \
+    sqlstore.cpp \
+    storageservice.cpp \
+    studentindex.cpp \
     testpaper.cpp \
-    tinyxml2.cpp
+    tinyxml2.cpp \
+    usersxml.cpp \
+    usersxmlreader.cpp \
+    usersxmlwriter.cpp \
+    writescheduler.cpp \
+    xmlstore.cpp
 
 HEADERS += \
     admindb.h \
+    atomicfile.h \
+    bulkimport.h \
+    changefeed.h \
+    coursecatalog.h \
     dashboard.h \
     globals.h \
+    idallocator.h \
+    journal.h \
     mainwindow.h \
+    mutation.h \
+    records.h \
+    reportexport.h \
+    repository.h \
+    shardedstore.h \
+    snapshot.h \
+    sqlstore.h \
+    storageservice.h \
+    studentindex.h \
+    studentsource.h \
+    studentstore.h \
     testpaper.h \
-    tinyxml2.h
+    tinyxml2.h \
+    usersxml.h \
+    usersxmlreader.h \
+    usersxmlwriter.h \
+    writescheduler.h \
+    xmlstore.h
 
 FORMS += \
     admindb.ui \
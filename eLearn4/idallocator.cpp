@@ -0,0 +1,36 @@
+#include "idallocator.h"
+
+void IdAllocator::observe(const QString &studentId)
+{
+    quint64 n = 0;
+    if (parse(studentId, &n) && n >= m_next)
+        m_next = n + 1;
+}
+
+QString IdAllocator::allocate()
+{
+    return format(reserve(1));
+}
+
+quint64 IdAllocator::reserve(quint64 count)
+{
+    quint64 first = m_next;
+    m_next += count;
+    return first;
+}
+
+QString IdAllocator::format(quint64 number)
+{
+    // at least three digits so existing S001..S999 ids keep their shape
+    return "S" + QString::number(number).rightJustified(3, '0');
+}
+
+bool IdAllocator::parse(const QString &studentId, quint64 *number)
+{
+    if (!studentId.startsWith('S'))
+        return false;
+    bool ok = false;
+    quint64 n = studentId.mid(1).toULongLong(&ok);
+    if (ok && number) *number = n;
+    return ok;
+}
@@ -0,0 +1,34 @@
+// idallocator.h
+#ifndef IDALLOCATOR_H
+#define IDALLOCATOR_H
+
+#include <QString>
+#include <QtGlobal>
+
+// Hands out student ids ("S001", "S002", ... "S1000", ...) from a 64-bit
+// counter. The counter is persisted with the data (users.xml keeps it as
+// <Students nextId="..">) so allocation never has to rescan the roster,
+// and ids already in the file are observed on load so they are never reused.
+class IdAllocator
+{
+public:
+    void reset(quint64 next = 1) { m_next = next ? next : 1; }
+    quint64 next() const { return m_next; }
+
+    // Keep the counter ahead of an id that is already in use
+    void observe(const QString &studentId);
+
+    QString allocate();
+
+    // Reserve `count` consecutive numbers for a bulk import and return the
+    // first; format(first + i) gives the ids.
+    quint64 reserve(quint64 count);
+
+    static QString format(quint64 number);
+    static bool parse(const QString &studentId, quint64 *number);
+
+private:
+    quint64 m_next = 1;
+};
+
+#endif // IDALLOCATOR_H
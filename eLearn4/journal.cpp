@@ -0,0 +1,148 @@
+#include "journal.h"
+#include <QDebug>
+#include <QFile>
+#include "atomicfile.h"
+
+static const QByteArray kBaseTag = "#base\t";
+
+static bool fail(QString *error, const QString &text)
+{
+    if (error) *error = text;
+    return false;
+}
+
+// "#base\t<seq>" header of a compacted journal, 0 when there is none
+static quint64 readBase(QFile &f)
+{
+    f.seek(0);
+    const QByteArray first = f.readLine(64);
+    if (!first.startsWith(kBaseTag) || !first.endsWith('\n'))
+        return 0;
+    return first.mid(kBaseTag.size()).trimmed().toULongLong();
+}
+
+void Journal::setPath(const QString &path)
+{
+    m_path   = path;
+    m_offset = 0;
+    m_base   = 0;
+    m_size   = 0;
+}
+
+bool Journal::replay(quint64 afterSeq, QVector<Mutation> *out, QString *error)
+{
+    m_offset = 0;
+    m_base   = 0;
+    bool rebased = false;
+    if (!readNew(afterSeq, out, &rebased, true, error))
+        return false;
+    if (rebased) {
+        // users.xml is older than the compaction (restored from .bak);
+        // take what the journal still has
+        qWarning() << m_path << "was compacted past" << afterSeq << "- some changes are lost";
+        return readNew(afterSeq, out, &rebased, true, error);
+    }
+    return true;
+}
+
+bool Journal::readNew(quint64 afterSeq, QVector<Mutation> *out, bool *rebased,
+                      bool repair, QString *error)
+{
+    *rebased = false;
+
+    QFile f(m_path);
+    if (!f.exists()) {
+        m_offset = m_size = 0;
+        m_base = 0;
+        return true;
+    }
+    if (!f.open(repair ? QIODevice::ReadWrite : QIODevice::ReadOnly))
+        return fail(error, "Could not open " + m_path + ": " + f.errorString());
+
+    // a compaction (ours or another instance's) replaced the file
+    const quint64 base = readBase(f);
+    if (base != m_base || f.size() < m_offset) {
+        m_offset = 0;
+        m_base   = base;
+        if (base > afterSeq) {
+            *rebased = true;
+            return true;
+        }
+    }
+
+    f.seek(m_offset);
+    const QByteArray data = f.readAll();
+    qint64 end = data.lastIndexOf('\n') + 1;   // 0 when no complete line
+    if (repair && end < data.size())
+        f.resize(m_offset + end);               // drop the torn tail
+
+    // A record that does not decode is a committed change we cannot apply:
+    // fail rather than lose it, unless it is the last line, which a crash
+    // mid-append can leave garbled with its newline in place
+    qint64 pos = 0;
+    int bad = 0;
+    qint64 firstBad = -1;
+    while (pos < end) {
+        const qint64 nl = data.indexOf('\n', pos);
+        Mutation m;
+        if (data.at(pos) == '#') {
+            // header or comment
+        } else if (!Mutation::decode(data.mid(pos, nl - pos), &m)) {
+            if (nl + 1 == data.size() && !bad) {
+                qWarning() << m_path << "- dropping a torn last record at byte" << m_offset + pos;
+                if (repair)
+                    f.resize(m_offset + pos);
+                end = pos;
+                break;
+            }
+            if (!bad)
+                firstBad = m_offset + pos;
+            ++bad;
+        } else if (m.seq > afterSeq) {
+            out->append(m);
+        }
+        pos = nl + 1;
+    }
+    if (bad) {
+        qWarning() << m_path << "-" << bad << "unreadable records, the first at byte" << firstBad;
+        return fail(error, QString("%1 has %2 unreadable record(s), the first at byte %3")
+                               .arg(m_path).arg(bad).arg(firstBad));
+    }
+    m_offset += end;
+    m_size = m_offset;
+    return true;
+}
+
+// Callers hold the users.lock and have read up to the end, so the record
+// lands right after m_offset.
+bool Journal::append(const QVector<Mutation> &records, QString *error)
+{
+    QFile f(m_path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Append))
+        return fail(error, "Could not open " + m_path + ": " + f.errorString());
+
+    QByteArray lines;
+    for (const Mutation &m : records)
+        lines += m.encode() + '\n';
+    if (f.write(lines) != lines.size() || !syncFile(f))
+        return fail(error, "Could not write " + m_path + ": " + f.errorString());
+    m_offset = m_size = f.size();
+    return true;
+}
+
+bool Journal::truncateThrough(quint64 foldedSeq, QString *error)
+{
+    QVector<Mutation> keep;
+    if (!replay(foldedSeq, &keep, error))
+        return false;
+
+    QByteArray data = kBaseTag + QByteArray::number(foldedSeq) + '\n';
+    for (const Mutation &m : keep)
+        data += m.encode() + '\n';
+
+    if (!writeFileAtomic(m_path, data.constData(), data.size(), false, error))
+        return false;
+    m_offset = m_size = data.size();
+    m_base   = foldedSeq;
+    return true;
+}
@@ -0,0 +1,52 @@
+// journal.h
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <QString>
+#include <QVector>
+#include "mutation.h"
+
+// Append-only log of Mutations next to users.xml (users.journal). Each
+// change costs one short line instead of a rewrite of the whole file;
+// users.xml records the last sequence number folded into it, and on
+// startup every later record is replayed on top.
+//
+// Several app instances may share one journal. Each keeps its read offset,
+// so readNew() only parses what others appended since the last call. A
+// compaction rewrites the file starting with a "#base\t<seq>" line; a
+// changed base tells readers the records up to <seq> moved into users.xml.
+class Journal
+{
+public:
+    void setPath(const QString &path);
+    QString path() const { return m_path; }
+
+    // Read every complete record with seq > afterSeq from the start.
+    // A torn last line (crash mid-append) is dropped from the file.
+    bool replay(quint64 afterSeq, QVector<Mutation> *out, QString *error = nullptr);
+
+    // Records with seq > afterSeq appended since the last read. *rebased is
+    // set, and nothing read, when a compaction has folded records past
+    // afterSeq: reload users.xml and call again. `repair` truncates a torn
+    // tail and must only be used while holding the users.lock.
+    bool readNew(quint64 afterSeq, QVector<Mutation> *out, bool *rebased,
+                 bool repair, QString *error = nullptr);
+
+    // Durable on return: the records are written and synced to the device
+    // together, one sync however many there are
+    bool append(const QVector<Mutation> &records, QString *error = nullptr);
+
+    // Rewrite the journal without the records already folded into users.xml
+    bool truncateThrough(quint64 foldedSeq, QString *error = nullptr);
+
+    quint64 base() const { return m_base; }
+    qint64 size() const { return m_size; }
+
+private:
+    QString m_path;
+    qint64  m_offset = 0;   // bytes already parsed
+    quint64 m_base   = 0;   // seq the file was last compacted through
+    qint64  m_size   = 0;
+};
+
+#endif // JOURNAL_H
@@ -1,11 +1,152 @@
 #include "mainwindow.h"
+#include "bulkimport.h"
+#include "changefeed.h"
 #include "dashboard.h"
+#include "globals.h"
+#include "reportexport.h"
+#include "repository.h"
+#include "storageservice.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QMessageBox>
+#include <QSaveFile>
+#include <QStatusBar>
+#include <QTextStream>
+
+// Bulk import: progress to stderr, summary to stdout; exit code 2 when
+// some records were rejected
+static int runImport(const QString &batch, const QString &errorFile)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    BulkImport import;
+    if (!errorFile.isEmpty())
+        import.setErrorFile(errorFile);
+    import.setProgress([&err](const QString &stage, qint64 done, qint64 total) {
+        err << '\r' << stage << ' ' << done << '/' << total << (done == total ? "\n" : "")
+            << Qt::flush;
+    });
+
+    QString error;
+    ImportReport report;
+    if (!import.run(batch, &report, &error)) {
+        err << "Import failed: " << error << Qt::endl;
+        return 1;
+    }
+    out << report.imported << " of " << report.records << " records imported";
+    if (report.rejected)
+        out << ", " << report.rejected << " rejected (see " << report.errorFile << ")";
+    out << Qt::endl;
+    return report.rejected ? 2 : 0;
+}
+
+// Report export to a file (replaced only once it is complete) or stdout
+static int runExport(const QString &reportName, const QString &formatName,
+                     const QString &path, const QString &course)
+{
+    QTextStream err(stderr);
+    ReportExport::Report report;
+    ReportExport::Format format;
+    if (!ReportExport::parseReport(reportName, &report)) {
+        err << "Unknown report \"" << reportName << "\" (grades, attempts or certificates)" << Qt::endl;
+        return 1;
+    }
+    if (!ReportExport::parseFormat(formatName, &format)) {
+        err << "Unknown format \"" << formatName << "\" (csv or jsonl)" << Qt::endl;
+        return 1;
+    }
+
+    QSaveFile file(path);
+    QFile console;
+    QIODevice *out = &file;
+    if (path.isEmpty() || path == "-") {
+        console.open(stdout, QIODevice::WriteOnly);
+        out = &console;
+    } else if (!file.open(QIODevice::WriteOnly)) {
+        err << "Could not create " << path << ": " << file.errorString() << Qt::endl;
+        return 1;
+    }
+
+    ReportExport exporter;
+    exporter.setCourse(course);
+    exporter.setProgress([&err](int done, int total) {
+        err << "\rexport " << done << '/' << total << (done == total ? "\n" : "") << Qt::flush;
+    });
+
+    QString error;
+    qint64 rows = 0;
+    if (!exporter.run(report, format, out, &rows, &error)) {
+        err << "Export failed: " << error << Qt::endl;
+        return 1;
+    }
+    if (out == &file && !file.commit()) {
+        err << "Could not write " << path << ": " << file.errorString() << Qt::endl;
+        return 1;
+    }
+    err << rows << " rows exported" << Qt::endl;
+    return 0;
+}
+
+// eLearn --import <batch> | --export <report> ...: the batch jobs, run
+// without a window
+static int runHeadless(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Bulk import and report export for the eLearn data");
+    parser.addHelpOption();
+    const QCommandLineOption importOption("import", "CSV or XML batch to import.", "batch");
+    const QCommandLineOption errorsOption("errors", "Where rejected records are listed "
+                                          "(default: <batch>.errors.csv).", "file");
+    const QCommandLineOption exportOption("export", "Report to export: grades, attempts or "
+                                          "certificates.", "report");
+    const QCommandLineOption formatOption("format", "csv (default) or jsonl.", "format", "csv");
+    const QCommandLineOption outOption("out", "Report file (default: stdout).", "file");
+    const QCommandLineOption courseOption("course", "Only this course's rows.", "courseId");
+    const QCommandLineOption dataOption("data", "Data directory (default: the built-in one).", "dir");
+    parser.addOptions({ importOption, errorsOption, exportOption, formatOption, outOption,
+                        courseOption, dataOption });
+    parser.process(app);
+
+    QString dataDir = parser.isSet(dataOption) ? parser.value(dataOption) : g_xmlPath;
+    if (!dataDir.endsWith('/'))
+        dataDir += '/';
+    QString error;
+    if (!Repository::instance().load(dataDir, &error)) {
+        QTextStream(stderr) << "Could not open student data: " << error << Qt::endl;
+        return 1;
+    }
+
+    if (parser.isSet(exportOption))
+        return runExport(parser.value(exportOption), parser.value(formatOption),
+                         parser.value(outOption), parser.value(courseOption));
+    return runImport(parser.value(importOption), parser.value(errorsOption));
+}
 
 int main(int argc, char *argv[])
 {
+    for (int i = 1; i < argc; ++i)
+        if (qstrcmp(argv[i], "--import") == 0 || qstrcmp(argv[i], "--export") == 0)
+            return runHeadless(argc, argv);
+
     QApplication a(argc, argv);
+
     MainWindow w;
     w.show();
+
+    // users.xml is opened on the I/O thread while the window paints;
+    // logins wait until it is in
+    w.setEnabled(false);
+    w.statusBar()->showMessage("Loading student data...");
+    StorageService::instance().load(g_xmlPath).then(&w, [&w](const StorageResult &r) {
+        w.setEnabled(true);
+        w.statusBar()->clearMessage();
+        if (!r.ok) {
+            QMessageBox::critical(&w, "Error", "Could not open XML file!\n" + r.error);
+            return;
+        }
+        // open views follow edits made by other instances and scripts
+        ChangeFeed::instance().watch(g_xmlPath);
+    });
     return a.exec();
 }
@@ -1,12 +1,12 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include <QMessageBox>
-#include "tinyxml2.h"
 #include "dashboard.h"
 #include "globals.h"
 #include "admindb.h"
-
-using namespace tinyxml2;
+#include "repository.h"
+#include "storageservice.h"
+#include <memory>
 
 // single global definitions
 QString g_user  = "";
@@ -14,8 +14,6 @@ QString g_course = "";
 int     g_score  = 0;
 QString g_grade  = "";
 
-QString fullPath2 = g_xmlPath + "users.xml";
-
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
@@ -45,53 +43,31 @@ void MainWindow::loginBtn()
     }
     else
     {
-    XMLDocument doc;
-    if (doc.LoadFile(fullPath2.toUtf8().constData()) != XML_SUCCESS) {
+    Repository &repo = Repository::instance();
+    if (!repo.isLoaded()) {
         QMessageBox::critical(this, "Error", "Could not open XML file!");
         return;
     }
 
-    XMLElement* root     = doc.FirstChildElement("ELearningPlatform");
-    XMLElement* students = root ? root->FirstChildElement("Students") : nullptr;
-    if (!root || !students) {
-        QMessageBox::critical(this, "Error", "Invalid XML structure");
-        return;
-    }
-
-    XMLElement* studentElement = students->FirstChildElement("Student");
-    bool found = false;
-
-    while (studentElement) {
-        XMLElement* nameElement = studentElement->FirstChildElement("Username");
-        XMLElement* pwdElement  = studentElement->FirstChildElement("Password");
-
-        if (!nameElement || !pwdElement) {
-            studentElement = studentElement->NextSiblingElement("Student");
-            continue;
-        }
-
-        QString name = nameElement->GetText();
-        QString pwd  = pwdElement->GetText();
-         if (inputName == name && inputPwd == pwd) {
+    // The lookup (and the catch-up before it) runs on the I/O thread
+    ui->pushButton->setEnabled(false);
+    StorageService::instance().student(inputName).then(this, [this, inputPwd](const Student &student) {
+        ui->pushButton->setEnabled(true);
+        if (!student.id.isEmpty() && student.password == inputPwd) {
             QMessageBox::information(this, "Welcome",
-                                     "User: " + name + "\nWelcome to login management system!");
+                                     "User: " + student.username + "\nWelcome to login management system!");
 
-            found  = true;
-            g_user = name;
+            g_user = student.username;
 
             this->hide();
             Dashboard dash(this);      // IMPORTANT: parent = main window
             dash.exec();               // Dashboard runs
             this->show();              // show main window again when Dashboard closes
-            break;
         }
-
-        studentElement = studentElement->NextSiblingElement("Student");
-    }
-
-    if (!found) {
-        QMessageBox::warning(this, "Login Failed", "Invalid username or password");
-    }
+        else {
+            QMessageBox::warning(this, "Login Failed", "Invalid username or password");
+        }
+    });
 }
 }
 
@@ -111,90 +87,34 @@ void MainWindow::loginBtn()
         }
         else
         {
-        XMLDocument doc;
-       // const char* filePath = "C:/My_Projects/Qt_eLrn_Adv/eLearn4/users.xml";
-
-        if (doc.LoadFile(fullPath2.toUtf8().constData()) != XML_SUCCESS) {
+        Repository &repo = Repository::instance();
+        if (!repo.isLoaded()) {
             QMessageBox::critical(this, "Error", "Could not open XML file!");
             return;
         }
 
-        XMLElement* root = doc.FirstChildElement("ELearningPlatform");
-        if (!root) {
-            QMessageBox::critical(this, "Error", "Invalid XML: Missing <ELearningPlatform>");
-            return;
-        }
-
-        XMLElement* students = root->FirstChildElement("Students");
-        if (!students) {
-            QMessageBox::critical(this, "Error", "Invalid XML: Missing <Students>");
-            return;
-        }
-
         // ---------------------------------------------------------
-        // CHECK DUPLICATE USERNAMES
+        // CREATE STUDENT on the I/O thread (id is allocated by the
+        // repository, which also turns down a duplicate username;
+        // courses are enrolled later from the dashboard)
         // ---------------------------------------------------------
-        XMLElement* student = students->FirstChildElement("Student");
-        while (student) {
-            XMLElement* nameElement = student->FirstChildElement("Username");
-            if (nameElement && newName == nameElement->GetText()) {
-                QMessageBox::warning(this, "Register Error", "Username already exists!");
+        auto newStudentId = std::make_shared<QString>();
+        ui->pushButton_2->setEnabled(false);
+        StorageService::instance().run([newName, newPwd, newStudentId](Repository &repo, QString *error) {
+            return repo.registerStudent(newName, newPwd, newStudentId.get(), error);
+        }).then(this, [this, newStudentId](const StorageResult &r) {
+            ui->pushButton_2->setEnabled(true);
+            if (!r.ok) {
+                QMessageBox::warning(this, "Register Error", r.error);
                 return;
             }
-            student = student->NextSiblingElement("Student");
-        }
-
-        // ---------------------------------------------------------
-        // AUTO-GENERATE NEXT STUDENT ID
-        // ---------------------------------------------------------
-        int maxId = 0;
-        student = students->FirstChildElement("Student");
-        while (student) {
-            const char* idAttr = student->Attribute("id");
-            if (idAttr && idAttr[0] == 'S') {
-                int idNum = QString(idAttr + 1).toInt();
-                if (idNum > maxId) maxId = idNum;
-            }
-            student = student->NextSiblingElement("Student");
-        }
-        QString newStudentId = "S" + QString::number(maxId + 1).rightJustified(3, '0');
-
-        // ---------------------------------------------------------
-        // BUILD FULL ELEARNING STUDENT STRUCTURE
-        // ---------------------------------------------------------
-        XMLElement* newStudent = doc.NewElement("Student");
-        newStudent->SetAttribute("id", newStudentId.toUtf8().constData());
-
-        // Username
-        XMLElement* username = doc.NewElement("Username");
-        username->SetText(newName.toUtf8().constData());
-
-        // Password
-        XMLElement* password = doc.NewElement("Password");
-        password->SetText(newPwd.toUtf8().constData());
-
-        newStudent->InsertEndChild(username);
-        newStudent->InsertEndChild(password);
-
-        // ---------------------------------------------------------
-        // EMPTY REGISTERED COURSES FOR NEW USER
-        // (User will enroll later)
-        // ---------------------------------------------------------
-        XMLElement* regCourses = doc.NewElement("RegisteredCourses");
-        newStudent->InsertEndChild(regCourses);
-
-        // Append to XML
-        students->InsertEndChild(newStudent);
-
-        doc.SaveFile((g_xmlPath + "users.xml").toUtf8().constData());
-
-        QMessageBox::information(this, "Registration Successful",
-                                 "New user registered with ID: " + newStudentId);
-
-        ui->lineEdit_3->clear();
-        ui->lineEdit_4->clear();
 
+            QMessageBox::information(this, "Registration Successful",
+                                     "New user registered with ID: " + *newStudentId);
 
+            ui->lineEdit_3->clear();
+            ui->lineEdit_4->clear();
+        });
     }
 }
 
@@ -0,0 +1,185 @@
+#include "mutation.h"
+#include <QList>
+
+// Journal line: "<seq>\t<type>\t<key>=<value>\t..." with percent-encoded
+// values, so tabs and newlines in user input can't break the framing.
+
+static const char *const kTypeNames[] = {
+    "register", "enroll", "attempt", "certificate",
+    "update", "delete", "delete-attempt", "reserve-ids"
+};
+static const int kTypeCount = int(sizeof(kTypeNames) / sizeof(kTypeNames[0]));
+
+static void field(QByteArray &line, const char *key, const QString &value)
+{
+    line += '\t';
+    line += key;
+    line += '=';
+    line += value.toUtf8().toPercentEncoding();
+}
+
+QByteArray Mutation::encode() const
+{
+    QByteArray line = QByteArray::number(seq);
+    line += '\t';
+    line += kTypeNames[type];
+
+    field(line, "sid", studentId);
+    switch (type) {
+    case RegisterStudent:
+        field(line, "user", username);
+        field(line, "pwd", password);
+        break;
+    case Enroll:
+    case IssueCertificate:
+        field(line, "cid", courseId);
+        field(line, "date", date);
+        break;
+    case RecordAttempt:
+        field(line, "cid", courseId);
+        field(line, "tid", test.testId);
+        field(line, "attempt", QString::number(test.attempt));
+        field(line, "score", QString::number(test.score));
+        field(line, "result", test.result);
+        field(line, "grade", test.grade);
+        break;
+    case UpdateStudent:
+        field(line, "user", username);
+        field(line, "email", email);
+        field(line, "phone", phone);
+        field(line, "addr", address);
+        break;
+    case DeleteStudent:
+        break;
+    case DeleteAttempt:
+        field(line, "cid", courseId);
+        field(line, "tid", test.testId);
+        field(line, "attempt", QString::number(test.attempt));
+        break;
+    case ReserveIds:
+        field(line, "count", QString::number(count));
+        break;
+    }
+    return line;
+}
+
+bool Mutation::decode(const QByteArray &line, Mutation *out)
+{
+    const QList<QByteArray> parts = line.split('\t');
+    if (parts.size() < 2)
+        return false;
+
+    Mutation m;
+    bool ok = false;
+    m.seq = parts[0].toULongLong(&ok);
+    if (!ok)
+        return false;
+
+    int type = 0;
+    while (type < kTypeCount && parts[1] != kTypeNames[type])
+        type++;
+    if (type == kTypeCount)
+        return false;
+    m.type = Type(type);
+
+    for (int i = 2; i < parts.size(); ++i) {
+        const QByteArray &p = parts[i];
+        int eq = p.indexOf('=');
+        if (eq < 0)
+            return false;
+        const QByteArray key = p.left(eq);
+        const QString value = QString::fromUtf8(QByteArray::fromPercentEncoding(p.mid(eq + 1)));
+
+        if (key == "sid")          m.studentId = value;
+        else if (key == "cid")     m.courseId = value;
+        else if (key == "user")    m.username = value;
+        else if (key == "pwd")     m.password = value;
+        else if (key == "email")   m.email = value;
+        else if (key == "phone")   m.phone = value;
+        else if (key == "addr")    m.address = value;
+        else if (key == "date")    m.date = value;
+        else if (key == "tid")     m.test.testId = value;
+        else if (key == "attempt") m.test.attempt = value.toInt();
+        else if (key == "score")   m.test.score = value.toInt();
+        else if (key == "result")  m.test.result = value;
+        else if (key == "grade")   m.test.grade = value;
+        else if (key == "count")   m.count = value.toULongLong();
+        // unknown keys are skipped so newer journals stay readable
+    }
+
+    *out = m;
+    return true;
+}
+
+static bool fail(QString *error, const QString &text)
+{
+    if (error) *error = text;
+    return false;
+}
+
+bool applyToStudent(const Mutation &m, Student *s, QString *error)
+{
+    switch (m.type) {
+    case Mutation::Enroll: {
+        if (s->registration(m.courseId))
+            return fail(error, "Already enrolled in " + m.courseId);
+        CourseRegistration reg;
+        reg.courseId         = m.courseId;
+        reg.registrationDate = m.date;
+        s->courses.append(reg);
+        return true;
+    }
+
+    case Mutation::RecordAttempt: {
+        CourseRegistration *reg = s->registration(m.courseId);
+        if (!reg)
+            return fail(error, "Not enrolled in " + m.courseId);
+
+        // two attempts, the second only after an F
+        int attempts = reg->attemptCount(m.test.testId);
+        if (attempts >= 2)
+            return fail(error, "Maximum 2 attempts allowed.");
+        if (attempts == 1 && reg->latestGrade(m.test.testId) != "F")
+            return fail(error, "Second attempt allowed only when first attempt is F.");
+
+        TestRegistration tr = m.test;
+        tr.attempt = attempts + 1;
+        reg->tests.append(tr);
+        return true;
+    }
+
+    case Mutation::IssueCertificate: {
+        CourseRegistration *reg = s->registration(m.courseId);
+        if (!reg)
+            return fail(error, "Not enrolled in " + m.courseId);
+        if (!reg->certificateIssued()) {
+            reg->certificateStatus    = "Issued";
+            reg->certificateIssueDate = m.date;
+        }
+        return true;
+    }
+
+    case Mutation::UpdateStudent:
+        s->username = m.username;
+        s->email    = m.email;
+        s->phone    = m.phone;
+        s->address  = m.address;
+        return true;
+
+    case Mutation::DeleteAttempt: {
+        CourseRegistration *reg = s->registration(m.courseId);
+        if (!reg)
+            return fail(error, "Not enrolled in " + m.courseId);
+        for (int k = 0; k < reg->tests.size(); ++k) {
+            if (reg->tests[k].testId == m.test.testId && reg->tests[k].attempt == m.test.attempt) {
+                reg->tests.remove(k);
+                return true;
+            }
+        }
+        return fail(error, "No such test attempt");
+    }
+
+    default:
+        return fail(error, "Not a per-student change");
+    }
+}
@@ -0,0 +1,51 @@
+// mutation.h
+#ifndef MUTATION_H
+#define MUTATION_H
+
+#include <QByteArray>
+#include <QString>
+#include "records.h"
+
+// One typed change to the student data. Every write the dialogs make is
+// expressed as a Mutation so it can be applied in memory, appended to the
+// journal and replayed on the next start.
+struct Mutation
+{
+    enum Type {
+        RegisterStudent,    // studentId (assigned on apply unless reserved), username, password
+        Enroll,             // studentId, courseId, date
+        RecordAttempt,      // studentId, courseId, test (attempt number assigned on apply)
+        IssueCertificate,   // studentId, courseId, date
+        UpdateStudent,      // studentId, username, email, phone, address
+        DeleteStudent,      // studentId
+        DeleteAttempt,      // studentId, courseId, test.testId, test.attempt
+        ReserveIds          // count
+    };
+
+    Type    type = RegisterStudent;
+    quint64 seq  = 0;       // journal position, assigned when appended
+
+    QString studentId;
+    QString courseId;
+    QString username;
+    QString password;
+    QString email;
+    QString phone;
+    QString address;
+    QString date;
+    TestRegistration test;
+    quint64 count = 0;
+    quint64 firstId = 0;    // ReserveIds: first number reserved, set on commit (not journaled)
+
+    // One journal line (without the trailing newline) and back
+    QByteArray encode() const;
+    static bool decode(const QByteArray &line, Mutation *out);
+};
+
+// Apply a mutation that only touches one student's record (Enroll,
+// RecordAttempt, IssueCertificate, UpdateStudent, DeleteAttempt). Enforces
+// the same rules as the dialogs so a replayed or re-applied change is
+// validated exactly like a fresh one.
+bool applyToStudent(const Mutation &m, Student *s, QString *error = nullptr);
+
+#endif // MUTATION_H
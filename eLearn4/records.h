@@ -0,0 +1,92 @@
+// records.h
+#ifndef RECORDS_H
+#define RECORDS_H
+
+#include <QString>
+#include <QVector>
+
+// Typed copies of the users.xml elements. Field names follow the XML tags
+// so the mapping in usersxml.cpp stays obvious.
+
+// <TestRegistration testId=".." attempt="..">
+struct TestRegistration
+{
+    QString testId;
+    int     attempt = 0;
+    int     score   = 0;
+    QString result;     // "Pass" / "Fail"
+    QString grade;      // "A", "B", "C" or "F"
+};
+
+// <CourseRegistration courseId="..">
+struct CourseRegistration
+{
+    QString courseId;
+    QString registrationDate;
+    QVector<TestRegistration> tests;
+    QString certificateStatus = "Pending";
+    QString certificateIssueDate;
+
+    bool certificateIssued() const { return certificateStatus == "Issued"; }
+
+    int attemptCount(const QString &testId) const
+    {
+        int n = 0;
+        for (const TestRegistration &t : tests)
+            if (t.testId == testId) n++;
+        return n;
+    }
+
+    // Grade of the most recent attempt at testId, empty if never attempted
+    QString latestGrade(const QString &testId) const
+    {
+        QString grade;
+        for (const TestRegistration &t : tests)
+            if (t.testId == testId && !t.grade.isEmpty()) grade = t.grade;
+        return grade;
+    }
+};
+
+// <Student id="..">
+struct Student
+{
+    QString id;
+    QString username;
+    QString password;
+    QString email;
+    QString phone;
+    QString address;
+    QVector<CourseRegistration> courses;
+
+    const CourseRegistration *registration(const QString &courseId) const
+    {
+        for (const CourseRegistration &r : courses)
+            if (r.courseId == courseId) return &r;
+        return nullptr;
+    }
+
+    CourseRegistration *registration(const QString &courseId)
+    {
+        for (CourseRegistration &r : courses)
+            if (r.courseId == courseId) return &r;
+        return nullptr;
+    }
+};
+
+// <Courses><Course id=".."><Tests><Test id=".." type="..">
+struct CourseTest
+{
+    QString id;
+    QString type;
+    QString totalMarks;     // optional <TotalMarks>, empty when absent
+};
+
+struct Course
+{
+    QString id;
+    QString name;
+    QString description;
+    QVector<CourseTest> tests;
+};
+
+#endif // RECORDS_H
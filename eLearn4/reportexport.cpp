@@ -0,0 +1,261 @@
+#include "reportexport.h"
+#include <QQueue>
+#include <QThread>
+#include <QtConcurrent>
+#include "coursecatalog.h"
+#include "repository.h"
+
+static const int kBatchStudents = 512;     // students per formatting task
+
+// One output column; numeric ones are unquoted (or null) in JSON lines
+struct ReportColumn
+{
+    const char *name;
+    bool numeric;
+};
+
+struct FormattedBatch
+{
+    QByteArray bytes;
+    qint64 rows = 0;
+};
+
+static bool fail(QString *error, const QString &text)
+{
+    if (error) *error = text;
+    return false;
+}
+
+static QVector<ReportColumn> columnsOf(ReportExport::Report report)
+{
+    switch (report) {
+    case ReportExport::Grades:
+        return { { "courseId", false }, { "courseName", false }, { "testId", false },
+                 { "testType", false }, { "studentId", false }, { "username", false },
+                 { "attempts", true }, { "score", true }, { "grade", false }, { "result", false } };
+    case ReportExport::Attempts:
+        return { { "studentId", false }, { "username", false }, { "courseId", false },
+                 { "testId", false }, { "testType", false }, { "attempt", true },
+                 { "score", true }, { "grade", false }, { "result", false } };
+    case ReportExport::Certificates:
+        return { { "studentId", false }, { "username", false }, { "courseId", false },
+                 { "courseName", false }, { "issueDate", false } };
+    }
+    return {};
+}
+
+bool ReportExport::parseReport(const QString &name, Report *out)
+{
+    if (name == "grades")
+        *out = Grades;
+    else if (name == "attempts")
+        *out = Attempts;
+    else if (name == "certificates")
+        *out = Certificates;
+    else
+        return false;
+    return true;
+}
+
+bool ReportExport::parseFormat(const QString &name, Format *out)
+{
+    if (name == "csv")
+        *out = Csv;
+    else if (name == "jsonl")
+        *out = JsonLines;
+    else
+        return false;
+    return true;
+}
+
+// -----------------------------------------------------
+//  FORMATTING
+// -----------------------------------------------------
+static void appendCsvField(QByteArray *out, const QString &text)
+{
+    const QByteArray f = text.toUtf8();
+    if (!f.contains(',') && !f.contains('"') && !f.contains('\n') && !f.contains('\r')) {
+        out->append(f);
+        return;
+    }
+    out->append('"');
+    for (char c : f) {
+        if (c == '"')
+            out->append('"');
+        out->append(c);
+    }
+    out->append('"');
+}
+
+static void appendJsonString(QByteArray *out, const QString &text)
+{
+    out->append('"');
+    for (char c : text.toUtf8()) {
+        switch (c) {
+        case '"':  out->append("\\\""); break;
+        case '\\': out->append("\\\\"); break;
+        case '\n': out->append("\\n"); break;
+        case '\r': out->append("\\r"); break;
+        case '\t': out->append("\\t"); break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+                out->append("\\u00" + QByteArray::number(static_cast<unsigned char>(c), 16)
+                                          .rightJustified(2, '0'));
+            else
+                out->append(c);
+        }
+    }
+    out->append('"');
+}
+
+static void appendRow(QByteArray *out, ReportExport::Format format,
+                      const QVector<ReportColumn> &columns, const QStringList &values)
+{
+    if (format == ReportExport::Csv) {
+        for (int i = 0; i < values.size(); ++i) {
+            if (i) out->append(',');
+            appendCsvField(out, values[i]);
+        }
+        out->append('\n');
+        return;
+    }
+
+    out->append('{');
+    for (int i = 0; i < values.size(); ++i) {
+        if (i) out->append(',');
+        out->append('"').append(columns[i].name).append("\":");
+        if (!columns[i].numeric)
+            appendJsonString(out, values[i]);
+        else if (values[i].isEmpty())
+            out->append("null");
+        else
+            out->append(values[i].toUtf8());
+    }
+    out->append("}\n");
+}
+
+// The rows one batch of students contributes, in roster order
+static FormattedBatch formatBatch(ReportExport::Report report, ReportExport::Format format,
+                                  const CourseCatalog &catalog, const QString &course,
+                                  const QVector<Student> &students)
+{
+    const QVector<ReportColumn> columns = columnsOf(report);
+    FormattedBatch out;
+    for (const Student &s : students) {
+        for (const CourseRegistration &reg : s.courses) {
+            if (!course.isEmpty() && reg.courseId != course)
+                continue;
+
+            switch (report) {
+            case ReportExport::Grades: {
+                const Course *c = catalog.course(reg.courseId);
+                if (!c)
+                    break;
+                for (const CourseTest &t : c->tests) {
+                    const TestRegistration *latest = nullptr;
+                    for (const TestRegistration &a : reg.tests)
+                        if (a.testId == t.id && (!latest || a.attempt > latest->attempt))
+                            latest = &a;
+                    appendRow(&out.bytes, format, columns,
+                              { reg.courseId, c->name, t.id, t.type, s.id, s.username,
+                                QString::number(reg.attemptCount(t.id)),
+                                latest ? QString::number(latest->score) : QString(),
+                                latest ? latest->grade : QString(),
+                                latest ? latest->result : QString() });
+                    out.rows++;
+                }
+                break;
+            }
+
+            case ReportExport::Attempts:
+                for (const TestRegistration &a : reg.tests) {
+                    appendRow(&out.bytes, format, columns,
+                              { s.id, s.username, reg.courseId, a.testId,
+                                catalog.testType(reg.courseId, a.testId),
+                                QString::number(a.attempt), QString::number(a.score),
+                                a.grade, a.result });
+                    out.rows++;
+                }
+                break;
+
+            case ReportExport::Certificates:
+                if (reg.certificateIssued()) {
+                    appendRow(&out.bytes, format, columns,
+                              { s.id, s.username, reg.courseId,
+                                catalog.courseName(reg.courseId), reg.certificateIssueDate });
+                    out.rows++;
+                }
+                break;
+            }
+        }
+    }
+    return out;
+}
+
+// -----------------------------------------------------
+//  RUN
+// -----------------------------------------------------
+// The store is read on this thread while earlier batches are formatted on
+// the global pool; finished batches are written oldest first, and reading
+// waits once 2 x cores batches are in flight.
+bool ReportExport::run(Report report, Format format, QIODevice *out, qint64 *rows,
+                       QString *error)
+{
+    *rows = 0;
+    Repository &repo = Repository::instance();
+    if (!repo.isLoaded())
+        return fail(error, "Student data is not loaded");
+
+    const CourseCatalog catalog = repo.catalog();
+    if (!m_course.isEmpty() && !catalog.course(m_course))
+        return fail(error, "Unknown course \"" + m_course + "\"");
+
+    QString why;
+    if (format == Csv) {
+        QByteArray header;
+        for (const ReportColumn &c : columnsOf(report))
+            header += (header.isEmpty() ? "" : ",") + QByteArray(c.name);
+        header += '\n';
+        if (out->write(header) != header.size())
+            return fail(error, "Could not write the report: " + out->errorString());
+    }
+
+    const int maxInFlight = 2 * qMax(1, QThread::idealThreadCount());
+    const QString course = m_course;
+    QQueue<QFuture<FormattedBatch>> inFlight;
+    QVector<Student> batch;
+
+    auto writeOldest = [&]() {
+        const FormattedBatch done = inFlight.dequeue().result();
+        if (why.isEmpty() && out->write(done.bytes) != done.bytes.size())
+            why = "Could not write the report: " + out->errorString();
+        *rows += done.rows;
+    };
+    auto dispatch = [&]() {
+        inFlight.enqueue(QtConcurrent::run([report, format, &catalog, course, batch]() {
+            return formatBatch(report, format, catalog, course, batch);
+        }));
+        batch.clear();
+        if (inFlight.size() >= maxInFlight)
+            writeOldest();
+    };
+
+    QString readError;
+    const bool read = repo.forEachStudent([&](const Student &s) {
+        batch.append(s);
+        if (batch.size() == kBatchStudents)
+            dispatch();
+        return why.isEmpty();
+    }, m_progress, &readError);
+    if (!batch.isEmpty())
+        dispatch();
+    while (!inFlight.isEmpty())
+        writeOldest();
+
+    if (!read)
+        return fail(error, "Could not read the students: " + readError);
+
+    if (!why.isEmpty())
+        return fail(error, why);
+    return true;
+}
@@ -0,0 +1,44 @@
+// reportexport.h
+#ifndef REPORTEXPORT_H
+#define REPORTEXPORT_H
+
+#include <QIODevice>
+#include <QString>
+#include "studentstore.h"
+
+// Headless reports on the grade data, written as CSV (with a header line)
+// or as JSON lines (one object per row, numbers unquoted, null when empty):
+//
+//   grades        one row per enrolled student and catalog test of the
+//                 course: attempts so far and the latest score/grade/result
+//   attempts      one row per recorded attempt
+//   certificates  one row per issued certificate
+//
+// The roster is streamed from the store in batches that are formatted in
+// parallel and written in roster order, with a bounded number in flight.
+// Memory stays flat however large the roster is. Writers wait while the
+// roster is being read, as they do for the admin table.
+class ReportExport
+{
+public:
+    enum Report { Grades, Attempts, Certificates };
+    enum Format { Csv, JsonLines };
+
+    // "grades" / "attempts" / "certificates", "csv" / "jsonl"
+    static bool parseReport(const QString &name, Report *out);
+    static bool parseFormat(const QString &name, Format *out);
+
+    // Only rows of this course; all courses when empty
+    void setCourse(const QString &courseId) { m_course = courseId; }
+    void setProgress(const LoadProgress &progress) { m_progress = progress; }
+
+    // Needs a loaded Repository. *rows receives the number of rows written.
+    bool run(Report report, Format format, QIODevice *out, qint64 *rows,
+             QString *error = nullptr);
+
+private:
+    QString      m_course;
+    LoadProgress m_progress;
+};
+
+#endif // REPORTEXPORT_H
@@ -0,0 +1,258 @@
+#include "repository.h"
+#include <QMutexLocker>
+#include <QSettings>
+#include "shardedstore.h"
+#include "sqlstore.h"
+#include "xmlstore.h"
+
+static void setError(QString *error, const QString &text)
+{
+    if (error) *error = text;
+}
+
+Repository &Repository::instance()
+{
+    static Repository repo;
+    return repo;
+}
+
+// storage.ini in the data directory picks the backend; without it the
+// data stays in users.xml as before
+bool Repository::load(const QString &dataDir, QString *error)
+{
+    QSettings settings(dataDir + "storage.ini", QSettings::IniFormat);
+    const QString backend = settings.value("storage/backend", "xml").toString();
+
+    if (backend == "sqlite") {
+        auto store = std::make_unique<SqlStore>();
+        m_courses  = store.get();
+        m_students = std::move(store);
+    } else if (backend == "sharded") {
+        auto store = std::make_unique<ShardedStore>(settings.value("storage/buckets", 64).toInt());
+        m_courses  = store.get();
+        m_students = std::move(store);
+    } else if (backend == "xml") {
+        auto store = std::make_unique<XmlStore>();
+        store->setCacheLimit(settings.value("storage/cachedStudents", 256).toInt());
+        m_courses  = store.get();
+        m_students = std::move(store);
+    } else {
+        setError(error, "Unknown storage backend \"" + backend + "\" in storage.ini");
+        return false;
+    }
+
+    m_writer = std::make_unique<WriteScheduler>(m_students.get());
+    m_writer->setWindow(settings.value("storage/commitWindowMs", 0).toInt());
+    m_writer->setMaxBatch(settings.value("storage/commitBatch", 64).toInt());
+
+    m_loaded = m_students->open(dataDir, error);
+    return m_loaded;
+}
+
+bool Repository::refresh(QString *error)
+{
+    if (!m_loaded)
+        return false;
+    QMutexLocker locker(m_writer->storeMutex());
+    return m_students->refresh(error);
+}
+
+quint64 Repository::generation() const
+{
+    if (!m_loaded)
+        return 0;
+    QMutexLocker locker(m_writer->storeMutex());
+    return m_students->generation();
+}
+
+bool Repository::changesSince(quint64 since, quint64 *generation, QVector<Student> *changed,
+                              QStringList *removed) const
+{
+    if (!m_loaded)
+        return false;
+    QMutexLocker locker(m_writer->storeMutex());
+    return m_students->changesSince(since, generation, changed, removed);
+}
+
+QStringList Repository::watchedFiles() const
+{
+    if (!m_loaded)
+        return QStringList();
+    QMutexLocker locker(m_writer->storeMutex());
+    return m_students->watchedFiles();
+}
+
+CourseCatalog Repository::catalog() const
+{
+    if (!m_loaded)
+        return CourseCatalog();
+    QMutexLocker locker(m_writer->storeMutex());
+    return m_courses->catalog();
+}
+
+// -----------------------------------------------------
+//  LOOKUPS
+// -----------------------------------------------------
+bool Repository::findStudentByUsername(const QString &username, Student *out) const
+{
+    if (!m_loaded)
+        return false;
+    QMutexLocker locker(m_writer->storeMutex());
+    return m_students->findStudentByUsername(username, out);
+}
+
+bool Repository::findStudent(const QString &studentId, Student *out) const
+{
+    if (!m_loaded)
+        return false;
+    QMutexLocker locker(m_writer->storeMutex());
+    return m_students->findStudent(studentId, out);
+}
+
+bool Repository::usernameExists(const QString &username) const
+{
+    if (!m_loaded)
+        return false;
+    QMutexLocker locker(m_writer->storeMutex());
+    return m_students->usernameExists(username);
+}
+
+QVector<Student> Repository::students(const LoadProgress &progress) const
+{
+    if (!m_loaded)
+        return QVector<Student>();
+    QMutexLocker locker(m_writer->storeMutex());
+    return m_students->students(progress);
+}
+
+bool Repository::forEachStudent(const StudentVisitor &visit, const LoadProgress &progress,
+                                QString *error) const
+{
+    if (!m_loaded) {
+        setError(error, "Student data is not loaded");
+        return false;
+    }
+    QMutexLocker locker(m_writer->storeMutex());
+    return m_students->forEachStudent(visit, progress, error);
+}
+
+// -----------------------------------------------------
+//  MUTATIONS
+// -----------------------------------------------------
+bool Repository::submit(Mutation *m, QString *error)
+{
+    if (!m_loaded) {
+        setError(error, "Student data is not loaded");
+        return false;
+    }
+    return m_writer->submit(m, error);
+}
+
+bool Repository::registerStudent(const QString &username, const QString &password,
+                                 QString *newStudentId, QString *error)
+{
+    Mutation m;
+    m.type      = Mutation::RegisterStudent;
+    m.username  = username;
+    m.password  = password;
+    if (!submit(&m, error))
+        return false;
+    if (newStudentId) *newStudentId = m.studentId;
+    return true;
+}
+
+bool Repository::reserveStudentIds(quint64 count, quint64 *first, QString *error)
+{
+    Mutation m;
+    m.type  = Mutation::ReserveIds;
+    m.count = count;
+    if (!submit(&m, error))
+        return false;
+    if (first) *first = m.firstId;
+    return true;
+}
+
+// Straight to the store: a batch this size gains nothing from waiting for
+// other writers, and it still goes in under the store mutex
+bool Repository::commitAll(QVector<Mutation> *changes, QVector<QString> *results,
+                           QString *error)
+{
+    if (!m_loaded) {
+        setError(error, "Student data is not loaded");
+        return false;
+    }
+    QVector<Mutation *> batch;
+    batch.reserve(changes->size());
+    for (Mutation &m : *changes)
+        batch.append(&m);
+
+    QMutexLocker locker(m_writer->storeMutex());
+    return m_students->commitBatch(batch, results, error);
+}
+
+bool Repository::enroll(const QString &studentId, const QString &courseId,
+                        const QString &date, QString *error)
+{
+    Mutation m;
+    m.type      = Mutation::Enroll;
+    m.studentId = studentId;
+    m.courseId  = courseId;
+    m.date      = date;
+    return submit(&m, error);
+}
+
+bool Repository::recordAttempt(const QString &studentId, const QString &courseId,
+                               const TestRegistration &attempt, QString *error)
+{
+    Mutation m;
+    m.type      = Mutation::RecordAttempt;
+    m.studentId = studentId;
+    m.courseId  = courseId;
+    m.test      = attempt;
+    return submit(&m, error);
+}
+
+bool Repository::issueCertificate(const QString &studentId, const QString &courseId,
+                                  const QString &date, QString *error)
+{
+    Mutation m;
+    m.type      = Mutation::IssueCertificate;
+    m.studentId = studentId;
+    m.courseId  = courseId;
+    m.date      = date;
+    return submit(&m, error);
+}
+
+bool Repository::updateStudent(const QString &studentId, const QString &username,
+                               const QString &email, const QString &phone,
+                               const QString &address, QString *error)
+{
+    Mutation m;
+    m.type      = Mutation::UpdateStudent;
+    m.studentId = studentId;
+    m.username  = username;
+    m.email     = email;
+    m.phone     = phone;
+    m.address   = address;
+    return submit(&m, error);
+}
+
+bool Repository::deleteStudent(const QString &studentId, QString *error)
+{
+    Mutation m;
+    m.type      = Mutation::DeleteStudent;
+    m.studentId = studentId;
+    return submit(&m, error);
+}
+
+bool Repository::deleteAttempt(const QString &studentId, const QString &courseId,
+                               const QString &testId, int attempt, QString *error)
+{
+    Mutation m;
+    m.type         = Mutation::DeleteAttempt;
+    m.studentId    = studentId;
+    m.courseId     = courseId;
+    m.test.testId  = testId;
+    m.test.attempt = attempt;
+    return submit(&m, error);
+}
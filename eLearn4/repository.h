@@ -0,0 +1,98 @@
+// repository.h
+#ifndef REPOSITORY_H
+#define REPOSITORY_H
+
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include "coursecatalog.h"
+#include "records.h"
+#include "studentstore.h"
+#include "writescheduler.h"
+
+// Process-wide entry point to the student data. load() opens the backend
+// configured for the data directory (studentstore.h); every dialog reads
+// and writes through this object and never touches files or SQL itself.
+//
+// Lookups hand out copies: QString/QVector are implicitly shared, so a copy
+// is cheap and callers never hold pointers into the store.
+//
+// Every method may be called from any thread; dialogs leave the slow ones
+// to the StorageService's I/O thread. Mutations go through a
+// WriteScheduler, so concurrent ones are coalesced into one durable commit;
+// storage.ini tunes it with [storage] commitWindowMs (default 0) and
+// commitBatch (default 64); the xml backend keeps at most cachedStudents
+// (default 256) parsed students in memory.
+class Repository
+{
+public:
+    static Repository &instance();
+
+    bool load(const QString &dataDir, QString *error = nullptr);
+    bool isLoaded() const { return m_loaded; }
+
+    // Pick up changes other instances have committed; cheap when none
+    bool refresh(QString *error = nullptr);
+
+    // Increases with every committed change
+    quint64 generation() const;
+    bool changesSince(quint64 since, quint64 *generation, QVector<Student> *changed,
+                      QStringList *removed) const;     // StudentStore::changesSince
+
+    // What to watch for commits from other writers (StudentStore::watchedFiles)
+    QStringList watchedFiles() const;
+
+    // ---- catalog ----
+    // A copy, since a refresh may rebuild it; keep it while using its pointers
+    CourseCatalog catalog() const;
+
+    // ---- students ----
+    bool findStudentByUsername(const QString &username, Student *out) const;
+    bool findStudent(const QString &studentId, Student *out) const;
+    bool usernameExists(const QString &username) const;
+    QVector<Student> students(const LoadProgress &progress = LoadProgress()) const;
+    bool forEachStudent(const StudentVisitor &visit,
+                        const LoadProgress &progress = LoadProgress(),
+                        QString *error = nullptr) const;
+
+    // ---- mutations (persisted, with their batch, before returning) ----
+    bool registerStudent(const QString &username, const QString &password,
+                         QString *newStudentId, QString *error = nullptr);
+    bool enroll(const QString &studentId, const QString &courseId,
+                const QString &date, QString *error = nullptr);
+    bool recordAttempt(const QString &studentId, const QString &courseId,
+                       const TestRegistration &attempt, QString *error = nullptr);
+    bool issueCertificate(const QString &studentId, const QString &courseId,
+                          const QString &date, QString *error = nullptr);
+    bool updateStudent(const QString &studentId, const QString &username,
+                       const QString &email, const QString &phone,
+                       const QString &address, QString *error = nullptr);
+    bool deleteStudent(const QString &studentId, QString *error = nullptr);
+    bool deleteAttempt(const QString &studentId, const QString &courseId,
+                       const QString &testId, int attempt, QString *error = nullptr);
+
+    // Reserve `count` student ids in one step (bulk imports); *first receives
+    // the first number, IdAllocator::format(*first + i) the ids.
+    bool reserveStudentIds(quint64 count, quint64 *first, QString *error = nullptr);
+
+    // Apply `changes` in order as one durable commit (bulk imports), each
+    // validated on its own: (*results)[i] is empty when changes[i] went in
+    // and says why otherwise. False when the write itself failed.
+    bool commitAll(QVector<Mutation> *changes, QVector<QString> *results,
+                   QString *error = nullptr);
+
+private:
+    Repository() = default;
+    Repository(const Repository &) = delete;
+    Repository &operator=(const Repository &) = delete;
+
+    bool submit(Mutation *m, QString *error);
+
+    std::atomic<bool> m_loaded { false };
+    std::unique_ptr<StudentStore> m_students;
+    CatalogStore *m_courses = nullptr;      // the same backend object
+    std::unique_ptr<WriteScheduler> m_writer;
+};
+
+#endif // REPOSITORY_H
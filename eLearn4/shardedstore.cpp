@@ -0,0 +1,513 @@
+#include "shardedstore.h"
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QtConcurrent>
+#include <limits>
+#include "atomicfile.h"
+#include "usersxml.h"
+#include "xmlstore.h"
+
+// How long a commit waits for another instance to finish its own
+static const int kLockTimeoutMs = 5000;
+
+// Manifest lines, tab separated, values percent-encoded:
+//   add <id> <username>     new student, or a rename
+//   del <id>
+//   next <n>                id counter after a reservation
+//   put <id>                that student's bucket was rewritten
+// The file starts with "#base <n> <written>": the generation is the base
+// plus the number of lines after it, and a changed header tells readers
+// the file was rewritten.
+static const QByteArray kBaseTag = "#base\t";
+
+static QByteArray manifestHeader(quint64 base)
+{
+    return kBaseTag + QByteArray::number(base) + '\t'
+         + QByteArray::number(QDateTime::currentMSecsSinceEpoch()) + '\n';
+}
+
+static quint64 headerBase(const QByteArray &header)
+{
+    return header.mid(kBaseTag.size()).split('\t').value(0).toULongLong();
+}
+
+static bool fail(QString *error, const QString &text)
+{
+    if (error) *error = text;
+    return false;
+}
+
+static QByteArray field(const QString &value)
+{
+    return value.toUtf8().toPercentEncoding();
+}
+
+static QString unfield(const QByteArray &value)
+{
+    return QString::fromUtf8(QByteArray::fromPercentEncoding(value));
+}
+
+// Stable across runs and platforms, unlike qHash()
+static quint32 fnv1a(const QByteArray &bytes)
+{
+    quint32 h = 2166136261u;
+    for (char c : bytes)
+        h = (h ^ uchar(c)) * 16777619u;
+    return h;
+}
+
+static void fileStamp(const QString &path, qint64 *size, qint64 *modified)
+{
+    const QFileInfo fi(path);
+    *size     = fi.exists() ? fi.size() : -1;
+    *modified = fi.exists() ? fi.lastModified().toMSecsSinceEpoch() : 0;
+}
+
+ShardedStore::ShardedStore(int bucketCount)
+    : m_bucketCount(qMax(1, bucketCount))
+{
+}
+
+// -----------------------------------------------------
+//  BUCKETS
+// -----------------------------------------------------
+int ShardedStore::bucketOf(const QString &studentId) const
+{
+    return int(fnv1a(studentId.toUtf8()) % quint32(m_bucketCount));
+}
+
+QString ShardedStore::bucketPath(int bucket) const
+{
+    return m_dir + QString("bucket-%1.xml").arg(bucket, 3, 10, QChar('0'));
+}
+
+// Safe on any thread: touches nothing but the file
+static bool readBucketFile(const QString &path, QVector<Student> *students,
+                           qint64 *size, qint64 *modified, QString *error)
+{
+    fileStamp(path, size, modified);
+    students->clear();
+    if (*size < 0)
+        return true;            // bucket nobody has hashed into yet
+
+    UsersFile file;
+    if (!readUsersXml(path, &file, error))
+        return false;
+    *students = file.students;
+    return true;
+}
+
+// The cached copy unless the file changed since it was read
+bool ShardedStore::loadBucket(int bucket, Bucket *out, QString *error) const
+{
+    const QString path = bucketPath(bucket);
+    auto it = m_cache.constFind(bucket);
+    if (it != m_cache.constEnd()) {
+        qint64 size, modified;
+        fileStamp(path, &size, &modified);
+        if (size == it.value().size && modified == it.value().modified) {
+            *out = it.value();
+            return true;
+        }
+    }
+
+    Bucket b;
+    if (!readBucketFile(path, &b.students, &b.size, &b.modified, error))
+        return false;
+    m_cache.insert(bucket, b);
+    *out = b;
+    return true;
+}
+
+bool ShardedStore::writeBucket(int bucket, const Bucket &b, QString *error)
+{
+    UsersFile file;
+    file.students = b.students;
+    if (!writeUsersXml(bucketPath(bucket), file, &m_printer, error))
+        return false;
+
+    Bucket cached = b;
+    fileStamp(bucketPath(bucket), &cached.size, &cached.modified);
+    m_cache.insert(bucket, cached);
+    return true;
+}
+
+// -----------------------------------------------------
+//  MANIFEST
+// -----------------------------------------------------
+void ShardedStore::applyManifestLine(const QByteArray &line)
+{
+    const QList<QByteArray> parts = line.split('\t');
+    const QByteArray &op = parts[0];
+
+    if (op == "add" && parts.size() >= 3) {
+        const QString id = unfield(parts[1]);
+        const QString username = unfield(parts[2]);
+        auto old = m_usernameById.constFind(id);
+        if (old == m_usernameById.constEnd())
+            m_order.append(id);
+        else if (m_idByUsername.value(old.value()) == id)
+            m_idByUsername.remove(old.value());
+        m_usernameById.insert(id, username);
+        m_idByUsername.insert(username, id);
+        m_ids.observe(id);
+    } else if (op == "del" && parts.size() >= 2) {
+        const QString id = unfield(parts[1]);
+        const QString username = m_usernameById.take(id);
+        if (m_idByUsername.value(username) == id)
+            m_idByUsername.remove(username);
+        m_order.removeOne(id);
+    } else if (op == "next" && parts.size() >= 2) {
+        const quint64 next = parts[1].toULongLong();
+        if (next > m_ids.next())
+            m_ids.reset(next);
+    }
+    // "put" only moves the generation
+}
+
+// Read what was appended since the last call; start over when the file
+// was rewritten
+bool ShardedStore::readManifest(QString *error)
+{
+    QFile f(m_dir + "manifest");
+    if (!f.open(QIODevice::ReadOnly))
+        return fail(error, "Could not open " + f.fileName() + ": " + f.errorString());
+
+    const QByteArray header = f.readLine(128);
+    if (header != m_manifestHeader || f.size() < m_manifestOffset) {
+        m_order.clear();
+        m_usernameById.clear();
+        m_idByUsername.clear();
+        m_ids.reset();
+        m_manifestHeader = header;
+        m_generation = headerBase(header);
+        m_lines = 0;
+        m_manifestOffset = header.size();
+    }
+
+    f.seek(m_manifestOffset);
+    const QByteArray data = f.readAll();
+    const qint64 end = data.lastIndexOf('\n') + 1;  // a torn last line is left for later
+
+    qint64 pos = 0;
+    while (pos < end) {
+        qint64 nl = data.indexOf('\n', pos);
+        if (nl > pos)
+            applyManifestLine(data.mid(pos, nl - pos));
+        m_generation++;
+        m_lines++;
+        pos = nl + 1;
+    }
+    m_manifestOffset += end;
+    return true;
+}
+
+// `lines` holds `count` records already applied in memory
+bool ShardedStore::appendManifest(const QByteArray &lines, int count, QString *error)
+{
+    QFile f(m_dir + "manifest");
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Append))
+        return fail(error, "Could not open " + f.fileName() + ": " + f.errorString());
+
+    if (f.write(lines) != lines.size() || !syncFile(f))
+        return fail(error, "Could not write " + f.fileName() + ": " + f.errorString());
+
+    m_generation += count;
+    m_lines += count;
+    m_manifestOffset = f.size();
+    return true;
+}
+
+// Rewrite the manifest with one line per live student
+bool ShardedStore::compactManifest(QString *error)
+{
+    QByteArray body = "next\t" + QByteArray::number(m_ids.next()) + '\n';
+    for (const QString &id : m_order)
+        body += "add\t" + field(id) + '\t' + field(m_usernameById.value(id)) + '\n';
+
+    // base chosen so the new file still counts up to the current generation
+    const quint64 lines = quint64(m_order.size()) + 1;
+    const quint64 base = m_generation > lines ? m_generation - lines : 0;
+    const QByteArray header = manifestHeader(base);
+    const QByteArray data = header + body;
+    if (!writeFileAtomic(m_dir + "manifest", data.constData(), data.size(), false, error))
+        return false;
+
+    m_manifestHeader = header;
+    m_generation = base + lines;
+    m_lines = lines;
+    m_manifestOffset = data.size();
+    return true;
+}
+
+// -----------------------------------------------------
+//  OPEN
+// -----------------------------------------------------
+// First open of a data directory: split users.xml (and its journal) into
+// the catalog and the buckets
+bool ShardedStore::migrate(const QString &dataDir, QString *error)
+{
+    XmlStore xml;
+    xml.setCompactionThreshold(std::numeric_limits<qint64>::max());    // read only
+    if (QFile::exists(dataDir + "users.xml") && !xml.open(dataDir, error))
+        return false;
+
+    UsersFile catalog;
+    catalog.courses = xml.catalog().courses();
+    if (!writeUsersXml(m_dir + "catalog.xml", catalog, &m_printer, error))
+        return false;
+
+    QVector<Bucket> buckets(m_bucketCount);
+    QByteArray body;
+    IdAllocator ids;
+    const bool read = xml.forEachStudent([&](const Student &s) {
+        buckets[bucketOf(s.id)].students.append(s);
+        body += "add\t" + field(s.id) + '\t' + field(s.username) + '\n';
+        ids.observe(s.id);
+        return true;
+    }, LoadProgress(), error);
+    if (!read)
+        return false;
+    for (int i = 0; i < m_bucketCount; ++i)
+        if (!buckets[i].students.isEmpty() && !writeBucket(i, buckets[i], error))
+            return false;
+
+    // the manifest goes last: its presence marks a finished migration
+    const QByteArray data = manifestHeader(0) + "next\t" + QByteArray::number(ids.next()) + '\n' + body;
+    return writeFileAtomic(m_dir + "manifest", data.constData(), data.size(), false, error);
+}
+
+bool ShardedStore::open(const QString &dataDir, QString *error)
+{
+    m_dir = dataDir + "shards/";
+    if (!QDir().mkpath(m_dir))
+        return fail(error, "Could not create " + m_dir);
+
+    QLockFile lock(m_dir + "shards.lock");
+    if (!lock.tryLock(kLockTimeoutMs))
+        return fail(error, "The data files are busy in another window, please try again.");
+
+    if (!QFile::exists(m_dir + "manifest") && !migrate(dataDir, error))
+        return false;
+    if (!readManifest(error))
+        return false;
+    if (m_lines > 2 * quint64(m_order.size()) + 1024 && !compactManifest(error))
+        return false;
+
+    UsersFile catalog;
+    if (!readUsersXml(m_dir + "catalog.xml", &catalog, error))
+        return false;
+    m_catalog.rebuild(catalog.courses);
+    return true;
+}
+
+bool ShardedStore::refresh(QString *error)
+{
+    return readManifest(error);
+}
+
+// -----------------------------------------------------
+//  LOOKUPS
+// -----------------------------------------------------
+bool ShardedStore::findStudent(const QString &studentId, Student *out) const
+{
+    if (!m_usernameById.contains(studentId))
+        return false;
+
+    Bucket b;
+    if (!loadBucket(bucketOf(studentId), &b, nullptr))
+        return false;
+    for (const Student &s : b.students) {
+        if (s.id == studentId) {
+            if (out) *out = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ShardedStore::findStudentByUsername(const QString &username, Student *out) const
+{
+    auto it = m_idByUsername.constFind(username);
+    return it != m_idByUsername.constEnd() && findStudent(it.value(), out);
+}
+
+bool ShardedStore::usernameExists(const QString &username) const
+{
+    return m_idByUsername.contains(username);
+}
+
+// Buckets that changed since they were cached are parsed in parallel
+QVector<Student> ShardedStore::students(const LoadProgress &progress) const
+{
+    QVector<int> stale;
+    for (int i = 0; i < m_bucketCount; ++i) {
+        auto it = m_cache.constFind(i);
+        qint64 size, modified;
+        fileStamp(bucketPath(i), &size, &modified);
+        if (it == m_cache.constEnd() || it.value().size != size || it.value().modified != modified)
+            stale.append(i);
+    }
+
+    QAtomicInt done = 0;
+    const QVector<Bucket> loaded = QtConcurrent::blockingMapped<QVector<Bucket>>(stale,
+        [this, &done, &progress, &stale](int i) {
+            Bucket b;
+            readBucketFile(bucketPath(i), &b.students, &b.size, &b.modified, nullptr);
+            const int count = done.fetchAndAddOrdered(1) + 1;
+            if (progress)
+                progress(count, stale.size());
+            return b;
+        });
+    for (int k = 0; k < stale.size(); ++k)
+        m_cache.insert(stale[k], loaded[k]);
+
+    QHash<QString, const Student *> byId;
+    byId.reserve(m_order.size());
+    for (const Bucket &b : std::as_const(m_cache))
+        for (const Student &s : b.students)
+            byId.insert(s.id, &s);
+
+    QVector<Student> list;
+    list.reserve(m_order.size());
+    for (const QString &id : m_order) {
+        const Student *s = byId.value(id);
+        if (s)
+            list.append(*s);
+    }
+    return list;
+}
+
+// -----------------------------------------------------
+//  COMMIT
+// -----------------------------------------------------
+// Under the lock, with the manifest caught up: apply the change to its
+// bucket in `touched` (read fresh from disk on first use) and return the
+// manifest line that records it. Nothing changes when it is rejected.
+bool ShardedStore::apply(Mutation *m, QHash<int, Bucket> *touched, QByteArray *line,
+                         QString *error)
+{
+    if (m->type == Mutation::ReserveIds) {
+        m->firstId = m_ids.next();
+        *line = "next\t" + QByteArray::number(m->firstId + m->count);
+        return true;
+    }
+
+    if (m->type == Mutation::RegisterStudent) {
+        if (m_idByUsername.contains(m->username))
+            return fail(error, "Username already exists!");
+        if (m->studentId.isEmpty())
+            m->studentId = IdAllocator::format(m_ids.next());
+        else if (m_usernameById.contains(m->studentId))
+            return fail(error, "Duplicate student id " + m->studentId);
+    } else if (!m_usernameById.contains(m->studentId)) {
+        return fail(error, "Unknown student " + m->studentId);
+    }
+
+    if (m->type == Mutation::UpdateStudent) {
+        // a rename must not collide with another student's login
+        const QString owner = m_idByUsername.value(m->username);
+        if (!owner.isEmpty() && owner != m->studentId)
+            return fail(error, "Username already exists!");
+    }
+
+    const int bucket = bucketOf(m->studentId);
+    Bucket b;
+    if (touched->contains(bucket)) {
+        b = touched->value(bucket);
+    } else {
+        m_cache.remove(bucket);         // never trust the cache for a write
+        if (!loadBucket(bucket, &b, error))
+            return false;
+    }
+
+    int at = -1;
+    for (int k = 0; k < b.students.size(); ++k)
+        if (b.students[k].id == m->studentId)
+            at = k;
+
+    switch (m->type) {
+    case Mutation::RegisterStudent: {
+        Student s;
+        s.id       = m->studentId;
+        s.username = m->username;
+        s.password = m->password;
+        if (at >= 0)
+            b.students[at] = s;         // left over from an interrupted commit
+        else
+            b.students.append(s);
+        *line = "add\t" + field(s.id) + '\t' + field(s.username);
+        break;
+    }
+
+    case Mutation::DeleteStudent:
+        if (at >= 0)
+            b.students.remove(at);
+        *line = "del\t" + field(m->studentId);
+        break;
+
+    default: {
+        if (at < 0)
+            return fail(error, "Unknown student " + m->studentId);
+        Student updated = b.students[at];
+        if (!applyToStudent(*m, &updated, error))
+            return false;
+        if (updated.username != b.students[at].username)
+            *line = "add\t" + field(updated.id) + '\t'
+                  + field(updated.username);
+        else
+            *line = "put\t" + field(updated.id);
+        b.students[at] = updated;
+        break;
+    }
+    }
+
+    touched->insert(bucket, b);
+    return true;
+}
+
+// Each touched bucket is rewritten once and the manifest lines go out in
+// one append, so a batch costs one write per bucket plus one sync of the
+// manifest. A failed write leaves the in-memory manifest ahead of the
+// file; clearing the header makes the next read start over from disk.
+bool ShardedStore::commitBatch(const QVector<Mutation *> &batch, QVector<QString> *results,
+                               QString *error)
+{
+    results->fill(QString(), batch.size());
+
+    QLockFile lock(m_dir + "shards.lock");
+    if (!lock.tryLock(kLockTimeoutMs))
+        return fail(error, "The data files are busy in another window, please try again.");
+    if (!readManifest(error))
+        return false;
+
+    QHash<int, Bucket> touched;
+    QByteArray lines;
+    int count = 0;
+    for (int i = 0; i < batch.size(); ++i) {
+        QByteArray line;
+        if (!apply(batch[i], &touched, &line, &(*results)[i]))
+            continue;
+        applyManifestLine(line);
+        lines += line + '\n';
+        batch[i]->seq = m_generation + ++count;
+    }
+    if (count == 0)
+        return true;
+
+    for (auto it = touched.constBegin(); it != touched.constEnd(); ++it) {
+        if (!writeBucket(it.key(), it.value(), error)) {
+            m_manifestHeader.clear();
+            return false;
+        }
+    }
+    if (!appendManifest(lines, count, error)) {
+        m_manifestHeader.clear();
+        return false;
+    }
+    return true;
+}
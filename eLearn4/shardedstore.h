@@ -0,0 +1,88 @@
+// shardedstore.h
+#ifndef SHARDEDSTORE_H
+#define SHARDEDSTORE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "coursecatalog.h"
+#include "idallocator.h"
+#include "studentstore.h"
+#include "usersxml.h"
+
+// Sharded layout under <dataDir>/shards/:
+//
+//   catalog.xml        the <Courses> part of users.xml
+//   bucket-NNN.xml     the students whose id hashes to bucket NNN, in the
+//                      users.xml format (so checksums and .bak apply)
+//   manifest           append-only index: which ids exist and their
+//                      usernames, the id counter, and one line per commit
+//
+// Only the manifest is held in memory. A login, a dashboard or a test
+// submission reads (and writes) the one bucket holding that student; the
+// admin roster reads all buckets in parallel. Buckets are cached and
+// re-read when their file changes, so other instances' writes show up.
+//
+// Commits take shards/shards.lock for the bucket rewrites and the manifest
+// append only. Selected with [storage] backend=sharded (and optionally
+// buckets=N, 64 by default) in storage.ini.
+class ShardedStore : public StudentStore, public CatalogStore
+{
+public:
+    explicit ShardedStore(int bucketCount = 64);
+
+    bool open(const QString &dataDir, QString *error = nullptr) override;
+    bool refresh(QString *error = nullptr) override;
+    quint64 generation() const override { return m_generation; }
+    QStringList watchedFiles() const override { return { m_dir + "manifest" }; }
+
+    const CourseCatalog &catalog() const override { return m_catalog; }
+
+    bool findStudentByUsername(const QString &username, Student *out) const override;
+    bool findStudent(const QString &studentId, Student *out) const override;
+    bool usernameExists(const QString &username) const override;
+    QVector<Student> students(const LoadProgress &progress = LoadProgress()) const override;
+
+    bool commitBatch(const QVector<Mutation *> &batch, QVector<QString> *results,
+                     QString *error = nullptr) override;
+
+private:
+    struct Bucket
+    {
+        qint64 size = -1;           // stamp of the file the students came from
+        qint64 modified = 0;
+        QVector<Student> students;
+    };
+
+    int bucketOf(const QString &studentId) const;
+    QString bucketPath(int bucket) const;
+    bool loadBucket(int bucket, Bucket *out, QString *error) const;
+    bool writeBucket(int bucket, const Bucket &b, QString *error);
+
+    bool migrate(const QString &dataDir, QString *error);
+    bool readManifest(QString *error);
+    bool appendManifest(const QByteArray &lines, int count, QString *error);
+    void applyManifestLine(const QByteArray &line);
+    bool compactManifest(QString *error);
+    bool apply(Mutation *m, QHash<int, Bucket> *touched, QByteArray *line, QString *error);
+
+    int m_bucketCount;
+    QString m_dir;
+    CourseCatalog m_catalog;
+
+    // from the manifest
+    QVector<QString>        m_order;        // ids in registration order
+    QHash<QString, QString> m_usernameById;
+    QHash<QString, QString> m_idByUsername;
+    IdAllocator             m_ids;
+    QByteArray m_manifestHeader;
+    qint64  m_manifestOffset = 0;
+    quint64 m_generation = 0;
+    quint64 m_lines = 0;                    // manifest lines since the last rewrite
+
+    mutable QHash<int, Bucket> m_cache;
+    UsersXmlPrinter m_printer;              // reused by every bucket write
+};
+
+#endif // SHARDEDSTORE_H
@@ -0,0 +1,419 @@
+#include "snapshot.h"
+#include <QCoreApplication>
+#include <QHash>
+#include <cstring>
+#include "atomicfile.h"
+#include "idallocator.h"
+#include "usersxmlwriter.h"
+
+static const char    kSnapshotMagic[8] = { 'E', 'L', 'S', 'N', 'A', 'P', 0, 0 };
+static const quint32 kSnapshotVersion  = 1;
+static const quint32 kByteOrderMark    = 0x01020304;
+
+// -----------------------------------------------------
+//  ON-DISK RECORDS
+// -----------------------------------------------------
+struct SnapRef
+{
+    quint32 offset;     // into the string table
+    quint32 length;
+};
+
+struct SnapHeader
+{
+    char    magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    qint64  sourceSize;
+    qint64  sourceModified;
+    quint64 journalSeq;
+    quint64 nextId;
+    quint32 courseCount;
+    quint32 testCount;
+    quint32 studentCount;
+    quint32 regCount;
+    quint32 attemptCount;
+    quint32 indexSlots;     // per hash table, a power of two
+    quint64 coursesAt;
+    quint64 testsAt;
+    quint64 studentsAt;
+    quint64 regsAt;
+    quint64 attemptsAt;
+    quint64 idIndexAt;
+    quint64 nameIndexAt;
+    quint64 stringsAt;
+    quint64 stringsSize;
+};
+
+struct SnapCourse
+{
+    SnapRef id, name, description;
+    quint32 firstTest, testCount;
+};
+
+struct SnapTest
+{
+    SnapRef id, type, totalMarks;
+};
+
+struct SnapStudent
+{
+    SnapRef id, username, password, email, phone, address;
+    quint32 firstReg, regCount;
+};
+
+struct SnapReg
+{
+    SnapRef courseId, registrationDate, certificateStatus, certificateIssueDate;
+    quint32 firstAttempt, attemptCount;
+};
+
+struct SnapAttempt
+{
+    SnapRef testId, result, grade;
+    qint32  attempt, score;
+};
+
+static bool fail(QString *error, const QString &text)
+{
+    if (error) *error = text;
+    return false;
+}
+
+// Stable across runs and platforms, unlike qHash()
+static quint32 fnv1a(const char *p, qsizetype n)
+{
+    quint32 h = 2166136261u;
+    for (qsizetype i = 0; i < n; ++i)
+        h = (h ^ uchar(p[i])) * 16777619u;
+    return h;
+}
+
+template <typename T>
+static const T *table(const uchar *data, quint64 at)
+{
+    return reinterpret_cast<const T *>(data + at);
+}
+
+// -----------------------------------------------------
+//  READER
+// -----------------------------------------------------
+bool Snapshot::open(const QString &path, QString *error)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return fail(error, "Could not open " + path + ": " + m_file.errorString());
+
+    m_size = m_file.size();
+    if (m_size < qint64(sizeof(SnapHeader)))
+        return fail(error, path + " is truncated");
+    m_data = m_file.map(0, m_size);
+    if (!m_data)
+        return fail(error, "Could not map " + path + ": " + m_file.errorString());
+
+    const SnapHeader *h = table<SnapHeader>(m_data, 0);
+    if (memcmp(h->magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0
+        || h->version != kSnapshotVersion || h->byteOrder != kByteOrderMark)
+        return fail(error, path + " has an unknown format");
+
+    // every section must lie inside the file; string refs are checked on use
+    auto fits = [this](quint64 at, quint64 count, quint64 width) {
+        return at <= quint64(m_size) && count * width <= quint64(m_size) - at;
+    };
+    if (!fits(h->coursesAt, h->courseCount, sizeof(SnapCourse))
+        || !fits(h->testsAt, h->testCount, sizeof(SnapTest))
+        || !fits(h->studentsAt, h->studentCount, sizeof(SnapStudent))
+        || !fits(h->regsAt, h->regCount, sizeof(SnapReg))
+        || !fits(h->attemptsAt, h->attemptCount, sizeof(SnapAttempt))
+        || !fits(h->idIndexAt, h->indexSlots, sizeof(quint32))
+        || !fits(h->nameIndexAt, h->indexSlots, sizeof(quint32))
+        || !fits(h->stringsAt, h->stringsSize, 1)
+        || (h->indexSlots & (h->indexSlots - 1)) != 0
+        || h->indexSlots < h->studentCount)
+        return fail(error, path + " is damaged");
+
+    m_header = h;
+    return true;
+}
+
+qint64  Snapshot::sourceSize() const     { return m_header->sourceSize; }
+qint64  Snapshot::sourceModified() const { return m_header->sourceModified; }
+quint64 Snapshot::journalSeq() const     { return m_header->journalSeq; }
+quint64 Snapshot::nextId() const         { return m_header->nextId; }
+int     Snapshot::courseCount() const    { return int(m_header->courseCount); }
+int     Snapshot::studentCount() const   { return int(m_header->studentCount); }
+
+QString Snapshot::str(const SnapRef &r) const
+{
+    if (quint64(r.offset) + r.length > m_header->stringsSize)
+        return QString();
+    const char *p = reinterpret_cast<const char *>(m_data + m_header->stringsAt + r.offset);
+    return QString::fromUtf8(p, r.length);
+}
+
+bool Snapshot::equals(const SnapRef &r, const QByteArray &key) const
+{
+    return r.length == quint32(key.size())
+        && quint64(r.offset) + r.length <= m_header->stringsSize
+        && memcmp(m_data + m_header->stringsAt + r.offset, key.constData(), r.length) == 0;
+}
+
+Course Snapshot::course(int i) const
+{
+    const SnapCourse &sc = table<SnapCourse>(m_data, m_header->coursesAt)[i];
+    Course c;
+    c.id          = str(sc.id);
+    c.name        = str(sc.name);
+    c.description = str(sc.description);
+
+    const SnapTest *tests = table<SnapTest>(m_data, m_header->testsAt);
+    for (quint32 k = sc.firstTest; k < sc.firstTest + sc.testCount && k < m_header->testCount; ++k) {
+        CourseTest ct;
+        ct.id         = str(tests[k].id);
+        ct.type       = str(tests[k].type);
+        ct.totalMarks = str(tests[k].totalMarks);
+        c.tests.append(ct);
+    }
+    return c;
+}
+
+QVector<Course> Snapshot::courses() const
+{
+    QVector<Course> list;
+    list.reserve(courseCount());
+    for (int i = 0; i < courseCount(); ++i)
+        list.append(course(i));
+    return list;
+}
+
+Student Snapshot::student(int i) const
+{
+    const SnapStudent &ss = table<SnapStudent>(m_data, m_header->studentsAt)[i];
+    Student s;
+    s.id       = str(ss.id);
+    s.username = str(ss.username);
+    s.password = str(ss.password);
+    s.email    = str(ss.email);
+    s.phone    = str(ss.phone);
+    s.address  = str(ss.address);
+
+    const SnapReg *regs = table<SnapReg>(m_data, m_header->regsAt);
+    const SnapAttempt *attempts = table<SnapAttempt>(m_data, m_header->attemptsAt);
+    for (quint32 r = ss.firstReg; r < ss.firstReg + ss.regCount && r < m_header->regCount; ++r) {
+        const SnapReg &sr = regs[r];
+        CourseRegistration reg;
+        reg.courseId             = str(sr.courseId);
+        reg.registrationDate     = str(sr.registrationDate);
+        reg.certificateStatus    = str(sr.certificateStatus);
+        reg.certificateIssueDate = str(sr.certificateIssueDate);
+
+        for (quint32 a = sr.firstAttempt;
+             a < sr.firstAttempt + sr.attemptCount && a < m_header->attemptCount; ++a) {
+            TestRegistration tr;
+            tr.testId  = str(attempts[a].testId);
+            tr.attempt = attempts[a].attempt;
+            tr.score   = attempts[a].score;
+            tr.result  = str(attempts[a].result);
+            tr.grade   = str(attempts[a].grade);
+            reg.tests.append(tr);
+        }
+        s.courses.append(reg);
+    }
+    return s;
+}
+
+// Decoded from the mapping and serialized again; a snapshot keeps no XML
+bool Snapshot::writeStudents(int first, int last, UsersXmlWriter *out, QString *error) const
+{
+    for (int i = first; i < last; ++i)
+        if (!out->writeStudent(student(i), error))
+            return false;
+    return true;
+}
+
+QString Snapshot::studentId(int i) const
+{
+    return str(table<SnapStudent>(m_data, m_header->studentsAt)[i].id);
+}
+
+QString Snapshot::username(int i) const
+{
+    return str(table<SnapStudent>(m_data, m_header->studentsAt)[i].username);
+}
+
+int Snapshot::find(quint64 indexAt, bool byUsername, const QString &key) const
+{
+    if (!m_header->indexSlots)
+        return -1;
+    const QByteArray k = key.toUtf8();
+    const quint32 *buckets = table<quint32>(m_data, indexAt);
+    const SnapStudent *students = table<SnapStudent>(m_data, m_header->studentsAt);
+    const quint32 mask = m_header->indexSlots - 1;
+
+    for (quint32 h = fnv1a(k.constData(), k.size()), n = 0; n <= mask; ++h, ++n) {
+        quint32 v = buckets[h & mask];
+        if (v == 0 || v > m_header->studentCount)
+            return -1;
+        const SnapStudent &s = students[v - 1];
+        if (equals(byUsername ? s.username : s.id, k))
+            return int(v - 1);
+    }
+    return -1;
+}
+
+int Snapshot::findStudentById(const QString &id) const
+{
+    return find(m_header->idIndexAt, false, id);
+}
+
+int Snapshot::findStudentByUsername(const QString &username) const
+{
+    return find(m_header->nameIndexAt, true, username);
+}
+
+// -----------------------------------------------------
+//  WRITER
+// -----------------------------------------------------
+namespace {
+
+// Deduplicating UTF-8 string table
+class StringTable
+{
+public:
+    SnapRef add(const QString &s)
+    {
+        const QByteArray bytes = s.toUtf8();
+        auto it = m_seen.constFind(bytes);
+        if (it != m_seen.constEnd())
+            return SnapRef{ it.value(), quint32(bytes.size()) };
+        SnapRef r{ quint32(m_data.size()), quint32(bytes.size()) };
+        m_seen.insert(bytes, r.offset);
+        m_data += bytes;
+        return r;
+    }
+    const QByteArray &data() const { return m_data; }
+
+private:
+    QByteArray m_data;
+    QHash<QByteArray, quint32> m_seen;
+};
+
+template <typename T>
+void appendRecords(QByteArray &out, const QVector<T> &records)
+{
+    out.append(reinterpret_cast<const char *>(records.constData()),
+               records.size() * qsizetype(sizeof(T)));
+    while (out.size() % 8)
+        out.append('\0');
+}
+
+QVector<quint32> buildIndex(const QVector<QByteArray> &keys, quint32 buckets)
+{
+    QVector<quint32> index(buckets, 0);
+    for (int i = 0; i < keys.size(); ++i) {
+        quint32 h = fnv1a(keys[i].constData(), keys[i].size());
+        while (index[h & (buckets - 1)])
+            ++h;
+        index[h & (buckets - 1)] = quint32(i + 1);
+    }
+    return index;
+}
+
+} // namespace
+
+bool writeSnapshot(const QString &path, const UsersFile &in,
+                   qint64 sourceSize, qint64 sourceModified, QString *error)
+{
+    StringTable strings;
+    QVector<SnapCourse> courses;
+    QVector<SnapTest> tests;
+    QVector<SnapStudent> students;
+    QVector<SnapReg> regs;
+    QVector<SnapAttempt> attempts;
+    QVector<QByteArray> ids, names;
+
+    // readers take nextId as is, without observing every id
+    IdAllocator next;
+    next.reset(in.nextId);
+
+    for (const Course &c : in.courses) {
+        SnapCourse sc{ strings.add(c.id), strings.add(c.name), strings.add(c.description),
+                       quint32(tests.size()), quint32(c.tests.size()) };
+        for (const CourseTest &ct : c.tests)
+            tests.append(SnapTest{ strings.add(ct.id), strings.add(ct.type), strings.add(ct.totalMarks) });
+        courses.append(sc);
+    }
+
+    for (const Student &s : in.students) {
+        SnapStudent ss{ strings.add(s.id), strings.add(s.username), strings.add(s.password),
+                        strings.add(s.email), strings.add(s.phone), strings.add(s.address),
+                        quint32(regs.size()), quint32(s.courses.size()) };
+        for (const CourseRegistration &reg : s.courses) {
+            SnapReg sr{ strings.add(reg.courseId), strings.add(reg.registrationDate),
+                        strings.add(reg.certificateStatus), strings.add(reg.certificateIssueDate),
+                        quint32(attempts.size()), quint32(reg.tests.size()) };
+            for (const TestRegistration &tr : reg.tests)
+                attempts.append(SnapAttempt{ strings.add(tr.testId), strings.add(tr.result),
+                                             strings.add(tr.grade), tr.attempt, tr.score });
+            regs.append(sr);
+        }
+        students.append(ss);
+        next.observe(s.id);
+        ids.append(s.id.toUtf8());
+        names.append(s.username.toUtf8());
+    }
+
+    quint32 buckets = 1;
+    while (buckets < quint32(students.size()) * 2)
+        buckets <<= 1;
+
+    SnapHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+    h.version        = kSnapshotVersion;
+    h.byteOrder      = kByteOrderMark;
+    h.sourceSize     = sourceSize;
+    h.sourceModified = sourceModified;
+    h.journalSeq     = in.journalSeq;
+    h.nextId         = next.next();
+    h.courseCount    = quint32(courses.size());
+    h.testCount      = quint32(tests.size());
+    h.studentCount   = quint32(students.size());
+    h.regCount       = quint32(regs.size());
+    h.attemptCount   = quint32(attempts.size());
+    h.indexSlots     = buckets;
+
+    QByteArray out(sizeof(SnapHeader), '\0');
+    h.coursesAt   = out.size(); appendRecords(out, courses);
+    h.testsAt     = out.size(); appendRecords(out, tests);
+    h.studentsAt  = out.size(); appendRecords(out, students);
+    h.regsAt      = out.size(); appendRecords(out, regs);
+    h.attemptsAt  = out.size(); appendRecords(out, attempts);
+    h.idIndexAt   = out.size(); appendRecords(out, buildIndex(ids, buckets));
+    h.nameIndexAt = out.size(); appendRecords(out, buildIndex(names, buckets));
+    h.stringsAt   = out.size();
+    h.stringsSize = strings.data().size();
+    out += strings.data();
+    memcpy(out.data(), &h, sizeof(h));
+
+    // a per-process side file: several instances may rebuild at once
+    const QString tmp = path + "." + QString::number(QCoreApplication::applicationPid()) + ".tmp";
+    return writeSyncedFile(tmp, out.constData(), out.size(), error)
+        && replaceFile(tmp, path, false, error);
+}
+
+bool readSnapshot(const QString &path, UsersFile *out, QString *error)
+{
+    Snapshot snap;
+    if (!snap.open(path, error))
+        return false;
+
+    out->courses    = snap.courses();
+    out->journalSeq = snap.journalSeq();
+    out->nextId     = snap.nextId();
+    out->students.clear();
+    out->students.reserve(snap.studentCount());
+    for (int i = 0; i < snap.studentCount(); ++i)
+        out->students.append(snap.student(i));
+    return true;
+}
@@ -0,0 +1,86 @@
+// snapshot.h
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include "records.h"
+#include "studentsource.h"
+#include "usersxml.h"
+
+// Binary image of users.xml that is memory-mapped and read in place, so
+// startup costs one open() instead of a DOM parse. users.xml stays the
+// interchange format; a snapshot is a cache stamped with the size and
+// modification time of the users.xml it was built from (the Repository also
+// names the file after them) and is rebuilt when the stamp no longer matches.
+//
+// Layout (native little-endian, every section 8-byte aligned):
+//
+//   header          magic, version, counts, section offsets, source stamp
+//   courses[]       fixed-width records pointing into tests[]
+//   tests[]
+//   students[]      fixed-width records pointing into registrations[]
+//   registrations[] fixed-width records pointing into attempts[]
+//   attempts[]
+//   id index        open-addressing hash table, student index + 1 per slot
+//   username index  the same, keyed by username
+//   strings         UTF-8 bytes, deduplicated; records hold (offset, length)
+//
+// Bump kSnapshotVersion whenever the layout changes; older files are then
+// ignored and rebuilt.
+struct SnapHeader;
+struct SnapRef;
+
+class Snapshot : public StudentSource
+{
+public:
+    Snapshot() = default;
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+
+    // Map the file and check its header; O(1) in the roster size
+    bool open(const QString &path, QString *error = nullptr);
+    bool isOpen() const { return m_header != nullptr; }
+
+    // Stamp of the users.xml the snapshot was built from
+    qint64  sourceSize() const;
+    qint64  sourceModified() const;     // ms since epoch
+    quint64 journalSeq() const;
+    quint64 nextId() const;
+
+    int courseCount() const;
+    Course course(int i) const;
+    QVector<Course> courses() const;
+
+    int studentCount() const override;
+    Student student(int i) const;
+    bool student(int i, Student *out, QString *) const override { *out = student(i); return true; }
+    QString studentId(int i) const override;
+    QString username(int i) const;
+    bool writeStudents(int first, int last, UsersXmlWriter *out,
+                       QString *error = nullptr) const override;
+
+    // Index of the student, -1 when absent; probes compare mapped bytes
+    int findStudentById(const QString &id) const override;
+    int findStudentByUsername(const QString &username) const override;
+
+private:
+    QString str(const SnapRef &r) const;
+    bool equals(const SnapRef &r, const QByteArray &key) const;
+    int find(quint64 indexAt, bool byUsername, const QString &key) const;
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+    const SnapHeader *m_header = nullptr;
+};
+
+// Converters. writeSnapshot() stamps the file with users.xml's size and
+// modification time; readSnapshot() expands a snapshot back into the typed
+// form writeUsersXml() takes.
+bool writeSnapshot(const QString &path, const UsersFile &in,
+                   qint64 sourceSize, qint64 sourceModified, QString *error = nullptr);
+bool readSnapshot(const QString &path, UsersFile *out, QString *error = nullptr);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,553 @@
+#include "sqlstore.h"
+#include <QFile>
+#include <QHash>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+#include <limits>
+#include "idallocator.h"
+#include "xmlstore.h"
+
+static bool fail(QString *error, const QString &text)
+{
+    if (error) *error = text;
+    return false;
+}
+
+static bool run(QSqlQuery &q, QString *error)
+{
+    if (q.exec())
+        return true;
+    return fail(error, q.lastError().text());
+}
+
+static bool run(QSqlQuery &q, const QString &sql, QString *error)
+{
+    if (q.exec(sql))
+        return true;
+    return fail(error, q.lastError().text());
+}
+
+static const char *const kSchema[] = {
+    "CREATE TABLE IF NOT EXISTS meta (key TEXT PRIMARY KEY, value INTEGER)",
+    "CREATE TABLE IF NOT EXISTS courses (id TEXT PRIMARY KEY, position INTEGER,"
+    " name TEXT, description TEXT)",
+    "CREATE TABLE IF NOT EXISTS tests (course_id TEXT NOT NULL, id TEXT NOT NULL,"
+    " position INTEGER, type TEXT, total_marks TEXT, PRIMARY KEY (course_id, id))",
+    // seq keeps the order rows were added in, which is the users.xml order
+    "CREATE TABLE IF NOT EXISTS students (seq INTEGER PRIMARY KEY AUTOINCREMENT,"
+    " id TEXT NOT NULL, username TEXT NOT NULL, password TEXT,"
+    " email TEXT, phone TEXT, address TEXT)",
+    "CREATE UNIQUE INDEX IF NOT EXISTS students_id ON students (id)",
+    "CREATE UNIQUE INDEX IF NOT EXISTS students_username ON students (username)",
+    "CREATE TABLE IF NOT EXISTS registrations (seq INTEGER PRIMARY KEY AUTOINCREMENT,"
+    " student_id TEXT NOT NULL, course_id TEXT NOT NULL, registration_date TEXT,"
+    " certificate_status TEXT, certificate_issue_date TEXT)",
+    "CREATE UNIQUE INDEX IF NOT EXISTS registrations_student_course"
+    " ON registrations (student_id, course_id)",
+    "CREATE TABLE IF NOT EXISTS attempts (seq INTEGER PRIMARY KEY AUTOINCREMENT,"
+    " student_id TEXT NOT NULL, course_id TEXT NOT NULL, test_id TEXT NOT NULL,"
+    " attempt INTEGER, score INTEGER, result TEXT, grade TEXT)",
+    "CREATE INDEX IF NOT EXISTS attempts_student_course ON attempts (student_id, course_id)",
+    "CREATE INDEX IF NOT EXISTS attempts_course_test ON attempts (course_id, test_id)",
+};
+
+SqlStore::~SqlStore()
+{
+    if (m_connection.isEmpty())
+        return;
+    db().close();
+    QSqlDatabase::removeDatabase(m_connection);
+}
+
+// Commits land in the write-ahead log first
+QStringList SqlStore::watchedFiles() const
+{
+    const QString path = db().databaseName();
+    return { path, path + "-wal" };
+}
+
+QSqlDatabase SqlStore::db() const
+{
+    return QSqlDatabase::database(m_connection, false);
+}
+
+bool SqlStore::open(const QString &dataDir, QString *error)
+{
+    m_connection = QString("elearn-%1").arg(quintptr(this), 0, 16);
+    QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", m_connection);
+    database.setDatabaseName(dataDir + "elearn.db");
+    // writers from other instances wait instead of failing at once
+    database.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+    if (!database.open())
+        return fail(error, "Could not open " + dataDir + "elearn.db: " + database.lastError().text());
+
+    QSqlQuery q(database);
+    if (!run(q, "PRAGMA journal_mode = WAL", error)
+        || !run(q, "PRAGMA synchronous = FULL", error)
+        || !createSchema(error))
+        return false;
+
+    if (!meta("imported") && !importXml(dataDir, error))
+        return false;
+    if (!loadCatalog(error))
+        return false;
+
+    m_generation = meta("generation");
+    return true;
+}
+
+bool SqlStore::createSchema(QString *error)
+{
+    QSqlQuery q(db());
+    for (const char *sql : kSchema)
+        if (!run(q, sql, error))
+            return false;
+    return true;
+}
+
+// One-time migration of the XML files, in a single transaction
+bool SqlStore::importXml(const QString &dataDir, QString *error)
+{
+    XmlStore xml;
+    xml.setCompactionThreshold(std::numeric_limits<qint64>::max());    // read only
+    const bool haveXml = QFile::exists(dataDir + "users.xml");
+    if (haveXml && !xml.open(dataDir, error))
+        return false;
+
+    QSqlQuery q(db());
+    if (!run(q, "BEGIN IMMEDIATE", error))
+        return false;
+
+    bool ok = true;
+    IdAllocator ids;
+    if (haveXml) {
+        int position = 0;
+        for (const Course &c : xml.catalog().courses()) {
+            q.prepare("INSERT INTO courses (id, position, name, description) VALUES (?, ?, ?, ?)");
+            q.addBindValue(c.id);
+            q.addBindValue(position++);
+            q.addBindValue(c.name);
+            q.addBindValue(c.description);
+            ok = ok && run(q, error);
+
+            int testPosition = 0;
+            for (const CourseTest &t : c.tests) {
+                q.prepare("INSERT INTO tests (course_id, id, position, type, total_marks)"
+                          " VALUES (?, ?, ?, ?, ?)");
+                q.addBindValue(c.id);
+                q.addBindValue(t.id);
+                q.addBindValue(testPosition++);
+                q.addBindValue(t.type);
+                q.addBindValue(t.totalMarks);
+                ok = ok && run(q, error);
+            }
+        }
+
+        const bool read = ok && xml.forEachStudent([&](const Student &s) {
+            ok = ok && insertStudent(s, error);
+            for (const CourseRegistration &reg : s.courses) {
+                ok = ok && insertRegistration(s.id, reg, error);
+                for (const TestRegistration &tr : reg.tests)
+                    ok = ok && insertAttempt(s.id, reg.courseId, tr, error);
+            }
+            ids.observe(s.id);
+            return ok;
+        }, LoadProgress(), error);
+        ok = ok && read;
+    }
+
+    ok = ok && setMeta("nextId", ids.next(), error)
+            && setMeta("generation", 0, error)
+            && setMeta("imported", 1, error);
+    if (!ok) {
+        q.exec("ROLLBACK");
+        return false;
+    }
+    return run(q, "COMMIT", error);
+}
+
+bool SqlStore::loadCatalog(QString *error)
+{
+    QVector<Course> courses;
+    QHash<QString, int> byId;
+
+    QSqlQuery q(db());
+    if (!run(q, "SELECT id, name, description FROM courses ORDER BY position", error))
+        return false;
+    while (q.next()) {
+        Course c;
+        c.id          = q.value(0).toString();
+        c.name        = q.value(1).toString();
+        c.description = q.value(2).toString();
+        byId.insert(c.id, courses.size());
+        courses.append(c);
+    }
+
+    if (!run(q, "SELECT course_id, id, type, total_marks FROM tests ORDER BY course_id, position", error))
+        return false;
+    while (q.next()) {
+        auto it = byId.constFind(q.value(0).toString());
+        if (it == byId.constEnd())
+            continue;
+        CourseTest t;
+        t.id         = q.value(1).toString();
+        t.type       = q.value(2).toString();
+        t.totalMarks = q.value(3).toString();
+        courses[it.value()].tests.append(t);
+    }
+
+    m_catalog.rebuild(courses);
+    return true;
+}
+
+bool SqlStore::refresh(QString *error)
+{
+    Q_UNUSED(error);
+    m_generation = meta("generation");
+    return true;
+}
+
+// -----------------------------------------------------
+//  META
+// -----------------------------------------------------
+quint64 SqlStore::meta(const QString &key) const
+{
+    QSqlQuery q(db());
+    q.prepare("SELECT value FROM meta WHERE key = ?");
+    q.addBindValue(key);
+    return q.exec() && q.next() ? q.value(0).toULongLong() : 0;
+}
+
+bool SqlStore::setMeta(const QString &key, quint64 value, QString *error)
+{
+    QSqlQuery q(db());
+    q.prepare("INSERT OR REPLACE INTO meta (key, value) VALUES (?, ?)");
+    q.addBindValue(key);
+    q.addBindValue(value);
+    return run(q, error);
+}
+
+// -----------------------------------------------------
+//  LOOKUPS
+// -----------------------------------------------------
+bool SqlStore::findStudent(const QString &studentId, Student *out) const
+{
+    QSqlQuery q(db());
+    q.prepare("SELECT id, username, password, email, phone, address FROM students WHERE id = ?");
+    q.addBindValue(studentId);
+    if (!q.exec() || !q.next())
+        return false;
+    if (!out)
+        return true;
+
+    Student s;
+    s.id       = q.value(0).toString();
+    s.username = q.value(1).toString();
+    s.password = q.value(2).toString();
+    s.email    = q.value(3).toString();
+    s.phone    = q.value(4).toString();
+    s.address  = q.value(5).toString();
+
+    q.prepare("SELECT course_id, registration_date, certificate_status, certificate_issue_date"
+              " FROM registrations WHERE student_id = ? ORDER BY seq");
+    q.addBindValue(studentId);
+    if (!q.exec())
+        return false;
+    while (q.next()) {
+        CourseRegistration reg;
+        reg.courseId             = q.value(0).toString();
+        reg.registrationDate     = q.value(1).toString();
+        reg.certificateStatus    = q.value(2).toString();
+        reg.certificateIssueDate = q.value(3).toString();
+        s.courses.append(reg);
+    }
+
+    q.prepare("SELECT course_id, test_id, attempt, score, result, grade"
+              " FROM attempts WHERE student_id = ? ORDER BY seq");
+    q.addBindValue(studentId);
+    if (!q.exec())
+        return false;
+    while (q.next()) {
+        CourseRegistration *reg = s.registration(q.value(0).toString());
+        if (!reg)
+            continue;
+        TestRegistration tr;
+        tr.testId  = q.value(1).toString();
+        tr.attempt = q.value(2).toInt();
+        tr.score   = q.value(3).toInt();
+        tr.result  = q.value(4).toString();
+        tr.grade   = q.value(5).toString();
+        reg->tests.append(tr);
+    }
+
+    *out = s;
+    return true;
+}
+
+bool SqlStore::findStudentByUsername(const QString &username, Student *out) const
+{
+    QSqlQuery q(db());
+    q.prepare("SELECT id FROM students WHERE username = ?");
+    q.addBindValue(username);
+    if (!q.exec() || !q.next())
+        return false;
+    return findStudent(q.value(0).toString(), out);
+}
+
+bool SqlStore::usernameExists(const QString &username) const
+{
+    QSqlQuery q(db());
+    q.prepare("SELECT 1 FROM students WHERE username = ?");
+    q.addBindValue(username);
+    return q.exec() && q.next();
+}
+
+// Whole roster in three scans rather than three queries per student
+QVector<Student> SqlStore::students(const LoadProgress &progress) const
+{
+    QVector<Student> list;
+    QHash<QString, int> byId;
+
+    QSqlQuery q(db());
+    q.setForwardOnly(true);
+    if (!q.exec("SELECT id, username, password, email, phone, address FROM students ORDER BY seq"))
+        return list;
+    while (q.next()) {
+        Student s;
+        s.id       = q.value(0).toString();
+        s.username = q.value(1).toString();
+        s.password = q.value(2).toString();
+        s.email    = q.value(3).toString();
+        s.phone    = q.value(4).toString();
+        s.address  = q.value(5).toString();
+        byId.insert(s.id, list.size());
+        list.append(s);
+    }
+    if (progress)
+        progress(1, 3);
+
+    if (q.exec("SELECT student_id, course_id, registration_date, certificate_status,"
+               " certificate_issue_date FROM registrations ORDER BY seq")) {
+        while (q.next()) {
+            auto it = byId.constFind(q.value(0).toString());
+            if (it == byId.constEnd())
+                continue;
+            CourseRegistration reg;
+            reg.courseId             = q.value(1).toString();
+            reg.registrationDate     = q.value(2).toString();
+            reg.certificateStatus    = q.value(3).toString();
+            reg.certificateIssueDate = q.value(4).toString();
+            list[it.value()].courses.append(reg);
+        }
+    }
+    if (progress)
+        progress(2, 3);
+
+    if (q.exec("SELECT student_id, course_id, test_id, attempt, score, result, grade"
+               " FROM attempts ORDER BY seq")) {
+        while (q.next()) {
+            auto it = byId.constFind(q.value(0).toString());
+            CourseRegistration *reg =
+                it == byId.constEnd() ? nullptr : list[it.value()].registration(q.value(1).toString());
+            if (!reg)
+                continue;
+            TestRegistration tr;
+            tr.testId  = q.value(2).toString();
+            tr.attempt = q.value(3).toInt();
+            tr.score   = q.value(4).toInt();
+            tr.result  = q.value(5).toString();
+            tr.grade   = q.value(6).toString();
+            reg->tests.append(tr);
+        }
+    }
+    if (progress)
+        progress(3, 3);
+    return list;
+}
+
+// -----------------------------------------------------
+//  WRITES
+// -----------------------------------------------------
+bool SqlStore::insertStudent(const Student &s, QString *error)
+{
+    QSqlQuery q(db());
+    q.prepare("INSERT INTO students (id, username, password, email, phone, address)"
+              " VALUES (?, ?, ?, ?, ?, ?)");
+    q.addBindValue(s.id);
+    q.addBindValue(s.username);
+    q.addBindValue(s.password);
+    q.addBindValue(s.email);
+    q.addBindValue(s.phone);
+    q.addBindValue(s.address);
+    return run(q, error);
+}
+
+bool SqlStore::insertRegistration(const QString &studentId, const CourseRegistration &reg,
+                                  QString *error)
+{
+    QSqlQuery q(db());
+    q.prepare("INSERT INTO registrations (student_id, course_id, registration_date,"
+              " certificate_status, certificate_issue_date) VALUES (?, ?, ?, ?, ?)");
+    q.addBindValue(studentId);
+    q.addBindValue(reg.courseId);
+    q.addBindValue(reg.registrationDate);
+    q.addBindValue(reg.certificateStatus);
+    q.addBindValue(reg.certificateIssueDate);
+    return run(q, error);
+}
+
+bool SqlStore::insertAttempt(const QString &studentId, const QString &courseId,
+                             const TestRegistration &tr, QString *error)
+{
+    QSqlQuery q(db());
+    q.prepare("INSERT INTO attempts (student_id, course_id, test_id, attempt, score, result, grade)"
+              " VALUES (?, ?, ?, ?, ?, ?, ?)");
+    q.addBindValue(studentId);
+    q.addBindValue(courseId);
+    q.addBindValue(tr.testId);
+    q.addBindValue(tr.attempt);
+    q.addBindValue(tr.score);
+    q.addBindValue(tr.result);
+    q.addBindValue(tr.grade);
+    return run(q, error);
+}
+
+// Inside the transaction: validate against the rows as they are now and
+// write only what changed
+bool SqlStore::apply(Mutation *m, QString *error)
+{
+    QSqlQuery q(db());
+
+    switch (m->type) {
+    case Mutation::RegisterStudent: {
+        if (usernameExists(m->username))
+            return fail(error, "Username already exists!");
+        Student s;
+        s.id       = m->studentId;      // set when taken from a reserved range
+        s.username = m->username;
+        s.password = m->password;
+        if (s.id.isEmpty()) {
+            const quint64 next = qMax<quint64>(meta("nextId"), 1);
+            s.id = IdAllocator::format(next);
+            if (!setMeta("nextId", next + 1, error))
+                return false;
+        } else if (findStudent(s.id, nullptr)) {
+            return fail(error, "Duplicate student id " + s.id);
+        }
+        if (!insertStudent(s, error))
+            return false;
+        m->studentId = s.id;
+        return true;
+    }
+
+    case Mutation::ReserveIds: {
+        const quint64 next = qMax<quint64>(meta("nextId"), 1);
+        m->firstId = next;
+        return setMeta("nextId", next + m->count, error);
+    }
+
+    case Mutation::DeleteStudent:
+        if (!findStudent(m->studentId, nullptr))
+            return fail(error, "Unknown student " + m->studentId);
+        for (const char *table : { "attempts", "registrations" }) {
+            q.prepare(QString("DELETE FROM %1 WHERE student_id = ?").arg(table));
+            q.addBindValue(m->studentId);
+            if (!run(q, error))
+                return false;
+        }
+        q.prepare("DELETE FROM students WHERE id = ?");
+        q.addBindValue(m->studentId);
+        return run(q, error);
+
+    default:
+        break;
+    }
+
+    // per-student changes: the shared rules decide, then the rows follow
+    Student current;
+    if (!findStudent(m->studentId, &current))
+        return fail(error, "Unknown student " + m->studentId);
+    Student updated = current;
+    if (!applyToStudent(*m, &updated, error))
+        return false;
+
+    switch (m->type) {
+    case Mutation::UpdateStudent:
+        if (updated.username != current.username && usernameExists(updated.username))
+            return fail(error, "Username already exists!");
+        q.prepare("UPDATE students SET username = ?, email = ?, phone = ?, address = ? WHERE id = ?");
+        q.addBindValue(updated.username);
+        q.addBindValue(updated.email);
+        q.addBindValue(updated.phone);
+        q.addBindValue(updated.address);
+        q.addBindValue(updated.id);
+        return run(q, error);
+
+    case Mutation::Enroll:
+        return insertRegistration(updated.id, *updated.registration(m->courseId), error);
+
+    case Mutation::RecordAttempt:
+        return insertAttempt(updated.id, m->courseId,
+                             updated.registration(m->courseId)->tests.last(), error);
+
+    case Mutation::IssueCertificate: {
+        const CourseRegistration *reg = updated.registration(m->courseId);
+        q.prepare("UPDATE registrations SET certificate_status = ?, certificate_issue_date = ?"
+                  " WHERE student_id = ? AND course_id = ?");
+        q.addBindValue(reg->certificateStatus);
+        q.addBindValue(reg->certificateIssueDate);
+        q.addBindValue(updated.id);
+        q.addBindValue(m->courseId);
+        return run(q, error);
+    }
+
+    case Mutation::DeleteAttempt:
+        q.prepare("DELETE FROM attempts WHERE seq = (SELECT MIN(seq) FROM attempts"
+                  " WHERE student_id = ? AND course_id = ? AND test_id = ? AND attempt = ?)");
+        q.addBindValue(updated.id);
+        q.addBindValue(m->courseId);
+        q.addBindValue(m->test.testId);
+        q.addBindValue(m->test.attempt);
+        return run(q, error);
+
+    default:
+        return fail(error, "Unsupported change");
+    }
+}
+
+// IMMEDIATE takes SQLite's write lock up front, so the checks in apply()
+// see every other instance's committed rows and nobody writes in between.
+// Each change runs in its own savepoint so a rejected one is undone alone;
+// the batch shares the transaction, hence a single sync at COMMIT.
+bool SqlStore::commitBatch(const QVector<Mutation *> &batch, QVector<QString> *results,
+                           QString *error)
+{
+    results->fill(QString(), batch.size());
+
+    QSqlQuery q(db());
+    if (!run(q, "BEGIN IMMEDIATE", error))
+        return false;
+
+    quint64 generation = meta("generation");
+    for (int i = 0; i < batch.size(); ++i) {
+        if (!run(q, "SAVEPOINT change", error)) {
+            q.exec("ROLLBACK");
+            return false;
+        }
+        if (apply(batch[i], &(*results)[i])) {
+            batch[i]->seq = ++generation;
+        } else {
+            q.exec("ROLLBACK TO change");
+        }
+        q.exec("RELEASE change");
+    }
+
+    if (!setMeta("generation", generation, error) || !run(q, "COMMIT", error)) {
+        q.exec("ROLLBACK");
+        return false;
+    }
+
+    m_generation = generation;
+    return true;
+}
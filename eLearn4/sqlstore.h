@@ -0,0 +1,60 @@
+// sqlstore.h
+#ifndef SQLSTORE_H
+#define SQLSTORE_H
+
+#include <QSqlDatabase>
+#include <QString>
+#include <QVector>
+#include "coursecatalog.h"
+#include "studentstore.h"
+
+class QSqlQuery;
+
+// SQLite backend (Qt's bundled QSQLITE driver): elearn.db in the data
+// directory, one row per student, registration and attempt, with indexes on
+// username, student id, (student, course) and (course, test). Lookups are
+// indexed queries instead of an in-memory roster, and every commit is one
+// IMMEDIATE transaction, so several instances can share the file.
+//
+// On first open an existing users.xml (with its journal) is imported.
+class SqlStore : public StudentStore, public CatalogStore
+{
+public:
+    ~SqlStore() override;
+
+    bool open(const QString &dataDir, QString *error = nullptr) override;
+    bool refresh(QString *error = nullptr) override;
+    quint64 generation() const override { return m_generation; }
+    QStringList watchedFiles() const override;
+
+    const CourseCatalog &catalog() const override { return m_catalog; }
+
+    bool findStudentByUsername(const QString &username, Student *out) const override;
+    bool findStudent(const QString &studentId, Student *out) const override;
+    bool usernameExists(const QString &username) const override;
+    QVector<Student> students(const LoadProgress &progress = LoadProgress()) const override;
+
+    bool commitBatch(const QVector<Mutation *> &batch, QVector<QString> *results,
+                     QString *error = nullptr) override;
+
+private:
+    QSqlDatabase db() const;
+    bool createSchema(QString *error);
+    bool importXml(const QString &dataDir, QString *error);
+    bool loadCatalog(QString *error);
+    bool apply(Mutation *m, QString *error);
+
+    bool insertStudent(const Student &s, QString *error);
+    bool insertRegistration(const QString &studentId, const CourseRegistration &reg, QString *error);
+    bool insertAttempt(const QString &studentId, const QString &courseId,
+                       const TestRegistration &tr, QString *error);
+
+    quint64 meta(const QString &key) const;
+    bool setMeta(const QString &key, quint64 value, QString *error);
+
+    QString m_connection;
+    CourseCatalog m_catalog;
+    quint64 m_generation = 0;
+};
+
+#endif // SQLSTORE_H
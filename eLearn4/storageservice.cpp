@@ -0,0 +1,85 @@
+#include "storageservice.h"
+#include <QDebug>
+#include <QPromise>
+#include <QtConcurrent>
+#include <memory>
+#include "repository.h"
+
+StorageService &StorageService::instance()
+{
+    static StorageService service;
+    return service;
+}
+
+StorageService::StorageService()
+{
+    m_pool.setObjectName("storage-io");
+    m_pool.setMaxThreadCount(1);
+    m_pool.setExpiryTimeout(-1);
+}
+
+QFuture<StorageResult> StorageService::load(const QString &dataDir)
+{
+    return QtConcurrent::run(&m_pool, [this, dataDir]() {
+        emit loadProgress(0, 0);
+        StorageResult r;
+        r.ok = Repository::instance().load(dataDir, &r.error);
+        emit loaded(r.ok, r.error);
+        return r;
+    });
+}
+
+QFuture<Student> StorageService::student(const QString &username)
+{
+    return QtConcurrent::run(&m_pool, [username]() {
+        Repository &repo = Repository::instance();
+        repo.refresh();     // other instances may have written since
+        Student s;
+        if (!repo.findStudentByUsername(username, &s))
+            return Student();
+        return s;
+    });
+}
+
+QFuture<CourseCatalog> StorageService::catalog()
+{
+    return QtConcurrent::run(&m_pool, []() {
+        Repository &repo = Repository::instance();
+        repo.refresh();
+        return repo.catalog();
+    });
+}
+
+QFuture<Student> StorageService::roster()
+{
+    auto promise = std::make_shared<QPromise<Student>>();
+    QFuture<Student> future = promise->future();
+    promise->start();
+
+    m_pool.start([this, promise]() {
+        Repository &repo = Repository::instance();
+        emit loadProgress(0, 0);
+        repo.refresh();     // other instances may have written since
+        QString error;
+        if (!repo.forEachStudent([&promise](const Student &s) {
+                promise->addResult(s);
+                return !promise->isCanceled();
+            }, [this](int done, int total) {
+                emit loadProgress(done, total);
+            }, &error)) {
+            qWarning() << "roster:" << error;
+            emit rosterFailed(error);
+        }
+        promise->finish();
+    });
+    return future;
+}
+
+QFuture<StorageResult> StorageService::run(const Job &job)
+{
+    return QtConcurrent::run(&m_pool, [job]() {
+        StorageResult r;
+        r.ok = job(Repository::instance(), &r.error);
+        return r;
+    });
+}
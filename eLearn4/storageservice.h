@@ -0,0 +1,68 @@
+// storageservice.h
+#ifndef STORAGESERVICE_H
+#define STORAGESERVICE_H
+
+#include <QFuture>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include <functional>
+#include "coursecatalog.h"
+#include "records.h"
+
+class Repository;
+
+struct StorageResult
+{
+    bool ok = false;
+    QString error;
+};
+
+// Runs the Repository's slow calls (opening the data files, catching up
+// with other instances, reading the roster, committing) on one dedicated
+// I/O thread, so the GUI thread never waits on a parse or a sync. Jobs run
+// one at a time, in the order they were handed in.
+//
+// Every call returns a QFuture. Attach a continuation with
+// future.then(this, ...) to get the result on the GUI thread; it is dropped
+// if the dialog is gone by then. The signals are emitted from the I/O
+// thread and so reach GUI receivers queued.
+class StorageService : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Job = std::function<bool(Repository &repo, QString *error)>;
+
+    static StorageService &instance();
+
+    // Repository::load()
+    QFuture<StorageResult> load(const QString &dataDir);
+
+    // Catch up, then the student; an empty id when there is none
+    QFuture<Student> student(const QString &username);
+
+    // Catch up, then a copy of the catalog
+    QFuture<CourseCatalog> catalog();
+
+    // Catch up, then the whole roster as a stream: one result per student,
+    // available (resultsReadyAt()) while the rest are still being read.
+    // Cancelling the future stops the read. Reports loadProgress() too.
+    QFuture<Student> roster();
+
+    // Anything else, typically a mutation and its follow-ups
+    QFuture<StorageResult> run(const Job &job);
+
+signals:
+    void loadProgress(int done, int total);     // total 0: busy, no estimate
+    void loaded(bool ok, const QString &error);
+    void rosterFailed(const QString &error);   // a roster() stream stopped short
+
+private:
+    StorageService();
+
+    QThreadPool m_pool;     // a single thread, kept alive
+};
+
+#endif // STORAGESERVICE_H
@@ -0,0 +1,202 @@
+#include "studentindex.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include "atomicfile.h"
+#include "idallocator.h"
+#include "usersxml.h"
+#include "usersxmlwriter.h"
+
+using namespace tinyxml2;
+
+static const int kDefaultCacheLimit = 256;
+
+static bool fail(QString *error, const QString &text)
+{
+    if (error) *error = text;
+    return false;
+}
+
+static void fileStamp(const QString &path, qint64 *size, qint64 *modified)
+{
+    const QFileInfo info(path);
+    *size = info.exists() ? info.size() : -1;
+    *modified = info.exists() ? info.lastModified().toMSecsSinceEpoch() : 0;
+}
+
+StudentIndex::StudentIndex()
+    : m_cache(kDefaultCacheLimit)
+{
+}
+
+bool StudentIndex::open(const QString &path, QString *error)
+{
+    QString why;
+    if (build(path, &why))
+        return true;
+    // fall back to the generation kept by the last save
+    if (!build(path + ".bak", nullptr))
+        return fail(error, why);
+    qWarning() << why << "- indexed" << path + ".bak" << "instead";
+    return true;
+}
+
+// Each <Student> is parsed once, on its own, for its id and username and
+// then dropped; what is left of the document once the students are cut
+// out (declaration, <Courses>, the <Students> tag) is parsed for the rest.
+bool StudentIndex::build(const QString &path, QString *error)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly))
+        return fail(error, "Could not open " + path + ": " + f.errorString());
+    if (verifyChecksum(f) == Checksum::Invalid)
+        return fail(error, path + " is damaged (checksum mismatch)");
+
+    const qint64 size = f.size();
+    const uchar *data = size > 0 ? f.map(0, size) : nullptr;
+    if (size > 0 && !data)
+        return fail(error, "Could not map " + path + ": " + f.errorString());
+    const QByteArray bytes = QByteArray::fromRawData(reinterpret_cast<const char *>(data), size);
+
+    QVector<Entry> entries;
+    QHash<QString, int> byId, byUsername;
+    IdAllocator ids;
+    QByteArray rest;
+    XMLDocument doc;            // reused; each parse goes into the same node pools
+    qsizetype pos = 0, end = 0;
+    for (qsizetype at = findStudentElement(bytes, pos, &end); at >= 0;
+         at = findStudentElement(bytes, pos, &end)) {
+        if (end >= 0)
+            doc.Reserve(end - at);  // grows the pools once for a larger student
+        if (end < 0 || doc.Parse(bytes.constData() + at, end - at) != XML_SUCCESS) {
+            f.unmap(const_cast<uchar *>(data));
+            return fail(error, "Could not parse " + path + ": broken <Student> at byte "
+                               + QString::number(at));
+        }
+
+        const Student s = studentFromXml(doc.RootElement());
+        byId.insert(s.id, entries.size());
+        if (!byUsername.contains(s.username))
+            byUsername.insert(s.username, entries.size());
+        entries.append({ at, end - at, s.id, s.username });
+        ids.observe(s.id);
+
+        rest.append(bytes.constData() + pos, at - pos);
+        pos = end;
+    }
+    rest.append(bytes.constData() + pos, bytes.size() - pos);
+    if (data)
+        f.unmap(const_cast<uchar *>(data));
+
+    doc.Reserve(rest.size());
+    if (doc.ParseInPlace(rest.data(), rest.size()) != XML_SUCCESS)
+        return fail(error, "Could not parse " + path + ": " + doc.ErrorStr());
+    const XMLElement *root = doc.FirstChildElement("ELearningPlatform");
+    if (!root)
+        return fail(error, "Invalid XML: Missing <ELearningPlatform>");
+
+    QVector<Course> courses;
+    const XMLElement *list = root->FirstChildElement("Courses");
+    for (const XMLElement *c = list ? list->FirstChildElement("Course") : nullptr; c;
+         c = c->NextSiblingElement("Course"))
+        courses.append(courseFromXml(c));
+
+    const XMLElement *students = root->FirstChildElement("Students");
+    if (students && students->Unsigned64Attribute("nextId") > ids.next())
+        ids.reset(students->Unsigned64Attribute("nextId"));
+
+    m_path       = path;
+    fileStamp(path, &m_size, &m_modified);
+    m_entries    = entries;
+    m_byId       = byId;
+    m_byUsername = byUsername;
+    m_courses    = courses;
+    m_nextId     = ids.next();
+    m_journalSeq = root->Unsigned64Attribute("journalSeq");
+    m_cache.clear();
+    return true;
+}
+
+// -----------------------------------------------------
+//  LOOKUPS
+// -----------------------------------------------------
+int StudentIndex::findStudentById(const QString &id) const
+{
+    return m_byId.value(id, -1);
+}
+
+int StudentIndex::findStudentByUsername(const QString &username) const
+{
+    return m_byUsername.value(username, -1);
+}
+
+// The indexed file, or its .bak once a compaction has moved it there
+bool StudentIndex::openIndexed(QFile *f) const
+{
+    for (const QString &path : { m_path, m_path + ".bak" }) {
+        qint64 size, modified;
+        fileStamp(path, &size, &modified);
+        if (size != m_size || modified != m_modified)
+            continue;
+        f->setFileName(path);
+        return f->open(QIODevice::ReadOnly);
+    }
+    return false;
+}
+
+bool StudentIndex::readSlice(const Entry &e, QByteArray *out) const
+{
+    QFile f;
+    if (!openIndexed(&f) || !f.seek(e.offset))
+        return false;
+    *out = f.read(e.length);
+    return out->size() == e.length;
+}
+
+// The elements' bytes, read in file order from one open of the file; no
+// parse, and the cache is left alone
+bool StudentIndex::writeStudents(int first, int last, UsersXmlWriter *out, QString *error) const
+{
+    if (first >= last)
+        return true;
+    QFile f;
+    if (!openIndexed(&f))
+        return fail(error, m_path + " changed since it was indexed; its students cannot be copied");
+    for (int i = first; i < last; ++i) {
+        const Entry &e = m_entries[i];
+        QByteArray element;
+        if (f.seek(e.offset))
+            element = f.read(e.length);
+        if (element.size() != e.length)
+            return fail(error, "Could not read student " + e.id + " from " + f.fileName());
+        if (!out->copyStudent(element, error))
+            return false;
+    }
+    return true;
+}
+
+bool StudentIndex::student(int i, Student *out, QString *error) const
+{
+    if (const Student *cached = m_cache.object(i)) {
+        *out = *cached;
+        return true;
+    }
+
+    // The document is parsed in place, so it must not outlive the slice
+    const Entry &e = m_entries[i];
+    QByteArray slice;
+    if (!readSlice(e, &slice))
+        return fail(error, m_path + " changed since it was indexed; student " + e.id
+                           + " cannot be read");
+    XMLDocument doc;
+    doc.Reserve(e.length);
+    if (doc.ParseInPlace(slice.data(), slice.size()) != XML_SUCCESS)
+        return fail(error, "Could not parse student " + e.id + " in " + m_path + ": "
+                           + doc.ErrorStr());
+
+    Student *s = new Student(studentFromXml(doc.RootElement()));
+    *out = *s;
+    m_cache.insert(i, s);
+    return true;
+}
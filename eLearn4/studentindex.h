@@ -0,0 +1,75 @@
+// studentindex.h
+#ifndef STUDENTINDEX_H
+#define STUDENTINDEX_H
+
+#include <QCache>
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "records.h"
+#include "studentsource.h"
+
+// Byte offsets of every <Student> element in a users.xml, with its id and
+// username, taken by one scan in open(). A student's registrations and
+// attempts are parsed from its slice of the file only when it is asked
+// for, and the most recently used stay cached up to cacheLimit(), so
+// memory follows the students in use rather than the size of the file.
+//
+// The file is mapped only while scanning and reopened for each read, so
+// other instances can still replace it. A read first checks the file is
+// the generation indexed; once a compaction has replaced it, that
+// generation is found in <path>.bak.
+class StudentIndex : public StudentSource
+{
+public:
+    StudentIndex();
+    StudentIndex(const StudentIndex &) = delete;
+    StudentIndex &operator=(const StudentIndex &) = delete;
+
+    // Falls back to <path>.bak when the file is damaged, like readUsersXml()
+    bool open(const QString &path, QString *error = nullptr);
+
+    const QVector<Course> &courses() const { return m_courses; }
+    quint64 nextId() const { return m_nextId; }       // past every indexed id
+    quint64 journalSeq() const { return m_journalSeq; }
+
+    int studentCount() const override { return m_entries.size(); }
+    bool student(int i, Student *out, QString *error = nullptr) const override;
+    QString studentId(int i) const override { return m_entries[i].id; }
+    bool writeStudents(int first, int last, UsersXmlWriter *out,
+                       QString *error = nullptr) const override;
+    int findStudentById(const QString &id) const override;
+    int findStudentByUsername(const QString &username) const override;
+
+    int cacheLimit() const { return int(m_cache.maxCost()); }
+    void setCacheLimit(int students) { m_cache.setMaxCost(qMax(students, 1)); }
+
+private:
+    struct Entry
+    {
+        qint64  offset;
+        qint64  length;
+        QString id;
+        QString username;
+    };
+
+    bool build(const QString &path, QString *error);
+    bool openIndexed(QFile *f) const;
+    bool readSlice(const Entry &e, QByteArray *out) const;
+
+    QString m_path;
+    qint64  m_size = 0;             // stamp of the indexed file
+    qint64  m_modified = 0;
+
+    QVector<Entry>      m_entries;  // file order
+    QHash<QString, int> m_byId;
+    QHash<QString, int> m_byUsername;
+    QVector<Course>     m_courses;
+    quint64 m_nextId = 0;
+    quint64 m_journalSeq = 0;
+
+    mutable QCache<int, Student> m_cache;
+};
+
+#endif // STUDENTINDEX_H
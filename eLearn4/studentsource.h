@@ -0,0 +1,35 @@
+// studentsource.h
+#ifndef STUDENTSOURCE_H
+#define STUDENTSOURCE_H
+
+#include <QString>
+#include "records.h"
+
+class UsersXmlWriter;
+
+// Read-only view of the students as users.xml last had them: the base the
+// XmlStore keeps its changes on top of. Either a mapped Snapshot or, until
+// one has been built, a StudentIndex over users.xml itself.
+class StudentSource
+{
+public:
+    virtual ~StudentSource() = default;
+
+    virtual int studentCount() const = 0;
+    // False, with the reason, when the record can no longer be read (the
+    // file behind it changed); never a partial record
+    virtual bool student(int i, Student *out, QString *error = nullptr) const = 0;
+    virtual QString studentId(int i) const = 0;
+
+    // Students [first, last) to a compaction's writer, copied as the file
+    // has them where the source reads one. Touches nothing the calls above
+    // change, so it may run on another thread while the store is in use.
+    virtual bool writeStudents(int first, int last, UsersXmlWriter *out,
+                               QString *error = nullptr) const = 0;
+
+    // Index of the student, -1 when absent
+    virtual int findStudentById(const QString &id) const = 0;
+    virtual int findStudentByUsername(const QString &username) const = 0;
+};
+
+#endif // STUDENTSOURCE_H
@@ -0,0 +1,108 @@
+// studentstore.h
+#ifndef STUDENTSTORE_H
+#define STUDENTSTORE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+#include "coursecatalog.h"
+#include "mutation.h"
+#include "records.h"
+
+// Storage backends sit behind these two interfaces; the Repository is the
+// only caller, so dialogs never see which one is in use. A backend is picked
+// per data directory by storage.ini ([storage] backend=xml|sqlite|sharded).
+//
+// Every write arrives as a Mutation and must be validated against the
+// latest persisted state (other instances may share the data) and be
+// durable before commitBatch() returns. Stores are not thread-safe; the
+// Repository serializes every call.
+
+class CatalogStore
+{
+public:
+    virtual ~CatalogStore() = default;
+
+    virtual const CourseCatalog &catalog() const = 0;
+};
+
+// Called with (done, total) while a long read runs, possibly from pool
+// threads; `done` only grows
+using LoadProgress = std::function<void(int done, int total)>;
+
+// Receives students one by one; return false to stop
+using StudentVisitor = std::function<bool(const Student &s)>;
+
+class StudentStore
+{
+public:
+    virtual ~StudentStore() = default;
+
+    virtual bool open(const QString &dataDir, QString *error = nullptr) = 0;
+
+    // Pick up changes other instances have committed; cheap when none
+    virtual bool refresh(QString *error = nullptr) = 0;
+
+    // Increases with every committed change
+    virtual quint64 generation() const = 0;
+
+    // What changed after generation `since`, up to the current one
+    // (*generation): the students changed or added in *changed, the ids of
+    // those gone in *removed (either may list a student the caller never
+    // saw, or one left as it was). False when the store cannot tell, e.g.
+    // it has reloaded since; then only a look at every student will do.
+    virtual bool changesSince(quint64 since, quint64 *generation, QVector<Student> *changed,
+                              QStringList *removed) const
+    {
+        Q_UNUSED(since); Q_UNUSED(generation); Q_UNUSED(changed); Q_UNUSED(removed);
+        return false;
+    }
+
+    // The files another writer's commit changes; watching them is enough to
+    // notice one (see ChangeFeed)
+    virtual QStringList watchedFiles() const = 0;
+
+    virtual bool findStudentByUsername(const QString &username, Student *out) const = 0;
+    virtual bool findStudent(const QString &studentId, Student *out) const = 0;
+    virtual bool usernameExists(const QString &username) const = 0;
+    virtual QVector<Student> students(const LoadProgress &progress = LoadProgress()) const = 0;
+
+    // students() one at a time, for readers that show rows as they come;
+    // backends that can produce them without building the list override it.
+    // False when a record could not be read, and then the walk stopped there.
+    virtual bool forEachStudent(const StudentVisitor &visit,
+                                const LoadProgress &progress = LoadProgress(),
+                                QString *error = nullptr) const
+    {
+        Q_UNUSED(error);
+        for (const Student &s : students(progress))
+            if (!visit(s))
+                break;
+        return true;
+    }
+
+    // Apply and persist several changes with one durable write. Each is
+    // validated on its own, against the state the earlier ones left;
+    // (*results)[i] is empty when batch[i] went in and says why otherwise.
+    // Returns false when the write failed, and then none of them did. An
+    // applied *m carries seq and what the store assigned: studentId for
+    // RegisterStudent (one taken from a ReserveIds range is kept), firstId
+    // for ReserveIds.
+    virtual bool commitBatch(const QVector<Mutation *> &batch, QVector<QString> *results,
+                             QString *error = nullptr) = 0;
+
+    // A batch of one
+    bool commit(Mutation *m, QString *error = nullptr)
+    {
+        QVector<QString> results;
+        if (!commitBatch({ m }, &results, error))
+            return false;
+        if (results[0].isEmpty())
+            return true;
+        if (error) *error = results[0];
+        return false;
+    }
+};
+
+#endif // STUDENTSTORE_H
@@ -1,9 +1,12 @@
 #include "testpaper.h"
 #include "ui_testpaper.h"
 #include <tinyxml2.h>
+#include <QFileInfo>
 #include <QMessageBox>
+#include <QRadioButton>
 #include <QRandomGenerator>
 #include <algorithm>
+#include "changefeed.h"
 #include "globals.h"
 
 QString fullPath1 = g_xmlPath + "testBank.xml";
@@ -29,6 +32,26 @@ testPaper::testPaper(QWidget *parent)
     fillUI();
 
     connect(ui->pushButton, SIGNAL(clicked()), this, SLOT(testSubmitBtn()));
+    connect(&ChangeFeed::instance(), &ChangeFeed::testBankChanged,
+            this, &testPaper::reloadQuestions);
+}
+
+// The questions of this course were edited in testBank.xml while the paper
+// is open: draw a fresh set, so what is marked matches what is shown
+void testPaper::reloadQuestions(const QStringList &courses)
+{
+    if (!courses.contains(ui->labelCourseName->text().trimmed()))
+        return;
+
+    loadQuestions();
+    fillUI();
+    for (QRadioButton *rb : findChildren<QRadioButton *>()) {
+        rb->setAutoExclusive(false);
+        rb->setChecked(false);
+        rb->setAutoExclusive(true);
+    }
+    QMessageBox::information(this, "Test updated",
+                             "The questions for this course were changed, so the paper was reloaded.");
 }
 
 testPaper::~testPaper()
@@ -41,6 +64,7 @@ void testPaper::loadQuestions()
     QString course = ui->labelCourseName->text().trimmed();
 
     XMLDocument doc;
+    doc.Reserve(QFileInfo(fullPath1).size());
     if (doc.LoadFile(fullPath1.toUtf8().constData()) != XML_SUCCESS) {
         QMessageBox::critical(this, "Error", "Cannot open testBank.xml");
         return;
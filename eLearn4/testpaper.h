@@ -22,6 +22,7 @@ private:
     Ui::testPaper *ui;
     void loadQuestions();
     void fillUI();
+    void reloadQuestions(const QStringList &courses);
     void submitTest();
 };
 
@@ -0,0 +1,13 @@
+# Stress test for XMLDocument::Freeze() in the vendored tinyxml2; not part
+# of the app. Build it with ThreadSanitizer,
+#   qmake "CONFIG += sanitizer sanitize_thread"
+# and run it: it must print "ok" with no ThreadSanitizer reports.
+TEMPLATE = app
+CONFIG  += console c++17 thread
+CONFIG  -= qt app_bundle
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    xmlfreeze.cpp \
+    ../tinyxml2.cpp
@@ -100,6 +100,39 @@ distribution.
 	#define TIXML_SSCANF   sscanf
 #endif
 
+// Vectorized scanning (see "Scanning kernels" below). SSE2 is part of
+// x86-64, AVX2 is picked at run time; other targets, and builds with
+// TINYXML2_NO_SIMD defined, use the scalar loops.
+#if !defined(TINYXML2_NO_SIMD) && ( defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 ) )
+	#define TIXML_SIMD_X86 1
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#endif
+#endif
+
+// Memory-mapped loading (XMLDocument::LoadFileMapped). Elsewhere it
+// falls back to reading the file.
+#if defined(_WIN32)
+	#define TIXML_MMAP_WIN32 1
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+	#define TIXML_MMAP_POSIX 1
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+	#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+		#define MAP_ANONYMOUS MAP_ANON
+	#endif
+#endif
+
 #if defined(_WIN64)
 	#define TIXML_FSEEK _fseeki64
 	#define TIXML_FTELL _ftelli64
@@ -149,6 +182,396 @@ static const Entity entities[NUM_ENTITIES] = {
 };
 
 
+/*
+	Scanning kernels
+
+	The parser's hot loops - skipping indentation, finding the end of text
+	or an attribute value, and the end of a name - and the printer's search
+	for characters to escape look at 16 (SSE2) or 32 (AVX2) bytes per step.
+	A kernel is given the end of the string it scans (the terminating null
+	of the buffer) and loads only whole blocks that lie before it; the rest
+	goes through the scalar loop. No byte before the start or past the null
+	is read. Without an end - XMLUtil::SkipWhiteSpace() outside a parse -
+	the scalar loop does it all. Every kernel stops at the null, like the
+	scalar loops, and the parser's count the newlines they pass.
+*/
+struct ScanKernels {
+    // First byte that is not whitespace
+    const char* (*skipWhiteSpace)( const char* p, const char* end, int* curLineNumPtr );
+    // First endChar or null; *special is set if a '&' or CR was passed
+    const char* (*findTextEnd)( const char* p, const char* end, char endChar, int* curLineNumPtr, bool* special );
+    // First byte that is not a name character
+    const char* (*skipName)( const char* p, const char* end );
+    // First byte that may need an entity - & < > " ' - or null
+    const char* (*findEscape)( const char* p, const char* end );
+};
+
+// The end of the buffer this thread is parsing, null when it is not;
+// set for the length of a parse by ScanLimit
+static thread_local const char* scanLimit = 0;
+
+struct ScanLimit {
+    explicit ScanLimit( const char* end ) : _saved( scanLimit ) {
+        scanLimit = end;
+    }
+    ~ScanLimit() {
+        scanLimit = _saved;
+    }
+    const char* _saved;
+};
+
+static const char* SkipWhiteSpaceScalar( const char* p, const char* /*end*/, int* curLineNumPtr )
+{
+    while ( XMLUtil::IsWhiteSpace( *p ) ) {
+        if ( curLineNumPtr && *p == LF ) {
+            ++(*curLineNumPtr);
+        }
+        ++p;
+    }
+    return p;
+}
+
+static const char* FindTextEndScalar( const char* p, const char* /*end*/, char endChar, int* curLineNumPtr, bool* special )
+{
+    for( ;; ++p ) {
+        const char c = *p;
+        if ( c == endChar || c == 0 ) {
+            return p;
+        }
+        if ( c == LF ) {
+            ++(*curLineNumPtr);
+        }
+        else if ( c == '&' || c == CR ) {
+            *special = true;
+        }
+    }
+}
+
+static const char* SkipNameScalar( const char* p, const char* /*end*/ )
+{
+    while ( *p && XMLUtil::IsNameChar( static_cast<unsigned char>(*p) ) ) {
+        ++p;
+    }
+    return p;
+}
+
+static const char* FindEscapeScalar( const char* p, const char* /*end*/ )
+{
+    for( ;; ++p ) {
+        switch ( *p ) {
+            case 0:
+            case '&':
+            case '<':
+            case '>':
+            case DOUBLE_QUOTE:
+            case SINGLE_QUOTE:
+                return p;
+            default:
+                break;
+        }
+    }
+}
+
+#if defined(TIXML_SIMD_X86)
+
+static inline int LowestBit( unsigned mask )
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward( &index, mask );
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz( mask );
+#endif
+}
+
+static inline int CountBits( unsigned mask )
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int n = 0;
+    for( ; mask; mask &= mask - 1 ) {
+        ++n;
+    }
+    return n;
+#else
+    return __builtin_popcount( mask );
+#endif
+}
+
+// Bits of the bytes before `at`
+static inline unsigned BitsBelow( int at )
+{
+    return ( 1u << at ) - 1u;
+}
+
+// Whether a whole block of `size` bytes from p lies before end
+static inline bool BlockFits( const char* p, const char* end, int size )
+{
+    return end && end - p >= size;
+}
+
+// ---- SSE2: 16 bytes per step ----
+
+static inline __m128i WhiteSpace16( __m128i v )
+{
+    // ' ', or '\t' '\n' '\v' '\f' '\r' (9..13): the isspace() set
+    const __m128i t = _mm_sub_epi8( v, _mm_set1_epi8( 9 ) );
+    return _mm_or_si128( _mm_cmpeq_epi8( v, _mm_set1_epi8( ' ' ) ),
+                         _mm_cmpeq_epi8( _mm_min_epu8( t, _mm_set1_epi8( 4 ) ), t ) );
+}
+
+static inline __m128i NameChar16( __m128i v )
+{
+    // a-z A-Z, '-' '.' 0-9 ':' (0x2d..0x3a but '/'), '_', and every byte >= 0x80
+    const __m128i lower = _mm_sub_epi8( _mm_or_si128( v, _mm_set1_epi8( 0x20 ) ), _mm_set1_epi8( 'a' ) );
+    const __m128i punct = _mm_sub_epi8( v, _mm_set1_epi8( '-' ) );
+    __m128i m = _mm_cmpeq_epi8( _mm_min_epu8( lower, _mm_set1_epi8( 25 ) ), lower );
+    m = _mm_or_si128( m, _mm_andnot_si128( _mm_cmpeq_epi8( v, _mm_set1_epi8( '/' ) ),
+                                           _mm_cmpeq_epi8( _mm_min_epu8( punct, _mm_set1_epi8( 13 ) ), punct ) ) );
+    m = _mm_or_si128( m, _mm_cmpeq_epi8( v, _mm_set1_epi8( '_' ) ) );
+    return _mm_or_si128( m, _mm_cmplt_epi8( v, _mm_setzero_si128() ) );
+}
+
+static inline __m128i Escape16( __m128i v )
+{
+    __m128i m = _mm_cmpeq_epi8( v, _mm_setzero_si128() );
+    m = _mm_or_si128( m, _mm_cmpeq_epi8( v, _mm_set1_epi8( '&' ) ) );
+    m = _mm_or_si128( m, _mm_cmpeq_epi8( v, _mm_set1_epi8( '<' ) ) );
+    m = _mm_or_si128( m, _mm_cmpeq_epi8( v, _mm_set1_epi8( '>' ) ) );
+    m = _mm_or_si128( m, _mm_cmpeq_epi8( v, _mm_set1_epi8( DOUBLE_QUOTE ) ) );
+    return _mm_or_si128( m, _mm_cmpeq_epi8( v, _mm_set1_epi8( SINGLE_QUOTE ) ) );
+}
+
+static inline __m128i Load16( const char* p )
+{
+    return _mm_loadu_si128( reinterpret_cast<const __m128i*>( p ) );
+}
+
+static const char* SkipWhiteSpaceSse2( const char* p, const char* end, int* curLineNumPtr )
+{
+    for( ; BlockFits( p, end, 16 ); p += 16 ) {
+        const __m128i v = Load16( p );
+        const unsigned stop = ~static_cast<unsigned>( _mm_movemask_epi8( WhiteSpace16( v ) ) ) & 0xffffu;
+        const unsigned lines = static_cast<unsigned>( _mm_movemask_epi8( _mm_cmpeq_epi8( v, _mm_set1_epi8( LF ) ) ) );
+        if ( stop ) {
+            const int at = LowestBit( stop );
+            if ( curLineNumPtr ) {
+                *curLineNumPtr += CountBits( lines & BitsBelow( at ) );
+            }
+            return p + at;
+        }
+        if ( curLineNumPtr ) {
+            *curLineNumPtr += CountBits( lines );
+        }
+    }
+    return SkipWhiteSpaceScalar( p, end, curLineNumPtr );
+}
+
+static const char* FindTextEndSse2( const char* p, const char* end, char endChar, int* curLineNumPtr, bool* special )
+{
+    const __m128i endChars = _mm_set1_epi8( endChar );
+    for( ; BlockFits( p, end, 16 ); p += 16 ) {
+        const __m128i v = Load16( p );
+        const unsigned stop = static_cast<unsigned>( _mm_movemask_epi8(
+            _mm_or_si128( _mm_cmpeq_epi8( v, endChars ), _mm_cmpeq_epi8( v, _mm_setzero_si128() ) ) ) );
+        unsigned lines = static_cast<unsigned>( _mm_movemask_epi8( _mm_cmpeq_epi8( v, _mm_set1_epi8( LF ) ) ) );
+        unsigned marks = static_cast<unsigned>( _mm_movemask_epi8(
+            _mm_or_si128( _mm_cmpeq_epi8( v, _mm_set1_epi8( '&' ) ), _mm_cmpeq_epi8( v, _mm_set1_epi8( CR ) ) ) ) );
+        if ( stop ) {
+            const unsigned before = BitsBelow( LowestBit( stop ) );
+            lines &= before;
+            marks &= before;
+        }
+        *curLineNumPtr += CountBits( lines );
+        if ( marks ) {
+            *special = true;
+        }
+        if ( stop ) {
+            return p + LowestBit( stop );
+        }
+    }
+    return FindTextEndScalar( p, end, endChar, curLineNumPtr, special );
+}
+
+static const char* SkipNameSse2( const char* p, const char* end )
+{
+    for( ; BlockFits( p, end, 16 ); p += 16 ) {
+        const unsigned stop = ~static_cast<unsigned>( _mm_movemask_epi8( NameChar16( Load16( p ) ) ) ) & 0xffffu;
+        if ( stop ) {
+            return p + LowestBit( stop );
+        }
+    }
+    return SkipNameScalar( p, end );
+}
+
+static const char* FindEscapeSse2( const char* p, const char* end )
+{
+    for( ; BlockFits( p, end, 16 ); p += 16 ) {
+        const unsigned stop = static_cast<unsigned>( _mm_movemask_epi8( Escape16( Load16( p ) ) ) );
+        if ( stop ) {
+            return p + LowestBit( stop );
+        }
+    }
+    return FindEscapeScalar( p, end );
+}
+
+// ---- AVX2: 32 bytes per step, only called when the CPU has it ----
+
+#if defined(__GNUC__) || defined(__clang__)
+	#define TIXML_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+	#define TIXML_TARGET_AVX2
+#endif
+
+TIXML_TARGET_AVX2 static inline __m256i WhiteSpace32( __m256i v )
+{
+    const __m256i t = _mm256_sub_epi8( v, _mm256_set1_epi8( 9 ) );
+    return _mm256_or_si256( _mm256_cmpeq_epi8( v, _mm256_set1_epi8( ' ' ) ),
+                            _mm256_cmpeq_epi8( _mm256_min_epu8( t, _mm256_set1_epi8( 4 ) ), t ) );
+}
+
+TIXML_TARGET_AVX2 static inline __m256i NameChar32( __m256i v )
+{
+    const __m256i lower = _mm256_sub_epi8( _mm256_or_si256( v, _mm256_set1_epi8( 0x20 ) ), _mm256_set1_epi8( 'a' ) );
+    const __m256i punct = _mm256_sub_epi8( v, _mm256_set1_epi8( '-' ) );
+    __m256i m = _mm256_cmpeq_epi8( _mm256_min_epu8( lower, _mm256_set1_epi8( 25 ) ), lower );
+    m = _mm256_or_si256( m, _mm256_andnot_si256( _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '/' ) ),
+                                                 _mm256_cmpeq_epi8( _mm256_min_epu8( punct, _mm256_set1_epi8( 13 ) ), punct ) ) );
+    m = _mm256_or_si256( m, _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '_' ) ) );
+    return _mm256_or_si256( m, _mm256_cmpgt_epi8( _mm256_setzero_si256(), v ) );
+}
+
+TIXML_TARGET_AVX2 static inline __m256i Escape32( __m256i v )
+{
+    __m256i m = _mm256_cmpeq_epi8( v, _mm256_setzero_si256() );
+    m = _mm256_or_si256( m, _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '&' ) ) );
+    m = _mm256_or_si256( m, _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '<' ) ) );
+    m = _mm256_or_si256( m, _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '>' ) ) );
+    m = _mm256_or_si256( m, _mm256_cmpeq_epi8( v, _mm256_set1_epi8( DOUBLE_QUOTE ) ) );
+    return _mm256_or_si256( m, _mm256_cmpeq_epi8( v, _mm256_set1_epi8( SINGLE_QUOTE ) ) );
+}
+
+TIXML_TARGET_AVX2 static inline __m256i Load32( const char* p )
+{
+    return _mm256_loadu_si256( reinterpret_cast<const __m256i*>( p ) );
+}
+
+TIXML_TARGET_AVX2 static const char* SkipWhiteSpaceAvx2( const char* p, const char* end, int* curLineNumPtr )
+{
+    for( ; BlockFits( p, end, 32 ); p += 32 ) {
+        const __m256i v = Load32( p );
+        const unsigned stop = ~static_cast<unsigned>( _mm256_movemask_epi8( WhiteSpace32( v ) ) );
+        const unsigned lines = static_cast<unsigned>( _mm256_movemask_epi8( _mm256_cmpeq_epi8( v, _mm256_set1_epi8( LF ) ) ) );
+        if ( stop ) {
+            const int at = LowestBit( stop );
+            if ( curLineNumPtr ) {
+                *curLineNumPtr += CountBits( lines & BitsBelow( at ) );
+            }
+            return p + at;
+        }
+        if ( curLineNumPtr ) {
+            *curLineNumPtr += CountBits( lines );
+        }
+    }
+    return SkipWhiteSpaceScalar( p, end, curLineNumPtr );
+}
+
+TIXML_TARGET_AVX2 static const char* FindTextEndAvx2( const char* p, const char* end, char endChar, int* curLineNumPtr, bool* special )
+{
+    const __m256i endChars = _mm256_set1_epi8( endChar );
+    for( ; BlockFits( p, end, 32 ); p += 32 ) {
+        const __m256i v = Load32( p );
+        const unsigned stop = static_cast<unsigned>( _mm256_movemask_epi8(
+            _mm256_or_si256( _mm256_cmpeq_epi8( v, endChars ), _mm256_cmpeq_epi8( v, _mm256_setzero_si256() ) ) ) );
+        unsigned lines = static_cast<unsigned>( _mm256_movemask_epi8( _mm256_cmpeq_epi8( v, _mm256_set1_epi8( LF ) ) ) );
+        unsigned marks = static_cast<unsigned>( _mm256_movemask_epi8(
+            _mm256_or_si256( _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '&' ) ), _mm256_cmpeq_epi8( v, _mm256_set1_epi8( CR ) ) ) ) );
+        if ( stop ) {
+            const unsigned before = BitsBelow( LowestBit( stop ) );
+            lines &= before;
+            marks &= before;
+        }
+        *curLineNumPtr += CountBits( lines );
+        if ( marks ) {
+            *special = true;
+        }
+        if ( stop ) {
+            return p + LowestBit( stop );
+        }
+    }
+    return FindTextEndScalar( p, end, endChar, curLineNumPtr, special );
+}
+
+TIXML_TARGET_AVX2 static const char* SkipNameAvx2( const char* p, const char* end )
+{
+    for( ; BlockFits( p, end, 32 ); p += 32 ) {
+        const unsigned stop = ~static_cast<unsigned>( _mm256_movemask_epi8( NameChar32( Load32( p ) ) ) );
+        if ( stop ) {
+            return p + LowestBit( stop );
+        }
+    }
+    return SkipNameScalar( p, end );
+}
+
+TIXML_TARGET_AVX2 static const char* FindEscapeAvx2( const char* p, const char* end )
+{
+    for( ; BlockFits( p, end, 32 ); p += 32 ) {
+        const unsigned stop = static_cast<unsigned>( _mm256_movemask_epi8( Escape32( Load32( p ) ) ) );
+        if ( stop ) {
+            return p + LowestBit( stop );
+        }
+    }
+    return FindEscapeScalar( p, end );
+}
+
+static bool CpuHasAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid( info, 0 );
+    if ( info[0] < 7 ) {
+        return false;
+    }
+    __cpuid( info, 1 );
+    const bool osSavesYmm = ( info[2] & (1 << 27) ) && ( _xgetbv( 0 ) & 6 ) == 6;
+    __cpuidex( info, 7, 0 );
+    return osSavesYmm && ( info[1] & (1 << 5) );
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "avx2" ) != 0;
+#endif
+}
+
+#endif // TIXML_SIMD_X86
+
+static ScanKernels SelectScanKernels()
+{
+#if defined(TIXML_SIMD_X86)
+    if ( CpuHasAvx2() ) {
+        const ScanKernels avx2 = { SkipWhiteSpaceAvx2, FindTextEndAvx2, SkipNameAvx2, FindEscapeAvx2 };
+        return avx2;
+    }
+    const ScanKernels sse2 = { SkipWhiteSpaceSse2, FindTextEndSse2, SkipNameSse2, FindEscapeSse2 };
+    return sse2;
+#else
+    const ScanKernels scalar = { SkipWhiteSpaceScalar, FindTextEndScalar, SkipNameScalar, FindEscapeScalar };
+    return scalar;
+#endif
+}
+
+static const ScanKernels& Scan()
+{
+    static const ScanKernels kernels = SelectScanKernels();
+    return kernels;
+}
+
+
+const char* XMLUtil::SkipWhiteSpaceRun( const char* p, int* curLineNumPtr )
+{
+    return Scan().skipWhiteSpace( p, scanLimit, curLineNumPtr );
+}
+
+
 StrPair::~StrPair()
 {
     Reset();
@@ -213,19 +636,23 @@ char* StrPair::ParseText( char* p, const char* endTag, int strFlags, int* curLin
     char* start = p;
     const char  endChar = *endTag;
     size_t length = strlen( endTag );
+    bool special = false;
 
     // Inner loop of text parsing.
-    while ( *p ) {
-        if ( *p == endChar && strncmp( p, endTag, length ) == 0 ) {
+    for( ;; ++p ) {
+        p = const_cast<char*>( Scan().findTextEnd( p, scanLimit, endChar, curLineNumPtr, &special ) );
+        if ( !*p ) {
+            return 0;
+        }
+        if ( strncmp( p, endTag, length ) == 0 ) {
+            // No '&' and no CR: GetStr() has nothing to translate
+            if ( !special ) {
+                strFlags &= ~( NEEDS_ENTITY_PROCESSING | NEEDS_NEWLINE_NORMALIZATION );
+            }
             Set( start, p, strFlags );
             return p + length;
-        } else if (*p == '\n') {
-            ++(*curLineNumPtr);
         }
-        ++p;
-        TIXMLASSERT( p );
     }
-    return 0;
 }
 
 
@@ -239,10 +666,7 @@ char* StrPair::ParseName( char* p )
     }
 
     char* const start = p;
-    ++p;
-    while ( *p && XMLUtil::IsNameChar( static_cast<unsigned char>(*p) ) ) {
-        ++p;
-    }
+    p = const_cast<char*>( Scan().skipName( p + 1, scanLimit ) );
 
     Set( start, p, 0 );
     return p;
@@ -789,7 +1213,439 @@ bool XMLDocument::Accept( XMLVisitor* visitor ) const
             }
         }
     }
-    return visitor->VisitExit( *this );
+    return visitor->VisitExit( *this );
+}
+
+
+// --------- XMLAtomTable ----------- //
+
+XMLAtomTable::XMLAtomTable() : _names(), _slots(), _chunks(), _chunkUsed( CHUNK_SIZE )
+{
+    Rehash( 64 );
+}
+
+
+XMLAtomTable::~XMLAtomTable()
+{
+    while( !_chunks.Empty() ) {
+        delete [] _chunks.Pop();
+    }
+}
+
+
+// FNV-1a
+unsigned XMLAtomTable::Hash( const char* name, size_t length )
+{
+    unsigned h = 2166136261u;
+    for( size_t i = 0; i < length; ++i ) {
+        h = ( h ^ static_cast<unsigned char>(name[i]) ) * 16777619u;
+    }
+    return h;
+}
+
+
+// The slot holding the name, or the free slot where it would go
+size_t XMLAtomTable::Slot( const char* name, size_t length, unsigned hash ) const
+{
+    const size_t mask = _slots.Size() - 1;
+    for( size_t i = hash & mask; ; i = ( i + 1 ) & mask ) {
+        const int id = _slots[i];
+        if ( id == 0 ) {
+            return i;
+        }
+        const Name& n = _names[id - 1];
+        if ( n.hash == hash && n.length == length && memcmp( n.str, name, length ) == 0 ) {
+            return i;
+        }
+    }
+}
+
+
+void XMLAtomTable::Rehash( size_t slots )
+{
+    _slots.Clear();
+    memset( _slots.PushArr( slots ), 0, slots * sizeof( int ) );
+    for( size_t i = 0; i < _names.Size(); ++i ) {
+        const Name& n = _names[i];
+        _slots[Slot( n.str, n.length, n.hash )] = static_cast<int>( i + 1 );
+    }
+}
+
+
+const char* XMLAtomTable::Store( const char* name, size_t length )
+{
+    char* to;
+    if ( length + 1 > CHUNK_SIZE / 4 ) {
+        // Long names get a chunk of their own; the current one stays open
+        to = new char[length + 1];
+        _chunks.Push( to );
+        if ( _chunks.Size() > 1 ) {
+            const size_t last = _chunks.Size() - 1;
+            _chunks[last] = _chunks[last - 1];
+            _chunks[last - 1] = to;
+        }
+    }
+    else {
+        if ( _chunkUsed + length + 1 > CHUNK_SIZE ) {
+            _chunks.Push( new char[CHUNK_SIZE] );
+            _chunkUsed = 0;
+        }
+        to = _chunks.PeekTop() + _chunkUsed;
+        _chunkUsed += length + 1;
+    }
+    memcpy( to, name, length );
+    to[length] = 0;
+    return to;
+}
+
+
+XMLAtom XMLAtomTable::Intern( const char* name, size_t length )
+{
+    const unsigned hash = Hash( name, length );
+    size_t slot = Slot( name, length, hash );
+    if ( _slots[slot] ) {
+        return XMLAtom( _slots[slot] );
+    }
+    Name n;
+    n.str = Store( name, length );
+    n.length = length;
+    n.hash = hash;
+    _names.Push( n );
+    const int id = static_cast<int>( _names.Size() );
+    if ( 2 * _names.Size() > _slots.Size() ) {
+        Rehash( 2 * _slots.Size() );
+        slot = Slot( name, length, hash );
+    }
+    _slots[slot] = id;
+    return XMLAtom( id );
+}
+
+
+XMLAtom XMLAtomTable::Find( const char* name ) const
+{
+    const size_t length = strlen( name );
+    const unsigned hash = Hash( name, length );
+    return XMLAtom( _slots[Slot( name, length, hash )] );
+}
+
+
+// --------- XMLChildIndex ----------- //
+
+/*
+	Index of one node's child elements, see XMLNode::BuildChildIndex().
+	By name: the first and last child of each atom, and the ones between
+	linked through _prevSameName/_nextSameName. By key: for each (name,
+	key attribute) built, a hash table from the attribute's value to
+	the first child with it; linear probing, at most half full.
+*/
+class XMLChildIndex
+{
+public:
+    explicit XMLChildIndex( const XMLNode* parent );
+    ~XMLChildIndex();
+
+    void Append( XMLElement* element );
+    void Remove( XMLElement* element );
+    // A child's 'key' attribute changed
+    void DropKeys( XMLAtom key );
+
+    XMLElement* First( XMLAtom name ) const {
+        const size_t id = static_cast<size_t>( name._id );
+        return ( id && id <= _names.Size() ) ? _names[id - 1].first : 0;
+    }
+    XMLElement* Last( XMLAtom name ) const {
+        const size_t id = static_cast<size_t>( name._id );
+        return ( id && id <= _names.Size() ) ? _names[id - 1].last : 0;
+    }
+    // Builds the table for this name and key, if it isn't there
+    void AddKeys( XMLAtom name, XMLAtom key );
+    // Null when there is no table for this name and key, see HasKeys()
+    XMLElement* Find( XMLAtom name, XMLAtom key, const char* value ) const;
+    bool HasKeys( XMLAtom name, XMLAtom key ) const {
+        return Keys( name, key ) != 0;
+    }
+
+    static XMLElement* Next( const XMLElement* element ) {
+        return element->_nextSameName;
+    }
+    static XMLElement* Previous( const XMLElement* element ) {
+        return element->_prevSameName;
+    }
+
+private:
+    XMLChildIndex( const XMLChildIndex& );	// not supported
+    void operator=( const XMLChildIndex& );	// not supported
+
+    struct Ends {
+        XMLElement* first;
+        XMLElement* last;
+    };
+    struct Slot {
+        unsigned    hash;
+        XMLElement* element;	// null: free
+    };
+    struct KeyMap {
+        XMLAtom name;
+        XMLAtom key;
+        DynArray< Slot, 16 > slots;
+        size_t count;
+        bool duplicates;		// some value is on more than one child
+    };
+
+    KeyMap* Keys( XMLAtom name, XMLAtom key ) const;
+    static unsigned Hash( const char* value );
+    static void Insert( KeyMap* map, XMLElement* element );
+    static void Erase( KeyMap* map, XMLElement* element );
+    static void Resize( KeyMap* map, size_t slots );
+    void DropKeyMap( size_t i );
+
+    DynArray< Ends, 16 >	_names;		// by atom id - 1
+    DynArray< KeyMap*, 2 >	_keys;
+};
+
+
+XMLChildIndex::XMLChildIndex( const XMLNode* parent ) : _names(), _keys()
+{
+    for( XMLNode* node = parent->_firstChild; node; node = node->_next ) {
+        XMLElement* element = node->ToElement();
+        if ( element ) {
+            Append( element );
+        }
+    }
+}
+
+
+XMLChildIndex::~XMLChildIndex()
+{
+    while( !_keys.Empty() ) {
+        delete _keys.Pop();
+    }
+}
+
+
+void XMLChildIndex::Append( XMLElement* element )
+{
+    const size_t id = static_cast<size_t>( element->_nameAtom._id );
+    TIXMLASSERT( id );
+    if ( id > _names.Size() ) {
+        const size_t grow = id - _names.Size();
+        memset( _names.PushArr( grow ), 0, grow * sizeof( Ends ) );
+    }
+    Ends& ends = _names[id - 1];
+    element->_prevSameName = ends.last;
+    element->_nextSameName = 0;
+    if ( ends.last ) {
+        ends.last->_nextSameName = element;
+    }
+    else {
+        ends.first = element;
+    }
+    ends.last = element;
+
+    for( size_t i = 0; i < _keys.Size(); ++i ) {
+        if ( _keys[i]->name == element->_nameAtom ) {
+            Insert( _keys[i], element );
+        }
+    }
+}
+
+
+void XMLChildIndex::Remove( XMLElement* element )
+{
+    const size_t id = static_cast<size_t>( element->_nameAtom._id );
+    TIXMLASSERT( id && id <= _names.Size() );
+    Ends& ends = _names[id - 1];
+    if ( element->_prevSameName ) {
+        element->_prevSameName->_nextSameName = element->_nextSameName;
+    }
+    else {
+        ends.first = element->_nextSameName;
+    }
+    if ( element->_nextSameName ) {
+        element->_nextSameName->_prevSameName = element->_prevSameName;
+    }
+    else {
+        ends.last = element->_prevSameName;
+    }
+    element->_prevSameName = element->_nextSameName = 0;
+
+    for( size_t i = _keys.Size(); i > 0; --i ) {
+        KeyMap* map = _keys[i - 1];
+        if ( map->name != element->_nameAtom ) {
+            continue;
+        }
+        if ( map->duplicates ) {
+            // Another child may take over the value; lookups scan until
+            // BuildChildIndex() is called again
+            DropKeyMap( i - 1 );
+        }
+        else {
+            Erase( map, element );
+        }
+    }
+}
+
+
+void XMLChildIndex::DropKeys( XMLAtom key )
+{
+    for( size_t i = _keys.Size(); i > 0; --i ) {
+        if ( _keys[i - 1]->key == key ) {
+            DropKeyMap( i - 1 );
+        }
+    }
+}
+
+
+void XMLChildIndex::DropKeyMap( size_t i )
+{
+    delete _keys[i];
+    _keys.SwapRemove( i );
+}
+
+
+XMLChildIndex::KeyMap* XMLChildIndex::Keys( XMLAtom name, XMLAtom key ) const
+{
+    for( size_t i = 0; i < _keys.Size(); ++i ) {
+        if ( _keys[i]->name == name && _keys[i]->key == key ) {
+            return _keys[i];
+        }
+    }
+    return 0;
+}
+
+
+void XMLChildIndex::AddKeys( XMLAtom name, XMLAtom key )
+{
+    if ( Keys( name, key ) ) {
+        return;
+    }
+    KeyMap* map = new KeyMap;
+    map->name = name;
+    map->key = key;
+    map->count = 0;
+    map->duplicates = false;
+    size_t n = 0;
+    for( XMLElement* e = First( name ); e; e = e->_nextSameName ) {
+        ++n;
+    }
+    size_t slots = 16;
+    while ( slots < 2 * n + 2 ) {
+        slots *= 2;
+    }
+    Resize( map, slots );
+    for( XMLElement* e = First( name ); e; e = e->_nextSameName ) {
+        Insert( map, e );
+    }
+    _keys.Push( map );
+}
+
+
+XMLElement* XMLChildIndex::Find( XMLAtom name, XMLAtom key, const char* value ) const
+{
+    const KeyMap* map = Keys( name, key );
+    if ( !map ) {
+        return 0;
+    }
+
+    const unsigned hash = Hash( value );
+    const size_t mask = map->slots.Size() - 1;
+    for( size_t i = hash & mask; map->slots[i].element; i = ( i + 1 ) & mask ) {
+        const Slot& slot = map->slots[i];
+        if ( slot.hash == hash && XMLUtil::StringEqual( slot.element->Attribute( key ), value ) ) {
+            return slot.element;
+        }
+    }
+    return 0;
+}
+
+
+// FNV-1a
+unsigned XMLChildIndex::Hash( const char* value )
+{
+    unsigned h = 2166136261u;
+    for( ; *value; ++value ) {
+        h = ( h ^ static_cast<unsigned char>(*value) ) * 16777619u;
+    }
+    return h;
+}
+
+
+// Later children with a value already there only mark the map: the
+// first in document order is the one found
+void XMLChildIndex::Insert( KeyMap* map, XMLElement* element )
+{
+    const char* value = element->Attribute( map->key );
+    if ( !value ) {
+        return;
+    }
+    if ( 2 * ( map->count + 1 ) > map->slots.Size() ) {
+        Resize( map, 2 * map->slots.Size() );
+    }
+    const unsigned hash = Hash( value );
+    const size_t mask = map->slots.Size() - 1;
+    size_t i = hash & mask;
+    for( ; map->slots[i].element; i = ( i + 1 ) & mask ) {
+        const Slot& slot = map->slots[i];
+        if ( slot.hash == hash && XMLUtil::StringEqual( slot.element->Attribute( map->key ), value ) ) {
+            map->duplicates = true;
+            return;
+        }
+    }
+    map->slots[i].hash = hash;
+    map->slots[i].element = element;
+    ++map->count;
+}
+
+
+// Backward-shift deletion: later entries of the probe run move up into
+// the hole unless their home slot lies after it
+void XMLChildIndex::Erase( KeyMap* map, XMLElement* element )
+{
+    const char* value = element->Attribute( map->key );
+    if ( !value ) {
+        return;
+    }
+    const size_t mask = map->slots.Size() - 1;
+    size_t hole = Hash( value ) & mask;
+    for( ; map->slots[hole].element != element; hole = ( hole + 1 ) & mask ) {
+        if ( !map->slots[hole].element ) {
+            return;
+        }
+    }
+    for( size_t j = ( hole + 1 ) & mask; map->slots[j].element; j = ( j + 1 ) & mask ) {
+        const size_t home = map->slots[j].hash & mask;
+        const bool stays = hole <= j ? ( hole < home && home <= j ) : ( hole < home || home <= j );
+        if ( !stays ) {
+            map->slots[hole] = map->slots[j];
+            hole = j;
+        }
+    }
+    map->slots[hole].element = 0;
+    --map->count;
+}
+
+
+void XMLChildIndex::Resize( KeyMap* map, size_t slots )
+{
+    const size_t oldSize = map->slots.Size();
+    Slot* old = oldSize ? new Slot[oldSize] : 0;
+    if ( oldSize ) {
+        memcpy( old, map->slots.Mem(), oldSize * sizeof( Slot ) );
+    }
+    map->slots.Clear();
+    memset( map->slots.PushArr( slots ), 0, slots * sizeof( Slot ) );
+
+    const size_t mask = slots - 1;
+    for( size_t j = 0; j < oldSize; ++j ) {
+        if ( old[j].element ) {
+            size_t i = old[j].hash & mask;
+            while ( map->slots[i].element ) {
+                i = ( i + 1 ) & mask;
+            }
+            map->slots[i] = old[j];
+        }
+    }
+    delete [] old;
 }
 
 
@@ -803,7 +1659,8 @@ XMLNode::XMLNode( XMLDocument* doc ) :
     _firstChild( 0 ), _lastChild( 0 ),
     _prev( 0 ), _next( 0 ),
 	_userData( 0 ),
-    _memPool( 0 )
+    _memPool( 0 ),
+    _childIndex( 0 )
 {
 }
 
@@ -854,6 +1711,12 @@ const char* XMLNode::Value() const
 
 void XMLNode::SetValue( const char* str, bool staticMem )
 {
+    XMLElement* element = ToElement();
+    if ( element ) {
+        // Element names live in the atom table
+        _document->InternName( element, str, strlen( str ) );
+        return;
+    }
     if ( staticMem ) {
         _value.SetInternedStr( str );
     }
@@ -877,6 +1740,7 @@ XMLNode* XMLNode::DeepClone(XMLDocument* target) const
 
 void XMLNode::DeleteChildren()
 {
+    DropChildIndex();
     while( _firstChild ) {
         TIXMLASSERT( _lastChild );
         DeleteChild( _firstChild );
@@ -885,11 +1749,21 @@ void XMLNode::DeleteChildren()
 }
 
 
+void XMLNode::DropChildIndex()
+{
+    delete _childIndex;
+    _childIndex = 0;
+}
+
+
 void XMLNode::Unlink( XMLNode* child )
 {
     TIXMLASSERT( child );
     TIXMLASSERT( child->_document == _document );
     TIXMLASSERT( child->_parent == this );
+    if ( _childIndex && child->ToElement() ) {
+        _childIndex->Remove( child->ToElement() );
+    }
     if ( child == _firstChild ) {
         _firstChild = _firstChild->_next;
     }
@@ -948,6 +1822,9 @@ XMLNode* XMLNode::InsertEndChild( XMLNode* addThis )
         addThis->_next = 0;
     }
     addThis->_parent = this;
+    if ( _childIndex && addThis->ToElement() ) {
+        _childIndex->Append( addThis->ToElement() );
+    }
     return addThis;
 }
 
@@ -960,6 +1837,9 @@ XMLNode* XMLNode::InsertFirstChild( XMLNode* addThis )
         return 0;
     }
     InsertChildPreamble( addThis );
+    if ( addThis->ToElement() ) {
+        DropChildIndex();       // only appends are indexed in place
+    }
 
     if ( _firstChild ) {
         TIXMLASSERT( _lastChild );
@@ -1010,6 +1890,9 @@ XMLNode* XMLNode::InsertAfterChild( XMLNode* afterThis, XMLNode* addThis )
         return InsertEndChild( addThis );
     }
     InsertChildPreamble( addThis );
+    if ( addThis->ToElement() ) {
+        DropChildIndex();
+    }
     addThis->_prev = afterThis;
     addThis->_next = afterThis->_next;
     afterThis->_next->_prev = addThis;
@@ -1023,8 +1906,11 @@ XMLNode* XMLNode::InsertAfterChild( XMLNode* afterThis, XMLNode* addThis )
 
 const XMLElement* XMLNode::FirstChildElement( const char* name ) const
 {
+    if ( name ) {
+        return FirstChildElement( _document->FindAtom( name ) );
+    }
     for( const XMLNode* node = _firstChild; node; node = node->_next ) {
-        const XMLElement* element = node->ToElementWithName( name );
+        const XMLElement* element = node->ToElement();
         if ( element ) {
             return element;
         }
@@ -1033,10 +1919,28 @@ const XMLElement* XMLNode::FirstChildElement( const char* name ) const
 }
 
 
+const XMLElement* XMLNode::FirstChildElement( XMLAtom name ) const
+{
+    if ( _childIndex ) {
+        return _childIndex->First( name );
+    }
+    for( const XMLNode* node = _firstChild; node; node = node->_next ) {
+        const XMLElement* element = node->ToElement();
+        if ( element && element->NameAtom() == name ) {
+            return element;
+        }
+    }
+    return 0;
+}
+
+
 const XMLElement* XMLNode::LastChildElement( const char* name ) const
 {
+    if ( name ) {
+        return LastChildElement( _document->FindAtom( name ) );
+    }
     for( const XMLNode* node = _lastChild; node; node = node->_prev ) {
-        const XMLElement* element = node->ToElementWithName( name );
+        const XMLElement* element = node->ToElement();
         if ( element ) {
             return element;
         }
@@ -1045,10 +1949,28 @@ const XMLElement* XMLNode::LastChildElement( const char* name ) const
 }
 
 
+const XMLElement* XMLNode::LastChildElement( XMLAtom name ) const
+{
+    if ( _childIndex ) {
+        return _childIndex->Last( name );
+    }
+    for( const XMLNode* node = _lastChild; node; node = node->_prev ) {
+        const XMLElement* element = node->ToElement();
+        if ( element && element->NameAtom() == name ) {
+            return element;
+        }
+    }
+    return 0;
+}
+
+
 const XMLElement* XMLNode::NextSiblingElement( const char* name ) const
 {
+    if ( name ) {
+        return NextSiblingElement( _document->FindAtom( name ) );
+    }
     for( const XMLNode* node = _next; node; node = node->_next ) {
-        const XMLElement* element = node->ToElementWithName( name );
+        const XMLElement* element = node->ToElement();
         if ( element ) {
             return element;
         }
@@ -1057,10 +1979,29 @@ const XMLElement* XMLNode::NextSiblingElement( const char* name ) const
 }
 
 
+const XMLElement* XMLNode::NextSiblingElement( XMLAtom name ) const
+{
+    const XMLElement* self = ToElement();
+    if ( self && _parent && _parent->_childIndex && self->NameAtom() == name ) {
+        return XMLChildIndex::Next( self );
+    }
+    for( const XMLNode* node = _next; node; node = node->_next ) {
+        const XMLElement* element = node->ToElement();
+        if ( element && element->NameAtom() == name ) {
+            return element;
+        }
+    }
+    return 0;
+}
+
+
 const XMLElement* XMLNode::PreviousSiblingElement( const char* name ) const
 {
+    if ( name ) {
+        return PreviousSiblingElement( _document->FindAtom( name ) );
+    }
     for( const XMLNode* node = _prev; node; node = node->_prev ) {
-        const XMLElement* element = node->ToElementWithName( name );
+        const XMLElement* element = node->ToElement();
         if ( element ) {
             return element;
         }
@@ -1069,6 +2010,63 @@ const XMLElement* XMLNode::PreviousSiblingElement( const char* name ) const
 }
 
 
+const XMLElement* XMLNode::PreviousSiblingElement( XMLAtom name ) const
+{
+    const XMLElement* self = ToElement();
+    if ( self && _parent && _parent->_childIndex && self->NameAtom() == name ) {
+        return XMLChildIndex::Previous( self );
+    }
+    for( const XMLNode* node = _prev; node; node = node->_prev ) {
+        const XMLElement* element = node->ToElement();
+        if ( element && element->NameAtom() == name ) {
+            return element;
+        }
+    }
+    return 0;
+}
+
+
+const XMLElement* XMLNode::FindChildElement( XMLAtom name, XMLAtom key, const char* value ) const
+{
+    if ( name.IsNull() || key.IsNull() || !value ) {
+        return 0;
+    }
+    if ( _childIndex && _childIndex->HasKeys( name, key ) ) {
+        return _childIndex->Find( name, key, value );
+    }
+    for( const XMLElement* e = FirstChildElement( name ); e; e = e->NextSiblingElement( name ) ) {
+        const char* attribute = e->Attribute( key );
+        if ( attribute && XMLUtil::StringEqual( attribute, value ) ) {
+            return e;
+        }
+    }
+    return 0;
+}
+
+
+const XMLElement* XMLNode::FindChildElement( const char* name, const char* key, const char* value ) const
+{
+    return FindChildElement( _document->FindAtom( name ), _document->FindAtom( key ), value );
+}
+
+
+void XMLNode::BuildChildIndex( XMLAtom name, XMLAtom key )
+{
+    if ( !_childIndex ) {
+        _childIndex = new XMLChildIndex( this );
+    }
+    if ( !name.IsNull() && !key.IsNull() ) {
+        _childIndex->AddKeys( name, key );
+    }
+}
+
+
+void XMLNode::BuildChildIndex( const char* name, const char* key )
+{
+    BuildChildIndex( _document->Atom( name ), _document->Atom( key ) );
+}
+
+
 char* XMLNode::ParseDeep( char* p, StrPair* parentEndTag, int* curLineNumPtr )
 {
     // This is a recursive method, but thinking about it "at the current level"
@@ -1214,20 +2212,6 @@ void XMLNode::InsertChildPreamble( XMLNode* insertThis ) const
 	}
 }
 
-const XMLElement* XMLNode::ToElementWithName( const char* name ) const
-{
-    const XMLElement* element = this->ToElement();
-    if ( element == 0 ) {
-        return 0;
-    }
-    if ( name == 0 ) {
-        return element;
-    }
-    if ( XMLUtil::StringEqual( element->Name(), name ) ) {
-       return element;
-    }
-    return 0;
-}
 
 // --------- XMLText ---------- //
 char* XMLText::ParseDeep( char* p, StrPair*, int* curLineNumPtr )
@@ -1467,12 +2451,6 @@ char* XMLAttribute::ParseDeep( char* p, bool processEntities, int* curLineNumPtr
 }
 
 
-void XMLAttribute::SetName( const char* n )
-{
-    _name.SetStr( n );
-}
-
-
 XMLError XMLAttribute::QueryIntValue( int* value ) const
 {
     if ( XMLUtil::ToInt( Value(), value )) {
@@ -1598,6 +2576,9 @@ void XMLAttribute::SetAttribute( float v )
 // --------- XMLElement ---------- //
 XMLElement::XMLElement( XMLDocument* doc ) : XMLNode( doc ),
     _closingType( OPEN ),
+    _nameAtom(),
+    _prevSameName( 0 ),
+    _nextSameName( 0 ),
     _rootAttribute( 0 )
 {
 }
@@ -1614,9 +2595,15 @@ XMLElement::~XMLElement()
 
 
 const XMLAttribute* XMLElement::FindAttribute( const char* name ) const
+{
+    return FindAttribute( _document->FindAtom( name ) );
+}
+
+
+const XMLAttribute* XMLElement::FindAttribute( XMLAtom name ) const
 {
     for( XMLAttribute* a = _rootAttribute; a; a = a->_next ) {
-        if ( XMLUtil::StringEqual( a->Name(), name ) ) {
+        if ( a->_nameAtom == name ) {
             return a;
         }
     }
@@ -1625,6 +2612,12 @@ const XMLAttribute* XMLElement::FindAttribute( const char* name ) const
 
 
 const char* XMLElement::Attribute( const char* name, const char* value ) const
+{
+    return Attribute( _document->FindAtom( name ), value );
+}
+
+
+const char* XMLElement::Attribute( XMLAtom name, const char* value ) const
 {
     const XMLAttribute* a = FindAttribute( name );
     if ( !a ) {
@@ -1911,12 +2904,16 @@ float XMLElement::FloatText(float defaultValue) const
 
 XMLAttribute* XMLElement::FindOrCreateAttribute( const char* name )
 {
+    const XMLAtom atom = _document->FindAtom( name );
+    if ( _parent && _parent->_childIndex ) {
+        _parent->_childIndex->DropKeys( atom );     // the caller sets the value
+    }
     XMLAttribute* last = 0;
     XMLAttribute* attrib = 0;
     for( attrib = _rootAttribute;
             attrib;
             last = attrib, attrib = attrib->_next ) {
-        if ( XMLUtil::StringEqual( attrib->Name(), name ) ) {
+        if ( attrib->_nameAtom == atom ) {
             break;
         }
     }
@@ -1931,7 +2928,7 @@ XMLAttribute* XMLElement::FindOrCreateAttribute( const char* name )
             TIXMLASSERT( _rootAttribute == 0 );
             _rootAttribute = attrib;
         }
-        attrib->SetName( name );
+        _document->InternName( attrib, name, strlen( name ) );
     }
     return attrib;
 }
@@ -1939,6 +2936,9 @@ XMLAttribute* XMLElement::FindOrCreateAttribute( const char* name )
 
 void XMLElement::DeleteAttribute( const char* name )
 {
+    if ( _parent && _parent->_childIndex ) {
+        _parent->_childIndex->DropKeys( _document->FindAtom( name ) );
+    }
     XMLAttribute* prev = 0;
     for( XMLAttribute* a=_rootAttribute; a; a=a->_next ) {
         if ( XMLUtil::StringEqual( name, a->Name() ) ) {
@@ -1977,7 +2977,10 @@ char* XMLElement::ParseAttributes( char* p, int* curLineNumPtr )
             const int attrLineNum = attrib->_parseLineNum;
 
             p = attrib->ParseDeep( p, _document->ProcessEntities(), curLineNumPtr );
-            if ( !p || Attribute( attrib->Name() ) ) {
+            if ( p ) {
+                _document->InternName( attrib, attrib->_name.Start(), attrib->_name.Length() );
+            }
+            if ( !p || FindAttribute( attrib->_nameAtom ) ) {
                 DeleteAttribute( attrib );
                 _document->SetError( XML_ERROR_PARSING_ATTRIBUTE, attrLineNum, "XMLElement name=%s", Name() );
                 return 0;
@@ -2089,6 +3092,9 @@ char* XMLElement::ParseDeep( char* p, StrPair* parentEndTag, int* curLineNumPtr
     if ( _value.Empty() ) {
         return 0;
     }
+    if ( _closingType != CLOSING ) {
+        _document->InternName( this, _value.Start(), _value.Length() );
+    }
 
     p = ParseAttributes( p, curLineNumPtr );
     if ( !p || !*p || _closingType != OPEN ) {
@@ -2176,7 +3182,8 @@ const char* XMLDocument::_errorNames[XML_ERROR_COUNT] = {
     "XML_ERROR_PARSING",
     "XML_CAN_NOT_CONVERT_TEXT",
     "XML_NO_TEXT_NODE",
-	"XML_ELEMENT_DEPTH_EXCEEDED"
+	"XML_ELEMENT_DEPTH_EXCEEDED",
+	"XML_ERROR_FILE_WRITE_ERROR"
 };
 
 
@@ -2184,14 +3191,18 @@ XMLDocument::XMLDocument( bool processEntities, Whitespace whitespaceMode ) :
     XMLNode( 0 ),
     _writeBOM( false ),
     _processEntities( processEntities ),
+    _frozen( false ),
     _errorID(XML_SUCCESS),
     _whitespaceMode( whitespaceMode ),
     _errorStr(),
     _errorLineNum( 0 ),
     _charBuffer( 0 ),
+    _charBufferSource( BUFFER_NEW ),
+    _mappedSize( 0 ),
     _parseCurLineNum( 0 ),
 	_parsingDepth(0),
     _unlinked(),
+    _atoms(),
     _elementPool(),
     _attributePool(),
     _textPool(),
@@ -2233,9 +3244,9 @@ void XMLDocument::Clear()
 #endif
     ClearError();
 
-    delete [] _charBuffer;
-    _charBuffer = 0;
+    ReleaseCharBuffer();
 	_parsingDepth = 0;
+    _frozen = false;
 
 #if 0
     _textPool.Trace( "text" );
@@ -2252,6 +3263,108 @@ void XMLDocument::Clear()
         TIXMLASSERT( _commentPool.CurrentAllocs()   == _commentPool.Untracked() );
     }
 #endif
+    RewindPools();
+}
+
+
+void XMLDocument::Freeze()
+{
+    // Every node: those in the tree, walked without recursion, and those
+    // created but not (or no longer) linked in, with their subtrees.
+    for( size_t i = 0; i <= _unlinked.Size(); ++i ) {
+        XMLNode* const top = ( i < _unlinked.Size() ) ? _unlinked[i] : this;
+        XMLNode* node = ( top == this ) ? _firstChild : top;
+        while ( node ) {
+            node->_value.GetStr();
+            const XMLElement* element = node->ToElement();
+            for( XMLAttribute* a = element ? element->_rootAttribute : 0; a; a = a->_next ) {
+                a->_name.GetStr();
+                a->_value.GetStr();
+            }
+            if ( node->_firstChild ) {
+                node = node->_firstChild;
+                continue;
+            }
+            while ( node != top && !node->_next ) {
+                node = node->_parent;
+            }
+            node = ( node == top ) ? 0 : node->_next;
+        }
+    }
+    // SetError() keeps a finished copy, so ErrorStr() already writes
+    // nothing; finished here anyway, like every other string.
+    if ( !_errorStr.Empty() ) {
+        _errorStr.GetStr();
+    }
+    _frozen = true;
+}
+
+
+XMLAtom XMLDocument::Atom( const char* name )
+{
+    TIXMLASSERT( name );
+    return _atoms.Intern( name, strlen( name ) );
+}
+
+
+XMLAtom XMLDocument::FindAtom( const char* name ) const
+{
+    TIXMLASSERT( name );
+    return _atoms.Find( name );
+}
+
+
+void XMLDocument::InternName( XMLElement* element, const char* name, size_t length )
+{
+    if ( element->_parent ) {
+        element->_parent->DropChildIndex();     // renamed
+    }
+    element->_nameAtom = _atoms.Intern( name, length );
+    element->_value.SetInternedStr( _atoms.Str( element->_nameAtom ) );
+}
+
+
+void XMLDocument::InternName( XMLAttribute* attribute, const char* name, size_t length )
+{
+    attribute->_nameAtom = _atoms.Intern( name, length );
+    attribute->_name.SetInternedStr( _atoms.Str( attribute->_nameAtom ) );
+}
+
+
+void XMLDocument::RewindPools()
+{
+    _elementPool.Rewind();
+    _attributePool.Rewind();
+    _textPool.Rewind();
+    _commentPool.Rewind();
+}
+
+
+// Node density of the repository's own data files: an element every
+// 55-65 bytes, an attribute or a text node every 55-170; rounded up
+void XMLDocument::Reserve( size_t xmlBytes )
+{
+    _elementPool.Reserve( xmlBytes / 48 + 1 );
+    _attributePool.Reserve( xmlBytes / 96 + 1 );
+    _textPool.Reserve( xmlBytes / 96 + 1 );
+}
+
+
+void XMLDocument::GetPoolStats( XMLPoolStats* elements, XMLPoolStats* attributes,
+                                XMLPoolStats* text, XMLPoolStats* comments ) const
+{
+    if ( elements ) {
+        *elements = _elementPool.Stats();
+    }
+    if ( attributes ) {
+        *attributes = _attributePool.Stats();
+    }
+    if ( text ) {
+        *text = _textPool.Stats();
+    }
+    if ( comments ) {
+        *comments = _commentPool.Stats();
+    }
 }
 
 
@@ -2360,6 +3473,158 @@ XMLError XMLDocument::LoadFile( const char* filename )
     return _errorID;
 }
 
+// The char buffer is ours to delete, ours to unmap, or the caller's
+void XMLDocument::ReleaseCharBuffer()
+{
+    switch ( _charBufferSource ) {
+        case BUFFER_NEW:
+            delete [] _charBuffer;
+            break;
+        case BUFFER_MAPPED:
+#if defined(TIXML_MMAP_POSIX)
+            munmap( _charBuffer, _mappedSize );
+#elif defined(TIXML_MMAP_WIN32)
+            UnmapViewOfFile( _charBuffer );
+#endif
+            break;
+        case BUFFER_CALLER:
+            break;
+    }
+    _charBuffer = 0;
+    _charBufferSource = BUFFER_NEW;
+    _mappedSize = 0;
+}
+
+
+// Parse the 'length' bytes of _charBuffer, which are followed by a null.
+// Parse errors leave the pools holding dead nodes that point into the
+// buffer; drop them, keeping the memory for the next parse
+void XMLDocument::ParseCharBuffer( size_t length )
+{
+    TIXMLASSERT( _charBuffer[length] == 0 );
+    const ScanLimit limit( _charBuffer + length );
+    Parse();
+    if ( Error() ) {
+        DeleteChildren();
+        RewindPools();
+    }
+}
+
+
+XMLError XMLDocument::LoadFileMapped( const char* filename )
+{
+    if ( !filename ) {
+        TIXMLASSERT( false );
+        SetError( XML_ERROR_FILE_COULD_NOT_BE_OPENED, 0, "filename=<null>" );
+        return _errorID;
+    }
+
+    Clear();
+#if defined(TIXML_MMAP_POSIX)
+    const int fd = open( filename, O_RDONLY );
+    if ( fd < 0 ) {
+        SetError( XML_ERROR_FILE_NOT_FOUND, 0, "filename=%s", filename );
+        return _errorID;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || st.st_size < 0
+         || static_cast<unsigned long long>(st.st_size) >= static_cast<unsigned long long>(static_cast<size_t>(-1) / 2) ) {
+        close( fd );
+        SetError( XML_ERROR_FILE_READ_ERROR, 0, 0 );
+        return _errorID;
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+    if ( size == 0 ) {
+        close( fd );
+        SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+        return _errorID;
+    }
+
+    // The parser needs a null after the last byte. The rest of the file's
+    // last page reads as zeros; when the file ends on a page boundary the
+    // anonymous page reserved behind it supplies the null.
+    const size_t page = static_cast<size_t>( sysconf( _SC_PAGESIZE ) );
+    const size_t span = ( size / page + 1 ) * page;
+    void* base = mmap( 0, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if ( base != MAP_FAILED
+         && mmap( base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0 ) == MAP_FAILED ) {
+        munmap( base, span );
+        base = MAP_FAILED;
+    }
+    close( fd );
+    if ( base == MAP_FAILED ) {
+        return LoadFile( filename );
+    }
+    _charBuffer = static_cast<char*>( base );
+    _charBufferSource = BUFFER_MAPPED;
+    _mappedSize = span;
+#elif defined(TIXML_MMAP_WIN32)
+    HANDLE file = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, 0,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+    if ( file == INVALID_HANDLE_VALUE ) {
+        SetError( XML_ERROR_FILE_NOT_FOUND, 0, "filename=%s", filename );
+        return _errorID;
+    }
+    LARGE_INTEGER length;
+    if ( !GetFileSizeEx( file, &length ) || length.QuadPart < 0
+         || static_cast<unsigned long long>(length.QuadPart) >= static_cast<unsigned long long>(static_cast<size_t>(-1) / 2) ) {
+        CloseHandle( file );
+        SetError( XML_ERROR_FILE_READ_ERROR, 0, 0 );
+        return _errorID;
+    }
+    const size_t size = static_cast<size_t>( length.QuadPart );
+    if ( size == 0 ) {
+        CloseHandle( file );
+        SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+        return _errorID;
+    }
+
+    // A view cannot reach past the end of a read-only file, so the null
+    // after the last byte must come from the zeros that fill the last
+    // page. A file that ends on a page boundary is read instead.
+    SYSTEM_INFO info;
+    GetSystemInfo( &info );
+    void* view = 0;
+    if ( size % info.dwPageSize != 0 ) {
+        HANDLE mapping = CreateFileMappingA( file, 0, PAGE_WRITECOPY, 0, 0, 0 );
+        if ( mapping ) {
+            view = MapViewOfFile( mapping, FILE_MAP_COPY, 0, 0, 0 );
+            CloseHandle( mapping );
+        }
+    }
+    CloseHandle( file );
+    if ( !view ) {
+        return LoadFile( filename );
+    }
+    _charBuffer = static_cast<char*>( view );
+    _charBufferSource = BUFFER_MAPPED;
+    _mappedSize = size;
+#else
+    return LoadFile( filename );
+#endif
+
+    ParseCharBuffer( size );
+    return _errorID;
+}
+
+
+XMLError XMLDocument::ParseInPlace( char* buffer, size_t nBytes )
+{
+    Clear();
+
+    if ( nBytes == 0 || !buffer || !*buffer ) {
+        SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+        return _errorID;
+    }
+    TIXMLASSERT( buffer[nBytes] == 0 );
+    _charBuffer = buffer;
+    _charBufferSource = BUFFER_CALLER;
+
+    ParseCharBuffer( nBytes );
+    return _errorID;
+}
+
+
 XMLError XMLDocument::LoadFile( FILE* fp )
 {
     Clear();
@@ -2409,7 +3674,7 @@ XMLError XMLDocument::LoadFile( FILE* fp )
 
     _charBuffer[size] = 0;
 
-    Parse();
+    ParseCharBuffer( size );
     return _errorID;
 }
 
@@ -2427,8 +3692,13 @@ XMLError XMLDocument::SaveFile( const char* filename, bool compact )
         SetError( XML_ERROR_FILE_COULD_NOT_BE_OPENED, 0, "filename=%s", filename );
         return _errorID;
     }
+    // The printer hands over whole blocks; copying them through stdio's
+    // own buffer would only split each into more writes.
+    setvbuf( fp, 0, _IONBF, 0 );
     SaveFile(fp, compact);
-    fclose( fp );
+    if ( fclose( fp ) != 0 && !Error() ) {
+        SetError( XML_ERROR_FILE_WRITE_ERROR, 0, "filename=%s", filename );
+    }
     return _errorID;
 }
 
@@ -2440,6 +3710,10 @@ XMLError XMLDocument::SaveFile( FILE* fp, bool compact )
     ClearError();
     XMLPrinter stream( fp, compact );
     Print( &stream );
+    stream.Flush();
+    if ( stream.WriteError() ) {
+        SetError( XML_ERROR_FILE_WRITE_ERROR, 0, 0 );
+    }
     return _errorID;
 }
 
@@ -2460,17 +3734,7 @@ XMLError XMLDocument::Parse( const char* xml, size_t nBytes )
     memcpy( _charBuffer, xml, nBytes );
     _charBuffer[nBytes] = 0;
 
-    Parse();
-    if ( Error() ) {
-        // clean up now essentially dangling memory.
-        // and the parse fail can put objects in the
-        // pools that are dead and inaccessible.
-        DeleteChildren();
-        _elementPool.Clear();
-        _attributePool.Clear();
-        _textPool.Clear();
-        _commentPool.Clear();
-    }
+    ParseCharBuffer( nBytes );
     return _errorID;
 }
 
@@ -2582,6 +3846,7 @@ XMLPrinter::XMLPrinter( FILE* file, bool compact, int depth, EscapeAposCharsInAt
     _stack(),
     _firstElement( true ),
     _fp( file ),
+    _writeError( false ),
     _depth( depth ),
     _textDepth( -1 ),
     _processEntities( true ),
@@ -2612,45 +3877,68 @@ void XMLPrinter::Print( const char* format, ... )
     va_list     va;
     va_start( va, format );
 
-    if ( _fp ) {
-        vfprintf( _fp, format, va );
-    }
-    else {
-        const int len = TIXML_VSCPRINTF( format, va );
-        // Close out and re-start the va-args
-        va_end( va );
-        TIXMLASSERT( len >= 0 );
-        va_start( va, format );
-        TIXMLASSERT( _buffer.Size() > 0 && _buffer[_buffer.Size() - 1] == 0 );
-        char* p = _buffer.PushArr( len ) - 1;	// back up over the null terminator.
-		TIXML_VSNPRINTF( p, len+1, format, va );
-    }
+    const int len = TIXML_VSCPRINTF( format, va );
+    // Close out and re-start the va-args
     va_end( va );
+    TIXMLASSERT( len >= 0 );
+    va_start( va, format );
+    TIXMLASSERT( _buffer.Size() > 0 && _buffer[_buffer.Size() - 1] == 0 );
+    char* p = _buffer.PushArr( len ) - 1;	// back up over the null terminator.
+	TIXML_VSNPRINTF( p, len+1, format, va );
+    va_end( va );
+    FlushIfFull();
 }
 
 
+/*
+	Output to a FILE goes through _buffer as well, and is written out a
+	block at a time rather than with a stdio call per fragment: when the
+	buffer passes FLUSH_SIZE, when the outermost element or a top level
+	node is finished, and on Flush().
+*/
 void XMLPrinter::Write( const char* data, size_t size )
 {
-    if ( _fp ) {
-        fwrite ( data , sizeof(char), size, _fp);
-    }
-    else {
-        char* p = _buffer.PushArr( static_cast<int>(size) ) - 1;   // back up over the null terminator.
-        memcpy( p, data, size );
-        p[size] = 0;
-    }
+    char* p = _buffer.PushArr( static_cast<int>(size) ) - 1;   // back up over the null terminator.
+    memcpy( p, data, size );
+    p[size] = 0;
+    FlushIfFull();
 }
 
 
 void XMLPrinter::Putc( char ch )
 {
-    if ( _fp ) {
-        fputc ( ch, _fp);
+    char* p = _buffer.PushArr( sizeof(char) ) - 1;   // back up over the null terminator.
+    p[0] = ch;
+    p[1] = 0;
+    FlushIfFull();
+}
+
+
+void XMLPrinter::Flush()
+{
+    if ( _fp && _buffer.Size() > 1 ) {
+        const size_t size = _buffer.Size() - 1;
+        if ( !_writeError && fwrite( _buffer.Mem(), sizeof(char), size, _fp ) != size ) {
+            _writeError = true;
+        }
+        _buffer.Clear();
+        _buffer.Push( 0 );
+    }
+}
+
+
+void XMLPrinter::FlushIfFull()
+{
+    if ( _fp && _buffer.Size() > FLUSH_SIZE ) {
+        Flush();
     }
-    else {
-        char* p = _buffer.PushArr( sizeof(char) ) - 1;   // back up over the null terminator.
-        p[0] = ch;
-        p[1] = 0;
+}
+
+
+void XMLPrinter::FlushIfDone()
+{
+    if ( _stack.Empty() ) {
+        Flush();
     }
 }
 
@@ -2670,36 +3958,37 @@ void XMLPrinter::PrintString( const char* p, bool restricted )
 
     if ( _processEntities ) {
         const bool* flag = restricted ? _restrictedEntityFlag : _entityFlag;
-        while ( *q ) {
+        const char* const end = p + strlen( p );
+        // Only & < > " ' can have an entity, so skip to the next of those
+        // a block at a time, and print what was skipped in one run.
+        while ( *( q = Scan().findEscape( q, end ) ) ) {
             TIXMLASSERT( p <= q );
-            // Remember, char is sometimes signed. (How many times has that bitten me?)
-            if ( *q > 0 && *q < ENTITY_RANGE ) {
-                // Check for entities. If one is found, flush
-                // the stream up until the entity, write the
-                // entity, and keep looking.
-                if ( flag[static_cast<unsigned char>(*q)] ) {
-                    while ( p < q ) {
-                        const size_t delta = q - p;
-                        const int toPrint = ( INT_MAX < delta ) ? INT_MAX : static_cast<int>(delta);
-                        Write( p, toPrint );
-                        p += toPrint;
-                    }
-                    bool entityPatternPrinted = false;
-                    for( int i=0; i<NUM_ENTITIES; ++i ) {
-                        if ( entities[i].value == *q ) {
-                            Putc( '&' );
-                            Write( entities[i].pattern, entities[i].length );
-                            Putc( ';' );
-                            entityPatternPrinted = true;
-                            break;
-                        }
-                    }
-                    if ( !entityPatternPrinted ) {
-                        // TIXMLASSERT( entityPatternPrinted ) causes gcc -Wunused-but-set-variable in release
-                        TIXMLASSERT( false );
+            TIXMLASSERT( *q > 0 && *q < ENTITY_RANGE );
+            // Check for entities. If one is found, flush
+            // the stream up until the entity, write the
+            // entity, and keep looking.
+            if ( flag[static_cast<unsigned char>(*q)] ) {
+                while ( p < q ) {
+                    const size_t delta = q - p;
+                    const int toPrint = ( INT_MAX < delta ) ? INT_MAX : static_cast<int>(delta);
+                    Write( p, toPrint );
+                    p += toPrint;
+                }
+                bool entityPatternPrinted = false;
+                for( int i=0; i<NUM_ENTITIES; ++i ) {
+                    if ( entities[i].value == *q ) {
+                        Putc( '&' );
+                        Write( entities[i].pattern, entities[i].length );
+                        Putc( ';' );
+                        entityPatternPrinted = true;
+                        break;
                     }
-                    ++p;
                 }
+                if ( !entityPatternPrinted ) {
+                    // TIXMLASSERT( entityPatternPrinted ) causes gcc -Wunused-but-set-variable in release
+                    TIXMLASSERT( false );
+                }
+                ++p;
             }
             ++q;
             TIXMLASSERT( p <= q );
@@ -2727,6 +4016,7 @@ void XMLPrinter::PushHeader( bool writeBOM, bool writeDec )
     if ( writeDec ) {
         PushDeclaration( "xml version=\"1.0\"" );
     }
+    FlushIfDone();
 }
 
 void XMLPrinter::PrepareForNewNode( bool compactMode )
@@ -2844,6 +4134,7 @@ void XMLPrinter::CloseElement( bool compactMode )
         Putc( '\n' );
     }
     _elementJustOpened = false;
+    FlushIfDone();
 }
 
 
@@ -2936,6 +4227,7 @@ void XMLPrinter::PushComment( const char* comment )
     Write( "<!--" );
     Write( comment );
     Write( "-->" );
+    FlushIfDone();
 }
 
 
@@ -2946,6 +4238,7 @@ void XMLPrinter::PushDeclaration( const char* value )
     Write( "<?" );
     Write( value );
     Write( "?>" );
+    FlushIfDone();
 }
 
 
@@ -2956,6 +4249,7 @@ void XMLPrinter::PushUnknown( const char* value )
     Write( "<!" );
     Write( value );
     Putc( '>' );
+    FlushIfDone();
 }
 
 
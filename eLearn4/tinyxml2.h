@@ -116,6 +116,7 @@ namespace tinyxml2
 class XMLDocument;
 class XMLElement;
 class XMLAttribute;
+class XMLChildIndex;
 class XMLComment;
 class XMLText;
 class XMLDeclaration;
@@ -167,10 +168,19 @@ public:
     void SetInternedStr( const char* str ) {
         Reset();
         _start = const_cast<char*>(str);
+        _end = _start + strlen( str );
     }
 
     void SetStr( const char* str, int flags=0 );
 
+    // The span as parsed, before GetStr() has terminated or translated it
+    const char* Start() const {
+        return _start;
+    }
+    size_t Length() const {
+        return static_cast<size_t>( _end - _start );
+    }
+
     char* ParseText( char* in, const char* endTag, int strFlags, int* curLineNumPtr );
     char* ParseName( char* in );
 
@@ -335,31 +345,72 @@ public:
 };
 
 
+/**
+	Memory use of one of a document's node pools.
+	@sa XMLDocument::GetPoolStats()
+*/
+struct XMLPoolStats
+{
+    size_t itemSize;	///< bytes per node
+    size_t capacity;	///< nodes the pool holds without allocating again
+    size_t inUse;		///< live nodes
+    size_t peak;		///< most nodes live at once
+    size_t allocs;		///< nodes handed out over the pool's lifetime
+    size_t slabs;		///< allocations backing the pool
+};
+
+
 /*
 	Template child class to create pools of the correct type.
+
+	Memory comes in slabs of whole blocks: the first slab is one block, each
+	later one doubles up to MAX_SLAB_BLOCKS, and Reserve() adds a slab sized
+	to fit. Nothing is returned until Clear(); Rewind() makes every item free
+	again so a document can be parsed into the same memory over and over.
 */
 template< size_t ITEM_SIZE >
 class MemPoolT : public MemPool
 {
 public:
-    MemPoolT() : _blockPtrs(), _root(0), _currentAllocs(0), _nAllocs(0), _maxAllocs(0), _nUntracked(0)	{}
+    MemPoolT() : _slabs(), _root(0), _capacity(0), _currentAllocs(0), _nAllocs(0), _maxAllocs(0), _nUntracked(0)	{}
     ~MemPoolT() {
         MemPoolT< ITEM_SIZE >::Clear();
     }
 
     void Clear() {
-        // Delete the blocks.
-        while( !_blockPtrs.Empty()) {
-            Block* lastBlock = _blockPtrs.Pop();
-            delete lastBlock;
+        // Delete the slabs.
+        while( !_slabs.Empty()) {
+            Slab lastSlab = _slabs.Pop();
+            delete [] lastSlab.blocks;
         }
         _root = 0;
+        _capacity = 0;
         _currentAllocs = 0;
         _nAllocs = 0;
         _maxAllocs = 0;
         _nUntracked = 0;
     }
 
+    // Every item becomes free; whatever was in them is dropped without being
+    // destroyed. The free list is rebuilt in address order, so the next
+    // parse fills the slabs front to back.
+    void Rewind() {
+        _root = 0;
+        for( size_t i = _slabs.Size(); i > 0; --i ) {
+            Link( _slabs[i - 1] );
+        }
+        _currentAllocs = 0;
+        _nUntracked = 0;
+    }
+
+    // Make room for at least 'items' live items, in one slab
+    void Reserve( size_t items ) {
+        if ( items > _capacity - _currentAllocs ) {
+            const size_t missing = items - ( _capacity - _currentAllocs );
+            AddSlab( ( missing + ITEMS_PER_BLOCK - 1 ) / ITEMS_PER_BLOCK );
+        }
+    }
+
     virtual size_t ItemSize() const override {
         return ITEM_SIZE;
     }
@@ -367,18 +418,22 @@ public:
         return _currentAllocs;
     }
 
+    XMLPoolStats Stats() const {
+        XMLPoolStats stats;
+        stats.itemSize = ITEM_SIZE;
+        stats.capacity = _capacity;
+        stats.inUse = _currentAllocs;
+        stats.peak = _maxAllocs;
+        stats.allocs = _nAllocs;
+        stats.slabs = _slabs.Size();
+        return stats;
+    }
+
     virtual void* Alloc() override{
         if ( !_root ) {
-            // Need a new block.
-            Block* block = new Block;
-            _blockPtrs.Push( block );
-
-            Item* blockItems = block->items;
-            for( size_t i = 0; i < ITEMS_PER_BLOCK - 1; ++i ) {
-                blockItems[i].next = &(blockItems[i + 1]);
-            }
-            blockItems[ITEMS_PER_BLOCK - 1].next = 0;
-            _root = blockItems;
+            // Need a new slab.
+            const size_t last = _slabs.Empty() ? 0 : _slabs.PeekTop().count;
+            AddSlab( last ? ( last < MAX_SLAB_BLOCKS ? last * 2 : last ) : 1 );
         }
         Item* const result = _root;
         TIXMLASSERT( result != 0 );
@@ -406,9 +461,9 @@ public:
         _root = item;
     }
     void Trace( const char* name ) {
-        printf( "Mempool %s watermark=%d [%dk] current=%d size=%d nAlloc=%d blocks=%d\n",
+        printf( "Mempool %s watermark=%d [%dk] current=%d size=%d nAlloc=%d slabs=%d capacity=%d\n",
                 name, _maxAllocs, _maxAllocs * ITEM_SIZE / 1024, _currentAllocs,
-                ITEM_SIZE, _nAllocs, _blockPtrs.Size() );
+                ITEM_SIZE, _nAllocs, _slabs.Size(), _capacity );
     }
 
     void SetTracked() override {
@@ -431,6 +486,8 @@ public:
     // Declared public because some compilers do not accept to use ITEMS_PER_BLOCK
     // in private part if ITEMS_PER_BLOCK is private
     enum { ITEMS_PER_BLOCK = (4 * 1024) / ITEM_SIZE };
+    // Growth stops doubling at 256k slabs
+    enum { MAX_SLAB_BLOCKS = 64 };
 
 private:
     MemPoolT( const MemPoolT& ); // not supported
@@ -443,9 +500,36 @@ private:
     struct Block {
         Item items[ITEMS_PER_BLOCK];
     };
-    DynArray< Block*, 10 > _blockPtrs;
+    struct Slab {
+        Block*  blocks;
+        size_t  count;
+    };
+
+    void AddSlab( size_t count ) {
+        Slab slab;
+        slab.blocks = new Block[count];
+        slab.count = count;
+        _slabs.Push( slab );
+        _capacity += count * ITEMS_PER_BLOCK;
+        Link( slab );
+    }
+
+    // Push the slab's items onto the free list, first item on top
+    void Link( const Slab& slab ) {
+        for( size_t b = slab.count; b > 0; --b ) {
+            Item* const blockItems = slab.blocks[b - 1].items;
+            for( size_t i = 0; i < ITEMS_PER_BLOCK - 1; ++i ) {
+                blockItems[i].next = &(blockItems[i + 1]);
+            }
+            blockItems[ITEMS_PER_BLOCK - 1].next = _root;
+            _root = blockItems;
+        }
+    }
+
+    DynArray< Slab, 10 > _slabs;
     Item* _root;
 
+    size_t _capacity;
     size_t _currentAllocs;
     size_t _nAllocs;
     size_t _maxAllocs;
@@ -454,6 +538,82 @@ private:
 
 
 
+/**
+	An interned element or attribute name. Every distinct name in a
+	document is stored once, in its atom table, and elements and attributes
+	carry the atom of their name, so matching a name is an integer compare.
+	Get one from XMLDocument::Atom(), XMLElement::NameAtom() or
+	XMLAttribute::NameAtom(). Atoms belong to one document; the null atom
+	(default constructed) matches nothing.
+*/
+class TINYXML2_LIB XMLAtom
+{
+    friend class XMLAtomTable;
+    friend class XMLChildIndex;
+public:
+    XMLAtom() : _id( 0 ) {}
+
+    bool IsNull() const {
+        return _id == 0;
+    }
+    bool operator==( const XMLAtom& other ) const {
+        return _id == other._id;
+    }
+    bool operator!=( const XMLAtom& other ) const {
+        return _id != other._id;
+    }
+
+private:
+    explicit XMLAtom( int id ) : _id( id ) {}
+
+    int _id;
+};
+
+
+/*
+	The names of one document. Atom n is _names[n-1]; the strings live in
+	chunks that are never moved, so names can point at them. Lookup is open
+	addressing over _slots, kept at most half full.
+*/
+class TINYXML2_LIB XMLAtomTable
+{
+public:
+    XMLAtomTable();
+    ~XMLAtomTable();
+
+    XMLAtom Intern( const char* name, size_t length );
+    XMLAtom Find( const char* name ) const;
+    const char* Str( XMLAtom atom ) const {
+        TIXMLASSERT( !atom.IsNull() && static_cast<size_t>(atom._id) <= _names.Size() );
+        return _names[atom._id - 1].str;
+    }
+    size_t Size() const {
+        return _names.Size();
+    }
+
+private:
+    XMLAtomTable( const XMLAtomTable& );	// not supported
+    void operator=( const XMLAtomTable& );	// not supported
+
+    struct Name {
+        const char*	str;
+        size_t		length;
+        unsigned	hash;
+    };
+    enum { CHUNK_SIZE = 4 * 1024 };
+
+    static unsigned Hash( const char* name, size_t length );
+    size_t Slot( const char* name, size_t length, unsigned hash ) const;
+    void Rehash( size_t slots );
+    const char* Store( const char* name, size_t length );
+
+    DynArray< Name, 32 >	_names;
+    DynArray< int, 64 >		_slots;		// atom ids; 0 is free
+    DynArray< char*, 4 >	_chunks;
+    size_t					_chunkUsed;
+};
+
+
 /**
 	Implements the interface to the "Visitor pattern" (see the Accept() method.)
 	If you call the Accept() method, it requires being passed a XMLVisitor
@@ -535,6 +695,7 @@ enum XMLError {
     XML_CAN_NOT_CONVERT_TEXT,
     XML_NO_TEXT_NODE,
 	XML_ELEMENT_DEPTH_EXCEEDED,
+	XML_ERROR_FILE_WRITE_ERROR,
 
 	XML_ERROR_COUNT
 };
@@ -549,14 +710,18 @@ public:
     static const char* SkipWhiteSpace( const char* p, int* curLineNumPtr )	{
         TIXMLASSERT( p );
 
-        while( IsWhiteSpace(*p) ) {
+        // None or a single separator inline; longer runs (indentation) go
+        // to the vectorized scanner in tinyxml2.cpp
+        if ( !IsWhiteSpace(*p) ) {
+            return p;
+        }
+        if ( !IsWhiteSpace(*(p+1)) ) {
             if (curLineNumPtr && *p == '\n') {
                 ++(*curLineNumPtr);
             }
-            ++p;
+            return p + 1;
         }
-        TIXMLASSERT( p );
-        return p;
+        return SkipWhiteSpaceRun( p, curLineNumPtr );
     }
     static char* SkipWhiteSpace( char* const p, int* curLineNumPtr ) {
         return const_cast<char*>( SkipWhiteSpace( const_cast<const char*>(p), curLineNumPtr ) );
@@ -636,6 +801,9 @@ public:
 	static void SetBoolSerialization(const char* writeTrue, const char* writeFalse);
 
 private:
+	// Skips a run of whitespace with the fastest scanner the CPU supports
+	static const char* SkipWhiteSpaceRun( const char* p, int* curLineNumPtr );
+
 	static const char* writeBoolTrue;
 	static const char* writeBoolFalse;
 };
@@ -670,6 +838,7 @@ class TINYXML2_LIB XMLNode
 {
     friend class XMLDocument;
     friend class XMLElement;
+    friend class XMLChildIndex;
 public:
 
     /// Get the XMLDocument that owns this XMLNode.
@@ -784,6 +953,13 @@ public:
         return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->FirstChildElement( name ));
     }
 
+    /// FirstChildElement() by atom; see XMLDocument::Atom()
+    const XMLElement* FirstChildElement( XMLAtom name ) const;
+
+    XMLElement* FirstChildElement( XMLAtom name ) {
+        return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->FirstChildElement( name ) );
+    }
+
     /// Get the last child node, or null if none exists.
     const XMLNode*	LastChild() const						{
         return _lastChild;
@@ -802,6 +978,13 @@ public:
         return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->LastChildElement(name) );
     }
 
+    /// LastChildElement() by atom
+    const XMLElement* LastChildElement( XMLAtom name ) const;
+
+    XMLElement* LastChildElement( XMLAtom name ) {
+        return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->LastChildElement( name ) );
+    }
+
     /// Get the previous (left) sibling node of this node.
     const XMLNode*	PreviousSibling() const					{
         return _prev;
@@ -818,6 +1001,13 @@ public:
         return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->PreviousSiblingElement( name ) );
     }
 
+    /// PreviousSiblingElement() by atom
+    const XMLElement* PreviousSiblingElement( XMLAtom name ) const;
+
+    XMLElement* PreviousSiblingElement( XMLAtom name ) {
+        return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->PreviousSiblingElement( name ) );
+    }
+
     /// Get the next (right) sibling node of this node.
     const XMLNode*	NextSibling() const						{
         return _next;
@@ -834,6 +1024,56 @@ public:
         return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->NextSiblingElement( name ) );
     }
 
+    /// NextSiblingElement() by atom
+    const XMLElement* NextSiblingElement( XMLAtom name ) const;
+
+    XMLElement* NextSiblingElement( XMLAtom name ) {
+        return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->NextSiblingElement( name ) );
+    }
+
+    /**
+    	The child element called 'name' whose attribute 'key' is 'value',
+    	or null. With several, the first. For example the student with
+    	id "S0042" in a roster:
+
+    	@verbatim
+    	students->FindChildElement( doc.Atom( "Student" ), doc.Atom( "id" ), "S0042" );
+    	@endverbatim
+
+    	Looks through the children, or is O(1) once BuildChildIndex()
+    	has indexed them for that name and key. Never changes the
+    	document.
+    */
+    const XMLElement* FindChildElement( XMLAtom name, XMLAtom key, const char* value ) const;
+
+    XMLElement* FindChildElement( XMLAtom name, XMLAtom key, const char* value ) {
+        return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->FindChildElement( name, key, value ) );
+    }
+
+    /// FindChildElement() by name
+    const XMLElement* FindChildElement( const char* name, const char* key, const char* value ) const;
+
+    XMLElement* FindChildElement( const char* name, const char* key, const char* value ) {
+        return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->FindChildElement( name, key, value ) );
+    }
+
+    /**
+    	Index this node's children: by name, and by the attribute 'key'
+    	for the children called 'name'. FindChildElement() for that name
+    	and key is then O(1), and so are First/LastChildElement() and,
+    	on the children, Next/PreviousSiblingElement() by the child's
+    	own name. Call it again for each further name and key.
+
+    	InsertEndChild() and DeleteChild() keep the index up to date;
+    	other changes to the children drop it, or the key table they
+    	touch, and lookups look through the children until this is
+    	called again. The const lookups only read the index, so it is
+    	built here and nowhere else.
+    */
+    void BuildChildIndex( XMLAtom name, XMLAtom key );
+    /// BuildChildIndex() by name
+    void BuildChildIndex( const char* name, const char* key );
+
     /**
     	Add a child node as the last (right) child.
 		If the child node is already part of the document,
@@ -967,10 +1207,12 @@ protected:
 
 private:
     MemPool*		_memPool;
+    XMLChildIndex*	_childIndex;	// see BuildChildIndex(); usually null
+
+    void DropChildIndex();
     void Unlink( XMLNode* child );
     static void DeleteNode( XMLNode* node );
     void InsertChildPreamble( XMLNode* insertThis ) const;
-    const XMLElement* ToElementWithName( const char* name ) const;
 
     XMLNode( const XMLNode& );	// not supported
     XMLNode& operator=( const XMLNode& );	// not supported
@@ -1141,10 +1383,16 @@ private:
 class TINYXML2_LIB XMLAttribute
 {
     friend class XMLElement;
+    friend class XMLDocument;
 public:
     /// The name of the attribute.
     const char* Name() const;
 
+    /// The interned name; see XMLDocument::Atom().
+    XMLAtom NameAtom() const {
+        return _nameAtom;
+    }
+
     /// The value of the attribute.
     const char* Value() const;
 
@@ -1241,16 +1489,16 @@ public:
 private:
     enum { BUF_SIZE = 200 };
 
-    XMLAttribute() : _name(), _value(),_parseLineNum( 0 ), _next( 0 ), _memPool( 0 ) {}
+    XMLAttribute() : _name(), _nameAtom(), _value(),_parseLineNum( 0 ), _next( 0 ), _memPool( 0 ) {}
     virtual ~XMLAttribute()	{}
 
     XMLAttribute( const XMLAttribute& );	// not supported
     void operator=( const XMLAttribute& );	// not supported
-    void SetName( const char* name );
 
     char* ParseDeep( char* p, bool processEntities, int* curLineNumPtr );
 
-    mutable StrPair _name;
+    mutable StrPair _name;		// points at the document's atom table
+    XMLAtom         _nameAtom;
     mutable StrPair _value;
     int             _parseLineNum;
     XMLAttribute*   _next;
@@ -1265,6 +1513,7 @@ private:
 class TINYXML2_LIB XMLElement : public XMLNode
 {
     friend class XMLDocument;
+    friend class XMLChildIndex;
 public:
     /// Get the name of an element (which is the Value() of the node.)
     const char* Name() const		{
@@ -1274,6 +1523,10 @@ public:
     void SetName( const char* str, bool staticMem=false )	{
         SetValue( str, staticMem );
     }
+    /// The interned name; see XMLDocument::Atom().
+    XMLAtom NameAtom() const {
+        return _nameAtom;
+    }
 
     virtual XMLElement* ToElement() override	{
         return this;
@@ -1307,6 +1560,8 @@ public:
     	@endverbatim
     */
     const char* Attribute( const char* name, const char* value=0 ) const;
+    /// Attribute() by atom; see XMLDocument::Atom()
+    const char* Attribute( XMLAtom name, const char* value=0 ) const;
 
     /** Given an attribute name, IntAttribute() returns the value
     	of the attribute interpreted as an integer. The default
@@ -1517,6 +1772,8 @@ public:
     }
     /// Query a specific attribute in the list.
     const XMLAttribute* FindAttribute( const char* name ) const;
+    /// FindAttribute() by atom
+    const XMLAttribute* FindAttribute( XMLAtom name ) const;
 
     /** Convenience function for easy access to the text inside an element. Although easy
     	and concise, GetText() is limited compared to getting the XMLText child
@@ -1696,6 +1953,10 @@ private:
 
     enum { BUF_SIZE = 200 };
     ElementClosingType _closingType;
+    XMLAtom _nameAtom;          // null until the name is set; _value points at its string
+    // Siblings of the same name, while the parent has a child index
+    XMLElement* _prevSameName;
+    XMLElement* _nextSameName;
     // The attribute list is ordered; there is no 'lastAttribute'
     // because the list needs to be scanned for dupes before adding
     // a new attribute.
@@ -1771,6 +2032,29 @@ public:
     */
     XMLError LoadFile( FILE* );
 
+    /**
+    	Load an XML file from disk without copying it: the file is
+    	memory-mapped copy-on-write and parsed in the mapping, so only
+    	the pages the parser writes to are duplicated. The file must not
+    	be truncated or rewritten in place while the document is loaded;
+    	replacing it with a rename is safe. Where mapping is not
+    	available this is LoadFile().
+    	Returns XML_SUCCESS (0) on success, or
+    	an errorID.
+    */
+    XMLError LoadFileMapped( const char* filename );
+
+    /**
+    	Parse a buffer owned by the caller, in place and without copying
+    	it. 'buffer' holds 'nBytes' of XML followed by a null terminator.
+    	Parsing writes into the buffer and the document refers into it,
+    	so it must stay valid and untouched until the document is
+    	cleared, reloaded or destroyed. The document never frees it.
+    	Returns XML_SUCCESS (0) on success, or
+    	an errorID.
+    */
+    XMLError ParseInPlace( char* buffer, size_t nBytes );
+
     /**
     	Save the XML file to disk.
     	Returns XML_SUCCESS (0) on success, or
@@ -1783,7 +2067,8 @@ public:
     	for providing and closing the FILE*.
 
     	Returns XML_SUCCESS (0) on success, or
-    	an errorID.
+    	an errorID: XML_ERROR_FILE_WRITE_ERROR if the
+    	FILE did not take all of the output.
     */
     XMLError SaveFile( FILE* fp, bool compact = false );
 
@@ -1876,6 +2161,23 @@ public:
     */
     void DeleteNode( XMLNode* node );
 
+    /**
+    	The atom of an element or attribute name, adding the name to the
+    	document's atom table if it is new. Atoms stay valid for the life
+    	of the document, across Clear() and loads, so they can be looked
+    	up once and used for every traversal:
+
+    	@verbatim
+    	const XMLAtom item = doc.Atom( "Item" );
+    	for( XMLElement* e = list->FirstChildElement( item ); e; e = e->NextSiblingElement( item ) ) ...
+    	@endverbatim
+
+    	The name overloads of the lookups go through the atom table too.
+    */
+    XMLAtom Atom( const char* name );
+    /// Like Atom() but never adds: the null atom if no node has used the name.
+    XMLAtom FindAtom( const char* name ) const;
+
     /// Clears the error flags.
     void ClearError();
 
@@ -1904,9 +2206,52 @@ public:
         return _errorLineNum;
     }
 
-    /// Clear the document, resetting it to the initial state.
+    /**
+    	Clear the document, resetting it to the initial state. The node
+    	pools keep their memory, so a document that is cleared (or
+    	loaded again, which clears it) parses into the memory it already
+    	has instead of allocating afresh.
+    */
     void Clear();
 
+    /**
+    	Prepare the document to be read by several threads at once.
+    	A string is normally finished in place the first time it is
+    	read - terminated, with its entities and newlines translated -
+    	so even const calls like GetText() and Attribute() write to
+    	the document. Freeze() finishes every string up front, those
+    	of nodes not linked into the tree and ErrorStr() included,
+    	after which the const interface writes nothing, and any number
+    	of threads may read the document together as long as none
+    	changes it.
+
+    	An index from XMLNode::BuildChildIndex() is read-only too, and
+    	may be built before or after freezing. The document stays
+    	frozen until it is cleared or loaded again. Edits are allowed,
+    	but not while other threads read.
+    */
+    void Freeze();
+    /// True after Freeze(), until the next Clear() or load.
+    bool Frozen() const {
+        return _frozen;
+    }
+
+    /**
+    	Size the node pools up front for about 'xmlBytes' of XML, so
+    	parsing it does not grow them block by block. Capacity is kept
+    	across Clear() and loads; reserving less than is there already
+    	does nothing.
+    */
+    void Reserve( size_t xmlBytes );
+
+    /**
+    	Memory use of the node pools: elements, attributes, text (and
+    	CDATA), and comments (with declarations and unknowns). Pass null
+    	for any that are not wanted.
+    */
+    void GetPoolStats( XMLPoolStats* elements, XMLPoolStats* attributes,
+                       XMLPoolStats* text, XMLPoolStats* comments ) const;
+
 	/**
 		Copies this document to a target document.
 		The target will be completely cleared before the copy.
@@ -1935,11 +2280,17 @@ private:
 
     bool			_writeBOM;
     bool			_processEntities;
+    bool			_frozen;
     XMLError		_errorID;
     Whitespace		_whitespaceMode;
     mutable StrPair	_errorStr;
     int             _errorLineNum;
+    // Where _charBuffer came from, and so how Clear() releases it
+    enum BufferSource { BUFFER_NEW, BUFFER_MAPPED, BUFFER_CALLER };
+
     char*			_charBuffer;
+    BufferSource	_charBufferSource;
+    size_t			_mappedSize;
     int				_parseCurLineNum;
 	int				_parsingDepth;
 	// Memory tracking does add some overhead.
@@ -1949,6 +2300,7 @@ private:
 	// in the document vs. a linked list in the XMLNode,
 	// and the performance is the same.
 	DynArray<XMLNode*, 10> _unlinked;
+	XMLAtomTable _atoms;
 
     MemPoolT< sizeof(XMLElement) >	 _elementPool;
     MemPoolT< sizeof(XMLAttribute) > _attributePool;
@@ -1958,6 +2310,12 @@ private:
 	static const char* _errorNames[XML_ERROR_COUNT];
 
     void Parse();
+    void ParseCharBuffer( size_t length );
+    void RewindPools();
+    // Name the node with the atom table's copy of the name
+    void InternName( XMLElement* element, const char* name, size_t length );
+    void InternName( XMLAttribute* attribute, const char* name, size_t length );
+    void ReleaseCharBuffer();
 
     void SetError( XMLError error, int lineNum, const char* format, ... );
 
@@ -2251,7 +2609,10 @@ public:
     	with only required whitespace and newlines.
     */
     XMLPrinter( FILE* file=0, bool compact = false, int depth = 0, EscapeAposCharsInAttributes aposInAttributes = ESCAPE_APOS_CHARS_IN_ATTRIBUTES );
-    virtual ~XMLPrinter()	{}
+    /// Writes out what is still buffered, see Flush().
+    virtual ~XMLPrinter()	{
+        Flush();
+    }
 
     /** If streaming, write the BOM and declaration. */
     void PushHeader( bool writeBOM, bool writeDeclaration );
@@ -2295,6 +2656,7 @@ public:
 
     virtual bool VisitEnter( const XMLDocument& /*doc*/ ) override;
     virtual bool VisitExit( const XMLDocument& /*doc*/ ) override	{
+        Flush();
         return true;
     }
 
@@ -2323,13 +2685,30 @@ public:
     }
     /**
     	If in print to memory mode, reset the buffer to the
-    	beginning.
+    	beginning. If printing to a FILE, write out what is
+    	buffered first.
     */
     void ClearBuffer( bool resetToFirstElement = true ) {
+        Flush();
         _buffer.Clear();
         _buffer.Push(0);
 		_firstElement = resetToFirstElement;
     }
+    /**
+    	If printing to a FILE, write out what is buffered. This
+    	is done when a document, the outermost element or a top
+    	level node is finished, and by the destructor; call it
+    	when streaming stops with an element still open and the
+    	printer stays around.
+    */
+    void Flush();
+    /**
+    	True once the FILE took less than it was given, after
+    	which nothing more is written to it.
+    */
+    bool WriteError() const {
+        return _writeError;
+    }
 
 protected:
 	virtual bool CompactMode( const XMLElement& )	{ return _compactMode; }
@@ -2355,9 +2734,12 @@ private:
      */
     void PrepareForNewNode( bool compactMode );
     void PrintString( const char*, bool restrictedEntitySet );	// prints out, after detecting entities.
+    void FlushIfFull();
+    void FlushIfDone();
 
     bool _firstElement;
     FILE* _fp;
+    bool _writeError;
     int _depth;
     int _textDepth;
     bool _processEntities;
@@ -2365,7 +2747,8 @@ private:
 
     enum {
         ENTITY_RANGE = 64,
-        BUF_SIZE = 200
+        BUF_SIZE = 200,
+        FLUSH_SIZE = 256 * 1024		// bytes handed to the FILE at a time
     };
     bool _entityFlag[ENTITY_RANGE];
     bool _restrictedEntityFlag[ENTITY_RANGE];
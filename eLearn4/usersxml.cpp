@@ -0,0 +1,326 @@
+#include "usersxml.h"
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include "atomicfile.h"
+#include "usersxmlreader.h"
+
+using namespace tinyxml2;
+
+// -----------------------------------------------------
+//  READ HELPERS
+// -----------------------------------------------------
+static QString childText(const XMLElement *parent, XMLAtom name)
+{
+    const XMLElement *el = parent ? parent->FirstChildElement(name) : nullptr;
+    const char *t = el ? el->GetText() : nullptr;
+    return t ? QString::fromUtf8(t) : QString();
+}
+
+static QString attr(const XMLElement *e, XMLAtom name)
+{
+    const char *a = e->Attribute(name);
+    return a ? QString::fromUtf8(a) : QString();
+}
+
+static void addText(XMLDocument &doc, XMLElement *parent, const char *name, const QString &value)
+{
+    XMLElement *el = doc.NewElement(name);
+    el->SetText(value.toUtf8().constData());
+    parent->InsertEndChild(el);
+}
+
+// The names a <Student> is read by, as atoms of its document: looked up
+// once per student, then every match below is an integer compare
+struct StudentNames
+{
+    explicit StudentNames(const XMLDocument *doc)
+        : id(doc->FindAtom("id")), username(doc->FindAtom("Username")),
+          password(doc->FindAtom("Password")), email(doc->FindAtom("Email")),
+          phone(doc->FindAtom("Phone")), address(doc->FindAtom("Address")),
+          registeredCourses(doc->FindAtom("RegisteredCourses")),
+          courseRegistration(doc->FindAtom("CourseRegistration")),
+          courseId(doc->FindAtom("courseId")),
+          registrationDate(doc->FindAtom("RegistrationDate")),
+          testRegistrations(doc->FindAtom("TestRegistrations")),
+          testRegistration(doc->FindAtom("TestRegistration")),
+          testId(doc->FindAtom("testId")), attempt(doc->FindAtom("attempt")),
+          score(doc->FindAtom("Score")), result(doc->FindAtom("Result")),
+          grade(doc->FindAtom("Grade")), certificate(doc->FindAtom("Certificate")),
+          status(doc->FindAtom("Status")), issueDate(doc->FindAtom("IssueDate"))
+    {}
+
+    XMLAtom id, username, password, email, phone, address;
+    XMLAtom registeredCourses, courseRegistration, courseId, registrationDate;
+    XMLAtom testRegistrations, testRegistration, testId, attempt, score, result, grade;
+    XMLAtom certificate, status, issueDate;
+};
+
+Student studentFromXml(const XMLElement *e)
+{
+    const StudentNames n(e->GetDocument());
+    Student s;
+    s.id       = attr(e, n.id);
+    s.username = childText(e, n.username);
+    s.password = childText(e, n.password);
+    s.email    = childText(e, n.email);
+    s.phone    = childText(e, n.phone);
+    s.address  = childText(e, n.address);
+
+    const XMLElement *regCourses = e->FirstChildElement(n.registeredCourses);
+    if (!regCourses) return s;
+
+    for (const XMLElement *c = regCourses->FirstChildElement(n.courseRegistration); c;
+         c = c->NextSiblingElement(n.courseRegistration))
+    {
+        CourseRegistration reg;
+        reg.courseId         = attr(c, n.courseId);
+        reg.registrationDate = childText(c, n.registrationDate);
+
+        const XMLElement *tests = c->FirstChildElement(n.testRegistrations);
+        for (const XMLElement *t = tests ? tests->FirstChildElement(n.testRegistration) : nullptr; t;
+             t = t->NextSiblingElement(n.testRegistration))
+        {
+            TestRegistration tr;
+            const XMLAttribute *attempt = t->FindAttribute(n.attempt);
+            tr.testId  = attr(t, n.testId);
+            tr.attempt = attempt ? attempt->IntValue() : 0;
+            tr.score   = childText(t, n.score).toInt();
+            tr.result  = childText(t, n.result);
+            tr.grade   = childText(t, n.grade).trimmed();
+            reg.tests.append(tr);
+        }
+
+        const XMLElement *cert = c->FirstChildElement(n.certificate);
+        if (cert) {
+            QString status = childText(cert, n.status);
+            if (!status.isEmpty()) reg.certificateStatus = status;
+            reg.certificateIssueDate = childText(cert, n.issueDate);
+        }
+        s.courses.append(reg);
+    }
+    return s;
+}
+
+qsizetype findStudentElement(const QByteArray &bytes, qsizetype from, qsizetype *end)
+{
+    static const QByteArray tag = "<Student";
+    static const QByteArray close = "</Student>";
+
+    for (qsizetype at = bytes.indexOf(tag, from); at >= 0; at = bytes.indexOf(tag, at + 1)) {
+        const qsizetype next = at + tag.size();
+        if (next >= bytes.size())
+            break;
+        const char c = bytes.at(next);
+        if (c != '>' && c != '/' && c != ' ' && c != '\t' && c != '\r' && c != '\n')
+            continue;
+
+        *end = -1;
+        const qsizetype gt = bytes.indexOf('>', at);
+        if (gt >= 0 && bytes.at(gt - 1) == '/') {
+            *end = gt + 1;          // <Student .../>
+        } else if (gt >= 0) {
+            const qsizetype closeAt = bytes.indexOf(close, gt);
+            if (closeAt >= 0)
+                *end = closeAt + close.size();
+        }
+        return at;
+    }
+    return -1;
+}
+
+Course courseFromXml(const XMLElement *e)
+{
+    const XMLDocument *doc = e->GetDocument();
+    const XMLAtom id = doc->FindAtom("id"), test = doc->FindAtom("Test");
+    const XMLAtom type = doc->FindAtom("type"), totalMarks = doc->FindAtom("TotalMarks");
+
+    Course c;
+    c.id          = attr(e, id);
+    c.name        = childText(e, doc->FindAtom("Name"));
+    c.description = childText(e, doc->FindAtom("Description"));
+
+    const XMLElement *tests = e->FirstChildElement(doc->FindAtom("Tests"));
+    for (const XMLElement *t = tests ? tests->FirstChildElement(test) : nullptr; t;
+         t = t->NextSiblingElement(test))
+    {
+        CourseTest ct;
+        ct.id         = attr(t, id);
+        ct.type       = attr(t, type);
+        ct.totalMarks = childText(t, totalMarks);
+        c.tests.append(ct);
+    }
+    return c;
+}
+
+// -----------------------------------------------------
+//  WRITE HELPERS
+// -----------------------------------------------------
+XMLElement *studentToXml(XMLDocument &doc, const Student &s)
+{
+    XMLElement *st = doc.NewElement("Student");
+    st->SetAttribute("id", s.id.toUtf8().constData());
+
+    addText(doc, st, "Username", s.username);
+    addText(doc, st, "Password", s.password);
+    // contact details are optional in older files, only write what we have
+    if (!s.email.isEmpty())   addText(doc, st, "Email", s.email);
+    if (!s.phone.isEmpty())   addText(doc, st, "Phone", s.phone);
+    if (!s.address.isEmpty()) addText(doc, st, "Address", s.address);
+
+    XMLElement *regCourses = doc.NewElement("RegisteredCourses");
+    for (const CourseRegistration &reg : s.courses)
+    {
+        XMLElement *c = doc.NewElement("CourseRegistration");
+        c->SetAttribute("courseId", reg.courseId.toUtf8().constData());
+        addText(doc, c, "RegistrationDate", reg.registrationDate);
+
+        XMLElement *tests = doc.NewElement("TestRegistrations");
+        for (const TestRegistration &tr : reg.tests)
+        {
+            XMLElement *t = doc.NewElement("TestRegistration");
+            t->SetAttribute("testId", tr.testId.toUtf8().constData());
+            t->SetAttribute("attempt", tr.attempt);
+            addText(doc, t, "Score", QString::number(tr.score));
+            addText(doc, t, "Result", tr.result);
+            addText(doc, t, "Grade", tr.grade);
+            tests->InsertEndChild(t);
+        }
+        c->InsertEndChild(tests);
+
+        XMLElement *cert = doc.NewElement("Certificate");
+        addText(doc, cert, "Status", reg.certificateStatus);
+        if (!reg.certificateIssueDate.isEmpty())
+            addText(doc, cert, "IssueDate", reg.certificateIssueDate);
+        c->InsertEndChild(cert);
+
+        regCourses->InsertEndChild(c);
+    }
+    st->InsertEndChild(regCourses);
+    return st;
+}
+
+XMLElement *courseToXml(XMLDocument &doc, const Course &c)
+{
+    XMLElement *course = doc.NewElement("Course");
+    course->SetAttribute("id", c.id.toUtf8().constData());
+    addText(doc, course, "Name", c.name);
+    addText(doc, course, "Description", c.description);
+
+    XMLElement *tests = doc.NewElement("Tests");
+    for (const CourseTest &ct : c.tests)
+    {
+        XMLElement *t = doc.NewElement("Test");
+        t->SetAttribute("id", ct.id.toUtf8().constData());
+        t->SetAttribute("type", ct.type.toUtf8().constData());
+        if (!ct.totalMarks.isEmpty())
+            addText(doc, t, "TotalMarks", ct.totalMarks);
+        tests->InsertEndChild(t);
+    }
+    course->InsertEndChild(tests);
+    return course;
+}
+
+// -----------------------------------------------------
+//  WHOLE FILE
+// -----------------------------------------------------
+// One pass of the pull reader; no DOM of the whole file is built. A missing
+// checksum trailer is accepted.
+static bool readChecked(const QString &path, UsersFile *out, QString *error)
+{
+    UsersXmlReader reader;
+    if (!reader.open(path, error))
+        return false;
+
+    UsersFile file;
+    Student s;
+    while (reader.readStudent(&s))
+        file.students.append(s);
+    if (reader.hasError()) {
+        if (error) *error = reader.errorString();
+        return false;
+    }
+
+    file.courses    = reader.courses();
+    file.nextId     = reader.nextId();
+    file.journalSeq = reader.journalSeq();
+    *out = file;
+    return true;
+}
+
+bool readUsersXml(const QString &path, UsersFile *out, QString *error)
+{
+    QString why;
+    if (!readChecked(path, out, &why)) {
+        // fall back to the generation kept by the last save
+        if (!readChecked(path + ".bak", out, nullptr)) {
+            if (error) *error = why;
+            return false;
+        }
+        qWarning() << why << "- loaded" << path + ".bak" << "instead";
+    }
+    return true;
+}
+
+void UsersXmlPrinter::reset()
+{
+    while (!_stack.Empty())
+        CloseElement();
+    ClearBuffer();
+}
+
+void UsersXmlPrinter::seal()
+{
+    const QByteArray trailer = checksumTrailer(CStr(), CStrSize() - 1);
+    Write(trailer.constData(), trailer.size());
+}
+
+// Where OpenElement() starts one: the open tag sealed, a new line, one
+// indent per element still open
+void UsersXmlPrinter::pushElement(const char *xml, qsizetype size)
+{
+    SealElementIfJustOpened();
+    Putc('\n');
+    PrintSpace(int(_stack.Size()));
+    Write(xml, size_t(size));
+}
+
+// Serialize the document into *printer, sealed with its checksum. sizeHint,
+// the size of the file being replaced, pre-sizes the node pools.
+static void serialize(const UsersFile &in, qint64 sizeHint, UsersXmlPrinter *printer)
+{
+    XMLDocument doc;
+    if (sizeHint > 0)
+        doc.Reserve(sizeHint);
+    doc.InsertEndChild(doc.NewDeclaration());
+
+    XMLElement *root = doc.NewElement("ELearningPlatform");
+    if (in.journalSeq)
+        root->SetAttribute("journalSeq", static_cast<uint64_t>(in.journalSeq));
+    doc.InsertEndChild(root);
+
+    XMLElement *courses = doc.NewElement("Courses");
+    for (const Course &c : in.courses)
+        courses->InsertEndChild(courseToXml(doc, c));
+    root->InsertEndChild(courses);
+
+    XMLElement *students = doc.NewElement("Students");
+    if (in.nextId)
+        students->SetAttribute("nextId", static_cast<uint64_t>(in.nextId));
+    for (const Student &s : in.students)
+        students->InsertEndChild(studentToXml(doc, s));
+    root->InsertEndChild(students);
+
+    printer->reset();
+    doc.Print(printer);
+    printer->seal();
+}
+
+bool writeUsersXml(const QString &path, const UsersFile &in, UsersXmlPrinter *printer,
+                   QString *error)
+{
+    UsersXmlPrinter local;
+    UsersXmlPrinter &out = printer ? *printer : local;
+    serialize(in, QFileInfo(path).size(), &out);
+    return writeFileAtomic(path, out.CStr(), out.CStrSize() - 1, true, error);
+}
@@ -0,0 +1,58 @@
+// usersxml.h
+#ifndef USERSXML_H
+#define USERSXML_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "records.h"
+#include "tinyxml2.h"
+
+// Everything users.xml holds, in typed form
+struct UsersFile
+{
+    QVector<Course>  courses;
+    QVector<Student> students;
+    quint64          nextId = 0;    // <Students nextId="..">, 0 when absent
+    quint64          journalSeq = 0; // last journal record folded in (root attribute)
+};
+
+// Element <-> record conversion
+Student studentFromXml(const tinyxml2::XMLElement *e);
+Course  courseFromXml(const tinyxml2::XMLElement *e);
+tinyxml2::XMLElement *studentToXml(tinyxml2::XMLDocument &doc, const Student &s);
+tinyxml2::XMLElement *courseToXml(tinyxml2::XMLDocument &doc, const Course &c);
+
+// Raw scan for readers that parse one student at a time: start of the next
+// <Student> element (not <Students>) at or after `from`, -1 when there is
+// none. *end is one past the element, -1 when it is not closed.
+qsizetype findStudentElement(const QByteArray &bytes, qsizetype from, qsizetype *end);
+
+// Buffer a save is serialized into before it is written. A printer used
+// again reuses its allocation, so whoever saves repeatedly keeps one (one
+// per store) and frees it with itself; a null printer means a buffer for
+// just that save.
+class UsersXmlPrinter : public tinyxml2::XMLPrinter
+{
+public:
+    // Empty, with no element open: ready for the next document even when
+    // the last one was abandoned half way
+    void reset();
+
+    // Append the checksum trailer over everything printed so far
+    void seal();
+
+    // Print an element serialized elsewhere, bytes as they are, as the next
+    // child of the open element: on its own line, indented like one opened
+    // here (UsersXmlWriter copies unchanged students this way)
+    void pushElement(const char *xml, qsizetype size);
+};
+
+// Whole-file load / save. Reading streams through UsersXmlReader, so only
+// the records are held, never a DOM of the file.
+bool readUsersXml(const QString &path, UsersFile *out, QString *error = nullptr);
+bool writeUsersXml(const QString &path, const UsersFile &in, UsersXmlPrinter *printer,
+                   QString *error = nullptr);
+
+
+#endif // USERSXML_H
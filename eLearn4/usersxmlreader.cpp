@@ -0,0 +1,172 @@
+#include "usersxmlreader.h"
+#include "atomicfile.h"
+
+bool UsersXmlReader::open(const QString &path, QString *error)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        m_error = "Could not open " + path + ": " + m_file.errorString();
+    else if (verifyChecksum(m_file) == Checksum::Invalid)
+        m_error = path + " is damaged (checksum mismatch)";
+    else {
+        m_xml.setDevice(&m_file);
+        if (!m_xml.readNextStartElement() || m_xml.name() != u"ELearningPlatform")
+            m_error = "Invalid XML: Missing <ELearningPlatform>";
+        else
+            m_journalSeq = attribute("journalSeq").toULongLong();
+    }
+
+    if (m_error.isEmpty())
+        return true;
+    if (error) *error = m_error;
+    return false;
+}
+
+bool UsersXmlReader::readStudent(Student *out)
+{
+    bool found = false;
+    while (!found && m_error.isEmpty() && !m_xml.atEnd()) {
+        if (m_xml.readNext() != QXmlStreamReader::StartElement)
+            continue;
+
+        const QStringView name = m_xml.name();
+        if (name == u"Students") {
+            m_nextId = attribute("nextId").toULongLong();
+        } else if (name == u"Course") {
+            m_courses.append(readCourse());
+        } else if (name == u"Student") {
+            *out = readStudentElement();
+            found = true;
+        }
+    }
+
+    if (m_error.isEmpty() && m_xml.hasError())
+        m_error = "Could not parse " + m_file.fileName() + ": " + m_xml.errorString();
+    return found && m_error.isEmpty();
+}
+
+// -----------------------------------------------------
+//  ELEMENTS
+//  Each reader starts on the element's start tag and returns on its end
+//  tag; unknown children are skipped.
+// -----------------------------------------------------
+QString UsersXmlReader::attribute(const char *name) const
+{
+    return m_xml.attributes().value(QLatin1String(name)).toString();
+}
+
+Course UsersXmlReader::readCourse()
+{
+    Course c;
+    c.id = attribute("id");
+    while (m_xml.readNextStartElement()) {
+        const QStringView name = m_xml.name();
+        if (name == u"Name") {
+            c.name = m_xml.readElementText(QXmlStreamReader::SkipChildElements);
+        } else if (name == u"Description") {
+            c.description = m_xml.readElementText(QXmlStreamReader::SkipChildElements);
+        } else if (name == u"Tests") {
+            while (m_xml.readNextStartElement()) {
+                if (m_xml.name() != u"Test") {
+                    m_xml.skipCurrentElement();
+                    continue;
+                }
+                CourseTest ct;
+                ct.id   = attribute("id");
+                ct.type = attribute("type");
+                while (m_xml.readNextStartElement()) {
+                    if (m_xml.name() == u"TotalMarks")
+                        ct.totalMarks = m_xml.readElementText(QXmlStreamReader::SkipChildElements);
+                    else
+                        m_xml.skipCurrentElement();
+                }
+                c.tests.append(ct);
+            }
+        } else {
+            m_xml.skipCurrentElement();
+        }
+    }
+    return c;
+}
+
+Student UsersXmlReader::readStudentElement()
+{
+    Student s;
+    s.id = attribute("id");
+    while (m_xml.readNextStartElement()) {
+        const QStringView name = m_xml.name();
+        if (name == u"Username") {
+            s.username = m_xml.readElementText(QXmlStreamReader::SkipChildElements);
+        } else if (name == u"Password") {
+            s.password = m_xml.readElementText(QXmlStreamReader::SkipChildElements);
+        } else if (name == u"Email") {
+            s.email = m_xml.readElementText(QXmlStreamReader::SkipChildElements);
+        } else if (name == u"Phone") {
+            s.phone = m_xml.readElementText(QXmlStreamReader::SkipChildElements);
+        } else if (name == u"Address") {
+            s.address = m_xml.readElementText(QXmlStreamReader::SkipChildElements);
+        } else if (name == u"RegisteredCourses") {
+            while (m_xml.readNextStartElement()) {
+                if (m_xml.name() == u"CourseRegistration")
+                    s.courses.append(readRegistration());
+                else
+                    m_xml.skipCurrentElement();
+            }
+        } else {
+            m_xml.skipCurrentElement();
+        }
+    }
+    return s;
+}
+
+CourseRegistration UsersXmlReader::readRegistration()
+{
+    CourseRegistration reg;
+    reg.courseId = attribute("courseId");
+    while (m_xml.readNextStartElement()) {
+        const QStringView name = m_xml.name();
+        if (name == u"RegistrationDate") {
+            reg.registrationDate = m_xml.readElementText(QXmlStreamReader::SkipChildElements);
+        } else if (name == u"TestRegistrations") {
+            while (m_xml.readNextStartElement()) {
+                if (m_xml.name() == u"TestRegistration")
+                    reg.tests.append(readAttempt());
+                else
+                    m_xml.skipCurrentElement();
+            }
+        } else if (name == u"Certificate") {
+            while (m_xml.readNextStartElement()) {
+                if (m_xml.name() == u"Status") {
+                    QString status = m_xml.readElementText(QXmlStreamReader::SkipChildElements);
+                    if (!status.isEmpty()) reg.certificateStatus = status;
+                } else if (m_xml.name() == u"IssueDate") {
+                    reg.certificateIssueDate = m_xml.readElementText(QXmlStreamReader::SkipChildElements);
+                } else {
+                    m_xml.skipCurrentElement();
+                }
+            }
+        } else {
+            m_xml.skipCurrentElement();
+        }
+    }
+    return reg;
+}
+
+TestRegistration UsersXmlReader::readAttempt()
+{
+    TestRegistration tr;
+    tr.testId  = attribute("testId");
+    tr.attempt = attribute("attempt").toInt();
+    while (m_xml.readNextStartElement()) {
+        const QStringView name = m_xml.name();
+        if (name == u"Score")
+            tr.score = m_xml.readElementText(QXmlStreamReader::SkipChildElements).toInt();
+        else if (name == u"Result")
+            tr.result = m_xml.readElementText(QXmlStreamReader::SkipChildElements);
+        else if (name == u"Grade")
+            tr.grade = m_xml.readElementText(QXmlStreamReader::SkipChildElements).trimmed();
+        else
+            m_xml.skipCurrentElement();
+    }
+    return tr;
+}
@@ -0,0 +1,60 @@
+// usersxmlreader.h
+#ifndef USERSXMLREADER_H
+#define USERSXMLREADER_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <QXmlStreamReader>
+#include "records.h"
+
+// Pull reader for users.xml and files in its format (shard buckets,
+// catalog.xml). Where a DOM holds the whole document, several times the
+// file size, this holds one <Student> at a time: callers take students as
+// they come and memory stays flat however large the file is.
+//
+//   UsersXmlReader reader;
+//   if (!reader.open(path, &error)) ...
+//   Student s;
+//   while (reader.readStudent(&s)) ...
+//   if (reader.hasError()) ...
+//
+// open() checks the checksum trailer first, in one sequential pass. The
+// courses are collected as they are passed; users.xml writes them before
+// the students, but they are only complete once readStudent() has
+// returned false.
+class UsersXmlReader
+{
+public:
+    bool open(const QString &path, QString *error = nullptr);
+
+    // The next student in file order; false at the end or on an error
+    bool readStudent(Student *out);
+
+    bool hasError() const { return !m_error.isEmpty(); }
+    QString errorString() const { return m_error; }
+
+    const QVector<Course> &courses() const { return m_courses; }
+    quint64 nextId() const { return m_nextId; }
+    quint64 journalSeq() const { return m_journalSeq; }
+
+    // For progress reports
+    qint64 bytesRead() const { return m_file.pos(); }
+    qint64 size() const { return m_file.size(); }
+
+private:
+    QString attribute(const char *name) const;
+    Course readCourse();
+    Student readStudentElement();
+    CourseRegistration readRegistration();
+    TestRegistration readAttempt();
+
+    QFile m_file;
+    QXmlStreamReader m_xml;
+    QString m_error;
+    QVector<Course> m_courses;
+    quint64 m_nextId = 0;
+    quint64 m_journalSeq = 0;
+};
+
+#endif // USERSXMLREADER_H
@@ -0,0 +1,99 @@
+#include "usersxmlwriter.h"
+#include "atomicfile.h"
+#include "usersxml.h"
+
+using namespace tinyxml2;
+
+// Output handed to the file once this much has collected in the printer
+static const qint64 kChunk = 256 * 1024;
+
+static bool fail(QString *error, const QString &text)
+{
+    if (error) *error = text;
+    return false;
+}
+
+UsersXmlWriter::UsersXmlWriter(UsersXmlPrinter *printer)
+    : m_printer(printer)
+{
+}
+
+UsersXmlWriter::~UsersXmlWriter()
+{
+    if (m_file.isOpen() && !m_finished) {
+        m_file.close();
+        m_file.remove();
+    }
+}
+
+// Everything up to the first student: the declaration, the root with the
+// journal position, the courses and the open <Students> tag
+bool UsersXmlWriter::open(const QString &path, const QVector<Course> &courses, quint64 nextId,
+                          quint64 journalSeq, QString *error)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return fail(error, "Could not create " + path + ": " + m_file.errorString());
+    m_crc = 0;
+    m_finished = false;
+
+    m_printer->reset();
+    m_printer->PushDeclaration("xml version=\"1.0\" encoding=\"UTF-8\"");
+    m_printer->OpenElement("ELearningPlatform");
+    if (journalSeq)
+        m_printer->PushAttribute("journalSeq", static_cast<uint64_t>(journalSeq));
+
+    m_printer->OpenElement("Courses");
+    for (const Course &c : courses) {
+        courseToXml(m_doc, c)->Accept(m_printer);
+        m_doc.Clear();
+    }
+    m_printer->CloseElement();
+
+    m_printer->OpenElement("Students");
+    if (nextId)
+        m_printer->PushAttribute("nextId", static_cast<uint64_t>(nextId));
+    return flush(kChunk, error);
+}
+
+bool UsersXmlWriter::writeStudent(const Student &s, QString *error)
+{
+    studentToXml(m_doc, s)->Accept(m_printer);
+    m_doc.Clear();
+    return flush(kChunk, error);
+}
+
+bool UsersXmlWriter::copyStudent(const QByteArray &element, QString *error)
+{
+    m_printer->pushElement(element.constData(), element.size());
+    return flush(kChunk, error);
+}
+
+bool UsersXmlWriter::finish(QString *error)
+{
+    m_printer->CloseElement();      // </Students>
+    m_printer->CloseElement();      // </ELearningPlatform>
+    if (!flush(0, error))
+        return false;
+
+    const QByteArray trailer = checksumTrailer(m_crc);
+    if (m_file.write(trailer) != trailer.size() || !syncFile(m_file))
+        return fail(error, "Could not write " + m_file.fileName() + ": " + m_file.errorString());
+    m_file.close();
+    m_finished = true;
+    return true;
+}
+
+// Hand what the printer holds to the file once it passes `threshold`;
+// the printer keeps its place in the document
+bool UsersXmlWriter::flush(qint64 threshold, QString *error)
+{
+    const qint64 size = qint64(m_printer->CStrSize()) - 1;
+    if (size <= 0 || size < threshold)
+        return true;
+    if (m_file.write(m_printer->CStr(), size) != size)
+        return fail(error, "Could not write " + m_file.fileName() + ": " + m_file.errorString());
+    m_crc = crc32(m_printer->CStr(), size, m_crc);
+    m_printer->ClearBuffer(false);
+    return true;
+}
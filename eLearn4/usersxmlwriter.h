@@ -0,0 +1,52 @@
+// usersxmlwriter.h
+#ifndef USERSXMLWRITER_H
+#define USERSXMLWRITER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include "records.h"
+#include "tinyxml2.h"
+
+class UsersXmlPrinter;
+
+// Push writer for users.xml, the counterpart of UsersXmlReader: students
+// go out one at a time, so writing the file never needs the roster in
+// memory. Each is either a record, serialized, or a <Student> element
+// copied byte for byte from the file being replaced. Output collects in the
+// caller's printer and goes to the file in pieces; finish() appends the
+// checksum trailer over all of it and syncs.
+//
+//   UsersXmlWriter writer(&printer);
+//   if (!writer.open(path, courses, nextId, journalSeq, &error)) ...
+//   writer.writeStudent(s, &error) / writer.copyStudent(element, &error) ...
+//   if (!writer.finish(&error)) ...
+//
+// The result is laid out like writeUsersXml()'s. A file left unfinished is
+// removed by the destructor.
+class UsersXmlWriter
+{
+public:
+    explicit UsersXmlWriter(UsersXmlPrinter *printer);
+    ~UsersXmlWriter();
+
+    bool open(const QString &path, const QVector<Course> &courses, quint64 nextId,
+              quint64 journalSeq, QString *error = nullptr);
+
+    bool writeStudent(const Student &s, QString *error = nullptr);
+    bool copyStudent(const QByteArray &element, QString *error = nullptr);
+
+    bool finish(QString *error = nullptr);
+
+private:
+    bool flush(qint64 threshold, QString *error);
+
+    UsersXmlPrinter *m_printer;
+    tinyxml2::XMLDocument m_doc;    // scratch for one record at a time
+    QFile   m_file;
+    quint32 m_crc = 0;
+    bool    m_finished = false;
+};
+
+#endif // USERSXMLWRITER_H
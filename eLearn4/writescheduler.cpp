@@ -0,0 +1,67 @@
+#include "writescheduler.h"
+#include <QDeadlineTimer>
+#include "studentstore.h"
+
+WriteScheduler::WriteScheduler(StudentStore *store)
+    : m_store(store)
+{
+}
+
+bool WriteScheduler::submit(Mutation *m, QString *error)
+{
+    Pending p;
+    p.mutation = m;
+
+    QMutexLocker locker(&m_mutex);
+    m_queue.append(&p);
+    if (m_queue.size() >= m_maxBatch)
+        m_queued.wakeOne();
+
+    while (!p.done) {
+        if (m_leading) {
+            m_done.wait(&m_mutex);
+            continue;
+        }
+
+        // lead the next batch; it may not reach our own entry when the
+        // queue is longer than maxBatch, in which case we lead again
+        m_leading = true;
+        QDeadlineTimer deadline(m_window);
+        while (m_queue.size() < m_maxBatch && !deadline.hasExpired())
+            m_queued.wait(&m_mutex, deadline);
+
+        const QVector<Pending *> batch = m_queue.mid(0, m_maxBatch);
+        m_queue.remove(0, batch.size());
+        locker.unlock();
+        flush(batch);
+        locker.relock();
+
+        for (Pending *done : batch)
+            done->done = true;
+        m_leading = false;
+        m_done.wakeAll();
+    }
+
+    if (!p.ok && error)
+        *error = p.error;
+    return p.ok;
+}
+
+// One durable write for the whole batch; each caller gets its own verdict
+void WriteScheduler::flush(const QVector<Pending *> &batch)
+{
+    QVector<Mutation *> mutations;
+    mutations.reserve(batch.size());
+    for (const Pending *p : batch)
+        mutations.append(p->mutation);
+
+    QVector<QString> results;
+    QString error;
+    QMutexLocker locker(&m_storeMutex);
+    const bool written = m_store->commitBatch(mutations, &results, &error);
+
+    for (int i = 0; i < batch.size(); ++i) {
+        batch[i]->ok    = written && results.value(i).isEmpty();
+        batch[i]->error = written ? results.value(i) : error;
+    }
+}
@@ -0,0 +1,64 @@
+// writescheduler.h
+#ifndef WRITESCHEDULER_H
+#define WRITESCHEDULER_H
+
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <QWaitCondition>
+#include "mutation.h"
+
+class StudentStore;
+
+// Group commit in front of a StudentStore. Callers on any thread hand in a
+// Mutation and block until the batch holding it is durable; mutations that
+// arrive while a batch is being written queue up and go out together in the
+// next one, so a burst costs one write (and one sync) per batch instead of
+// one per change.
+//
+// The first waiting caller becomes the leader: it collects the queue for up
+// to window() ms or until maxBatch() changes are waiting, commits them
+// through StudentStore::commitBatch() and wakes the rest. A window of 0 (the
+// default) adds no delay to a lone caller; batches then form only behind a
+// commit already in progress.
+//
+// Every store call, reads included, must hold storeMutex().
+class WriteScheduler
+{
+public:
+    explicit WriteScheduler(StudentStore *store);
+
+    void setWindow(int ms) { m_window = qMax(ms, 0); }
+    int window() const { return m_window; }
+    void setMaxBatch(int count) { m_maxBatch = qMax(count, 1); }
+    int maxBatch() const { return m_maxBatch; }
+
+    QMutex *storeMutex() { return &m_storeMutex; }
+
+    // Acknowledged once persisted; *m then carries what the store assigned
+    bool submit(Mutation *m, QString *error = nullptr);
+
+private:
+    struct Pending
+    {
+        Mutation *mutation;
+        QString error;
+        bool ok = false;
+        bool done = false;
+    };
+
+    void flush(const QVector<Pending *> &batch);
+
+    StudentStore *m_store;
+    int m_window = 0;
+    int m_maxBatch = 64;
+
+    QMutex m_storeMutex;
+    QMutex m_mutex;                 // guards the queue and m_leading
+    QWaitCondition m_queued;        // the leader waits for a full batch
+    QWaitCondition m_done;          // followers wait for their ack
+    QVector<Pending *> m_queue;
+    bool m_leading = false;
+};
+
+#endif // WRITESCHEDULER_H
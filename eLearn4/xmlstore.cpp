@@ -0,0 +1,585 @@
+#include "xmlstore.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QDebug>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include "atomicfile.h"
+#include "usersxmlwriter.h"
+
+// How long a commit waits for another instance to finish its own
+static const int kLockTimeoutMs = 5000;
+
+// Changes logged for changesSince(); older ones are dropped in halves
+static const int kMaxChanges = 8192;
+
+static void setError(QString *error, const QString &text)
+{
+    if (error) *error = text;
+}
+
+// The snapshot is named after the users.xml it mirrors, so writing a new one
+// never replaces a file another instance still has mapped (Windows refuses)
+static QString snapshotPath(const QFileInfo &xml)
+{
+    return xml.absolutePath() + "/users-" + QString::number(xml.size(), 16) + "-"
+         + QString::number(xml.lastModified().toMSecsSinceEpoch(), 16) + ".snap";
+}
+
+static bool acquire(QLockFile &lock, QString *error)
+{
+    if (lock.tryLock(kLockTimeoutMs))
+        return true;
+    setError(error, "The data files are busy in another window, please try again.");
+    return false;
+}
+
+// A compaction still being written is abandoned; the journal has it all
+XmlStore::~XmlStore()
+{
+    if (!m_compacting)
+        return;
+    m_compaction.waitForFinished();
+    QFile::remove(m_compactTmp);
+}
+
+bool XmlStore::open(const QString &dataDir, QString *error)
+{
+    m_usersFile = dataDir + "users.xml";
+    m_lockPath  = dataDir + "users.lock";
+    m_journal.setPath(dataDir + "users.journal");
+
+    QLockFile lock(m_lockPath);
+    if (!acquire(lock, error))
+        return false;
+    if (!reloadUsersXml(error) || !catchUp(true, error))
+        return false;
+    lock.unlock();
+
+    maybeCompact();
+    return true;
+}
+
+// Rebuild the state from users.xml alone (the snapshot of it, or an index
+// of it); the journal is applied by catchUp()
+bool XmlStore::reloadUsersXml(QString *error)
+{
+    // stamped before reading: a change made meanwhile shows up as another one
+    const QFileInfo xml(m_usersFile);
+    const qint64 modified = xml.lastModified().toMSecsSinceEpoch();
+
+    State state;
+    auto snap = QSharedPointer<Snapshot>::create();
+    if (snap->open(snapshotPath(xml)) && snap->sourceSize() == xml.size()
+        && snap->sourceModified() == modified) {
+        state.base = snap;
+        state.ids.reset(snap->nextId());
+        m_catalog.rebuild(snap->courses());
+        m_state = state;
+        m_seq   = snap->journalSeq();
+        m_xmlSize = xml.size();
+        m_xmlModified = modified;
+        m_baseUnreadable = false;
+        return true;
+    }
+
+    auto index = QSharedPointer<StudentIndex>::create();
+    index->setCacheLimit(m_cacheLimit);
+    if (!index->open(m_usersFile, error))
+        return false;
+
+    state.base = index;
+    state.ids.reset(index->nextId());
+    m_catalog.rebuild(index->courses());
+    m_state = state;
+    m_seq   = index->journalSeq();
+    m_xmlSize = xml.size();
+    m_xmlModified = modified;
+    m_baseUnreadable = false;
+
+    // next start maps this instead of scanning
+    buildSnapshot();
+    return true;
+}
+
+static void writeSnapshotAndPrune(const QString &path, const UsersFile &file,
+                                  qint64 size, qint64 modified)
+{
+    QString error;
+    if (!writeSnapshot(path, file, size, modified, &error)) {
+        qWarning() << "users snapshot:" << error;
+        return;
+    }
+    const QFileInfo snap(path);
+    QDir dir = snap.absoluteDir();
+    for (const QString &name : dir.entryList({ "users-*.snap" }, QDir::Files))
+        if (name != snap.fileName())
+            dir.remove(name);
+}
+
+// Write the snapshot of the current users.xml on a pool thread and drop
+// older ones (those still mapped elsewhere go on a later pass). The pool
+// thread reads users.xml itself, and gives up if the file changes meanwhile.
+void XmlStore::buildSnapshot()
+{
+    const QString usersFile = m_usersFile;
+    const QFileInfo xml(usersFile);
+    const qint64 size = xml.size();
+    const qint64 modified = xml.lastModified().toMSecsSinceEpoch();
+    const QString path = snapshotPath(xml);
+
+    QThreadPool::globalInstance()->start([usersFile, size, modified, path]() {
+        UsersFile file;
+        if (!readUsersXml(usersFile, &file))
+            return;
+        const QFileInfo after(usersFile);
+        if (after.size() != size || after.lastModified().toMSecsSinceEpoch() != modified)
+            return;
+        writeSnapshotAndPrune(path, file, size, modified);
+    });
+}
+
+bool XmlStore::usersXmlChanged() const
+{
+    const QFileInfo xml(m_usersFile);
+    return xml.size() != m_xmlSize || xml.lastModified().toMSecsSinceEpoch() != m_xmlModified;
+}
+
+// Apply whatever this or another instance journaled after m_seq. When a
+// compaction has folded records we never saw, start over from users.xml;
+// the same when users.xml is not the file loaded, or a record of it could
+// not be read, then replaying the journal from its start.
+bool XmlStore::catchUp(bool repair, QString *error)
+{
+    if (m_baseUnreadable || usersXmlChanged()) {
+        m_journal.setPath(m_journal.path());
+        if (!reloadUsersXml(error))
+            return false;
+        forgetChanges();
+    }
+
+    QVector<Mutation> pending;
+    bool rebased = false;
+    for (;;) {
+        if (!m_journal.readNew(m_seq, &pending, &rebased, repair, error))
+            return false;
+        if (!rebased)
+            break;
+        if (!reloadUsersXml(error))
+            return false;
+        forgetChanges();
+    }
+
+    for (const Mutation &m : pending) {
+        QString why;
+        if (!apply(m, &why)) {
+            // a record we could not read is not a reason to drop the change;
+            // the next catch-up reloads and replays it
+            if (m_baseUnreadable) {
+                setError(error, why);
+                return false;
+            }
+            qWarning() << "users.journal: skipping record" << m.seq << why;
+        } else {
+            logChange(m.studentId);
+        }
+        m_seq = m.seq;
+    }
+    return true;
+}
+
+void XmlStore::logChange(const QString &studentId)
+{
+    ++m_generation;
+    if (studentId.isEmpty())
+        return;                 // ReserveIds
+    if (m_changes.size() >= kMaxChanges) {
+        const int dropped = kMaxChanges / 2;
+        m_changesFrom = m_changes[dropped - 1].first;
+        m_changes.remove(0, dropped);
+    }
+    m_changes.append(qMakePair(m_generation, studentId));
+}
+
+// The state was rebuilt from users.xml: who changed in it is not known
+void XmlStore::forgetChanges()
+{
+    m_changesFrom = ++m_generation;
+    m_changes.clear();
+}
+
+// From the overlay mostly; a student logged before a compaction reindexed
+// users.xml may be read from the base again
+bool XmlStore::changesSince(quint64 since, quint64 *generation, QVector<Student> *changed,
+                            QStringList *removed) const
+{
+    if (since < m_changesFrom)
+        return false;
+
+    QSet<QString> ids;
+    for (int i = m_changes.size() - 1; i >= 0 && m_changes[i].first > since; --i)
+        ids.insert(m_changes[i].second);
+    for (const QString &id : std::as_const(ids)) {
+        Student s;
+        QString why;
+        if (lookup(id, &s, &why))
+            changed->append(s);
+        else if (why.isEmpty())
+            removed->append(id);
+        else
+            return false;       // unreadable; a full read reports it
+    }
+    *generation = m_generation;
+    return true;
+}
+
+bool XmlStore::refresh(QString *error)
+{
+    if (!catchUp(false, error))
+        return false;
+    maybeCompact();
+    return true;
+}
+
+// -----------------------------------------------------
+//  LOOKUPS
+// -----------------------------------------------------
+// A record of the base; a failure is remembered so the next catch-up
+// starts over from the file as it is now
+bool XmlStore::baseStudent(int i, Student *out, QString *error) const
+{
+    QString why;
+    if (m_state.base->student(i, out, &why))
+        return true;
+    qWarning() << "users.xml:" << why;
+    m_baseUnreadable = true;
+    setError(error, why);
+    return false;
+}
+
+// False when the student does not exist, and also, with *error set, when
+// its record cannot be read
+bool XmlStore::lookup(const QString &studentId, Student *out, QString *error) const
+{
+    auto it = m_state.students.constFind(studentId);
+    if (it != m_state.students.constEnd()) {
+        if (out) *out = it.value();
+        return true;
+    }
+    if (!m_state.base || m_state.removed.contains(studentId))
+        return false;
+
+    int i = m_state.base->findStudentById(studentId);
+    if (i < 0)
+        return false;
+    return !out || baseStudent(i, out, error);
+}
+
+QString XmlStore::idForUsername(const QString &username) const
+{
+    auto it = m_state.idByUsername.constFind(username);
+    if (it != m_state.idByUsername.constEnd())
+        return it.value();
+    if (!m_state.base || m_state.releasedNames.contains(username))
+        return QString();
+
+    int i = m_state.base->findStudentByUsername(username);
+    return i < 0 ? QString() : m_state.base->studentId(i);
+}
+
+bool XmlStore::findStudentByUsername(const QString &username, Student *out) const
+{
+    const QString id = idForUsername(username);
+    return !id.isEmpty() && lookup(id, out);
+}
+
+bool XmlStore::findStudent(const QString &studentId, Student *out) const
+{
+    return lookup(studentId, out);
+}
+
+bool XmlStore::usernameExists(const QString &username) const
+{
+    return !idForUsername(username).isEmpty();
+}
+
+// Base order first, then students added since. Base records are decoded
+// one at a time, from the snapshot mapping or the indexed users.xml.
+bool XmlStore::forEachStudent(const StudentVisitor &visit, const LoadProgress &progress,
+                              QString *error) const
+{
+    const StudentSource *base = m_state.base.data();
+    const int baseCount = base ? base->studentCount() : 0;
+
+    for (int i = 0; i < baseCount; ++i) {
+        if (progress && i % 1024 == 0)
+            progress(i, baseCount);
+        const QString id = base->studentId(i);
+        if (m_state.removed.contains(id))
+            continue;
+        auto it = m_state.students.constFind(id);
+        Student s;
+        if (it != m_state.students.constEnd())
+            s = it.value();
+        else if (!baseStudent(i, &s, error))
+            return false;
+        if (!visit(s))
+            return true;
+    }
+    for (const QString &id : m_state.added)
+        if (!visit(m_state.students.value(id)))
+            return true;
+    if (progress)
+        progress(baseCount, baseCount);
+    return true;
+}
+
+QVector<Student> XmlStore::students(const LoadProgress &progress) const
+{
+    QVector<Student> list;
+    list.reserve((m_state.base ? m_state.base->studentCount() : 0) + m_state.added.size());
+    QString error;
+    if (!forEachStudent([&list](const Student &s) {
+            list.append(s);
+            return true;
+        }, progress, &error))
+        qWarning() << "users.xml: roster incomplete:" << error;
+    return list;
+}
+
+// -----------------------------------------------------
+//  APPLY / SUBMIT
+//  apply() is the only place the in-memory state changes; it serves both
+//  fresh mutations and journal replay.
+// -----------------------------------------------------
+bool XmlStore::apply(const Mutation &m, QString *error)
+{
+    switch (m.type) {
+    case Mutation::RegisterStudent: {
+        if (usernameExists(m.username)) {
+            setError(error, "Username already exists!");
+            return false;
+        }
+        if (lookup(m.studentId, nullptr)) {
+            setError(error, "Duplicate student id " + m.studentId);
+            return false;
+        }
+        Student s;
+        s.id       = m.studentId;
+        s.username = m.username;
+        s.password = m.password;
+        m_state.students.insert(s.id, s);
+        m_state.added.append(s.id);
+        m_state.idByUsername.insert(s.username, s.id);
+        m_state.ids.observe(s.id);
+        return true;
+    }
+
+    case Mutation::DeleteStudent: {
+        Student s;
+        QString why;
+        if (!lookup(m.studentId, &s, &why)) {
+            setError(error, why.isEmpty() ? "Unknown student " + m.studentId : why);
+            return false;
+        }
+        m_state.idByUsername.remove(s.username);
+        m_state.releasedNames.insert(s.username);
+        m_state.students.remove(s.id);
+        if (m_state.base && m_state.base->findStudentById(s.id) >= 0)
+            m_state.removed.insert(s.id);
+        else
+            m_state.added.removeOne(s.id);
+        return true;
+    }
+
+    case Mutation::ReserveIds:
+        m_state.ids.reserve(m.count);
+        return true;
+
+    case Mutation::UpdateStudent: {
+        // a rename must not collide with another student's login
+        const QString owner = idForUsername(m.username);
+        if (!owner.isEmpty() && owner != m.studentId) {
+            setError(error, "Username already exists!");
+            return false;
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    Student current;
+    QString why;
+    if (!lookup(m.studentId, &current, &why)) {
+        setError(error, why.isEmpty() ? "Unknown student " + m.studentId : why);
+        return false;
+    }
+
+    Student updated = current;
+    if (!applyToStudent(m, &updated, error))
+        return false;
+    if (updated.username != current.username) {
+        m_state.idByUsername.remove(current.username);
+        m_state.releasedNames.insert(current.username);
+        m_state.idByUsername.insert(updated.username, updated.id);
+    }
+    m_state.students.insert(updated.id, updated);
+    return true;
+}
+
+// The commit window. Under the users.lock: catch up with other instances
+// (the optimistic check: if the generation moved, their records come first),
+// re-validate each change against that state, apply the valid ones in memory
+// and append them in one write. apply() leaves the state untouched when it
+// rejects a change, so only a failed append needs the rollback, which keeps
+// memory from running ahead of the disk. Dialogs never hold the lock.
+bool XmlStore::commitBatch(const QVector<Mutation *> &batch, QVector<QString> *results,
+                           QString *error)
+{
+    results->fill(QString(), batch.size());
+
+    QLockFile lock(m_lockPath);
+    if (!acquire(lock, error) || !catchUp(true, error))
+        return false;
+
+    const State before = m_state;
+    QVector<Mutation> records;
+    quint64 seq = m_seq;
+    for (int i = 0; i < batch.size(); ++i) {
+        Mutation *m = batch[i];
+        // ids are only known once everyone else's registrations are in;
+        // a bulk import brings its own from a reserved range
+        if (m->type == Mutation::RegisterStudent && m->studentId.isEmpty())
+            m->studentId = IdAllocator::format(m_state.ids.next());
+        if (m->type == Mutation::ReserveIds)
+            m->firstId = m_state.ids.next();
+
+        if (!apply(*m, &(*results)[i]))
+            continue;
+        m->seq = ++seq;
+        records.append(*m);
+    }
+    if (records.isEmpty())
+        return true;
+
+    if (!m_journal.append(records, error)) {
+        m_state = before;
+        return false;
+    }
+    m_seq = seq;
+    lock.unlock();
+    for (const Mutation &m : std::as_const(records))
+        logChange(m.studentId);
+
+    maybeCompact();
+    return true;
+}
+
+// -----------------------------------------------------
+//  COMPACTION
+// -----------------------------------------------------
+// The state as a users.xml at `path`, in forEachStudent() order. Runs of
+// base students the overlay leaves alone go to the base to copy; changed
+// and added students are serialized from the overlay.
+bool XmlStore::writeCompacted(const QString &path, const State &state,
+                              const QVector<Course> &courses, quint64 nextId,
+                              quint64 journalSeq, UsersXmlPrinter *printer, QString *error)
+{
+    UsersXmlWriter writer(printer);
+    if (!writer.open(path, courses, nextId, journalSeq, error))
+        return false;
+
+    const StudentSource *base = state.base.data();
+    const int baseCount = base ? base->studentCount() : 0;
+    int run = 0;                // first base student not yet written
+    for (int i = 0; i < baseCount; ++i) {
+        const QString id = base->studentId(i);
+        const bool removed = state.removed.contains(id);
+        auto it = state.students.constFind(id);
+        if (!removed && it == state.students.constEnd())
+            continue;
+        if (!base->writeStudents(run, i, &writer, error))
+            return false;
+        if (!removed && !writer.writeStudent(it.value(), error))
+            return false;
+        run = i + 1;
+    }
+    if (base && !base->writeStudents(run, baseCount, &writer, error))
+        return false;
+    for (const QString &id : state.added)
+        if (!writer.writeStudent(state.students.value(id), error))
+            return false;
+    return writer.finish(error);
+}
+
+// Fold the journal back into users.xml once it passes the threshold. The
+// file is written from a copy of the state (cheap, implicitly shared) into
+// a side file on a worker thread, without the lock; only the swap and the
+// journal cut happen under it, in finishCompaction(), and only if no other
+// instance has compacted further meanwhile. Records appended during the
+// write have a higher seq and are kept.
+void XmlStore::maybeCompact()
+{
+    if (m_compacting) {
+        if (m_compaction.isFinished())
+            finishCompaction();
+        return;
+    }
+    if (m_journal.size() < m_compactionThreshold)
+        return;
+    m_compacting = true;
+
+    m_compactedSeq  = m_seq;
+    m_compactedFrom = m_changesFrom;
+    m_compactTmp    = m_usersFile + "." + QString::number(QCoreApplication::applicationPid()) + ".tmp";
+    const State state = m_state;
+    const QVector<Course> courses = m_catalog.courses();
+    const quint64 nextId = m_state.ids.next();
+    const quint64 seq = m_seq;
+    const QString tmp = m_compactTmp;
+    UsersXmlPrinter *printer = &m_compactPrinter;
+    m_compaction = QtConcurrent::run([tmp, state, courses, nextId, seq, printer]() {
+        QString error;
+        if (writeCompacted(tmp, state, courses, nextId, seq, printer, &error))
+            return true;
+        qWarning() << "users.xml compaction:" << error;
+        return false;
+    });
+}
+
+void XmlStore::finishCompaction()
+{
+    const quint64 folded = m_compactedSeq;
+    QString error;
+    QLockFile lock(m_lockPath);
+    if (!m_compaction.result()) {
+        qWarning() << "users.xml: compaction failed, journal kept";
+    } else if (!acquire(lock, &error) || !catchUp(true, &error)
+               || m_journal.base() >= folded || m_changesFrom != m_compactedFrom) {
+        // busy, another instance got there first, or users.xml was edited
+        // (reloaded) meanwhile, which the side file knows nothing of
+        QFile::remove(m_compactTmp);
+    } else if (!replaceFile(m_compactTmp, m_usersFile, true, &error)
+               || !m_journal.truncateThrough(folded, &error)) {
+        qWarning() << "users.xml compaction:" << error;
+    } else if (dynamic_cast<const StudentIndex *>(m_state.base.data())) {
+        // the index points into the file just replaced: index the new one
+        // and replay what the journal kept on top
+        m_journal.setPath(m_journal.path());
+        if (!reloadUsersXml(&error) || !catchUp(true, &error))
+            qWarning() << "users.xml compaction:" << error;
+    } else {
+        // the state is the new file plus what the journal kept: take its
+        // stamp, so it is not mistaken for an edit
+        const QFileInfo xml(m_usersFile);
+        m_xmlSize = xml.size();
+        m_xmlModified = xml.lastModified().toMSecsSinceEpoch();
+        buildSnapshot();
+    }
+    m_compacting = false;
+}
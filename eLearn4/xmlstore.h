@@ -0,0 +1,136 @@
+// xmlstore.h
+#ifndef XMLSTORE_H
+#define XMLSTORE_H
+
+#include <QFuture>
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include "coursecatalog.h"
+#include "idallocator.h"
+#include "journal.h"
+#include "snapshot.h"
+#include "studentindex.h"
+#include "studentstore.h"
+#include "usersxml.h"
+
+// The original file layout: users.xml plus users.journal in the data
+// directory. When a snapshot of users.xml exists it is mapped and its
+// records are read in place; otherwise users.xml is only indexed (a
+// StudentIndex) and students are parsed as they are used, while the
+// snapshot for the next start is built in the background. Either way only
+// students changed since sit in the in-memory overlay.
+//
+// Mutations are appended to users.journal rather than rewriting users.xml;
+// once the journal passes compactionThreshold() it is folded back into
+// users.xml on a background thread, and swapped in by the first store call
+// after that finishes (so it needs no event loop on the calling thread).
+// The new file is streamed out: unchanged students are copied from the
+// indexed users.xml as they stand, only changed and added ones are
+// serialized, so a compaction holds no more of the roster than the overlay.
+//
+// Several instances may share the data directory. Each commit takes the
+// users.lock for just the append, first applying what other instances
+// journaled since and re-validating the change on top. When users.xml
+// itself is no longer the file loaded (edited or restored by hand, or
+// compacted by another instance), catching up starts over from it and
+// replays the whole journal.
+//
+// generation() counts the records applied and those restarts. Recent
+// records are logged by student id for changesSince(), so the ChangeFeed
+// reads just those students; a restart clears the log, since what changed
+// in users.xml is not known.
+//
+// Students are keyed by id, with a username -> id index kept in step by
+// every mutation, so login and dashboard lookups are O(1) in the roster size.
+class XmlStore : public StudentStore, public CatalogStore
+{
+public:
+    ~XmlStore() override;
+
+    bool open(const QString &dataDir, QString *error = nullptr) override;
+    bool refresh(QString *error = nullptr) override;
+    quint64 generation() const override { return m_generation; }
+    bool changesSince(quint64 since, quint64 *generation, QVector<Student> *changed,
+                      QStringList *removed) const override;
+    QStringList watchedFiles() const override { return { m_usersFile, m_journal.path() }; }
+
+    const CourseCatalog &catalog() const override { return m_catalog; }
+
+    bool findStudentByUsername(const QString &username, Student *out) const override;
+    bool findStudent(const QString &studentId, Student *out) const override;
+    bool usernameExists(const QString &username) const override;
+    QVector<Student> students(const LoadProgress &progress = LoadProgress()) const override;
+    bool forEachStudent(const StudentVisitor &visit,
+                        const LoadProgress &progress = LoadProgress(),
+                        QString *error = nullptr) const override;
+
+    bool commitBatch(const QVector<Mutation *> &batch, QVector<QString> *results,
+                     QString *error = nullptr) override;
+
+    qint64 compactionThreshold() const { return m_compactionThreshold; }
+    void setCompactionThreshold(qint64 bytes) { m_compactionThreshold = bytes; }
+
+    // Students parsed from users.xml kept cached while it is only indexed
+    int cacheLimit() const { return m_cacheLimit; }
+    void setCacheLimit(int students) { m_cacheLimit = students; }
+
+private:
+    // Everything a mutation may touch; copied (cheaply, implicit sharing)
+    // before a change so a failed append can be rolled back. Students come
+    // from the overlay first, then from the mapped snapshot unless removed.
+    struct State
+    {
+        QSharedPointer<const StudentSource> base;   // snapshot or index, may be null
+        QHash<QString, Student> students;       // id -> record added or changed
+        QVector<QString>        added;          // ids not in base, in file order
+        QSet<QString>           removed;        // base ids deleted since
+        QHash<QString, QString> idByUsername;   // username -> id, overrides base
+        QSet<QString>           releasedNames;  // base usernames no longer taken
+        IdAllocator             ids;
+    };
+
+    bool lookup(const QString &studentId, Student *out, QString *error = nullptr) const;
+    bool baseStudent(int i, Student *out, QString *error) const;
+    QString idForUsername(const QString &username) const;
+    void buildSnapshot();
+
+    bool reloadUsersXml(QString *error);
+    bool usersXmlChanged() const;
+    bool catchUp(bool repair, QString *error);
+    void logChange(const QString &studentId);
+    void forgetChanges();
+    bool apply(const Mutation &m, QString *error);
+    static bool writeCompacted(const QString &path, const State &state,
+                               const QVector<Course> &courses, quint64 nextId,
+                               quint64 journalSeq, UsersXmlPrinter *printer, QString *error);
+    void maybeCompact();
+    void finishCompaction();
+
+    QString m_usersFile;
+    QString m_lockPath;
+    CourseCatalog m_catalog;
+    State m_state;
+    qint64 m_xmlSize = -1;                  // stamp of the users.xml loaded
+    qint64 m_xmlModified = 0;
+    mutable bool m_baseUnreadable = false;  // a base record failed to read; reload
+
+    Journal m_journal;
+    quint64 m_seq = 0;                      // last sequence number applied
+    quint64 m_generation = 0;
+    QVector<QPair<quint64, QString>> m_changes;  // (generation, student id), oldest first
+    quint64 m_changesFrom = 0;              // the log covers what came after this
+    qint64  m_compactionThreshold = 1 << 20;
+    int     m_cacheLimit = 256;
+    bool    m_compacting = false;
+    QFuture<bool> m_compaction;             // writing m_compactTmp
+    quint64   m_compactedSeq = 0;           // journal records folded into it
+    quint64   m_compactedFrom = 0;          // m_changesFrom then; moved if users.xml was reloaded
+    QString   m_compactTmp;
+    UsersXmlPrinter m_compactPrinter;       // the worker's buffer, kept for the next one
+};
+
+#endif // XMLSTORE_H